@@ -0,0 +1,172 @@
+#include "hill_attack.h"
+#include "crib_solver.h"
+#include "hill_key.h"
+#include "hill_message.h"
+#include "hill_normalize.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <memory>
+
+using namespace std;
+using namespace chrono;
+
+/* ---------- HELPERS ---------- */
+string keyText(const vector<vector<int>>& key) {
+    string text;
+    for (size_t r = 0; r < key.size(); r++) {
+        if (r) text += "; ";
+        for (size_t c = 0; c < key[r].size(); c++) {
+            if (c) text += " ";
+            text += to_string(key[r][c]);
+        }
+    }
+    return text;
+}
+
+string readAll(istream& in) {
+    stringstream buffer;
+    buffer << in.rdbuf();
+    return buffer.str();
+}
+
+// First letters of the ciphertext decrypted with `key`
+string preview(const vector<vector<int>>& matrix, const string& ciphertext) {
+    int n = matrix.size();
+    string letters;
+    for (size_t i = 0; i < ciphertext.size() && letters.size() < size_t(48 / n * n); i++) {
+        uint8_t v = letterIndex(ciphertext[i]);
+        if (v != NOT_A_LETTER) letters += char('A' + v);
+    }
+    letters.resize(letters.size() / n * n);
+
+    HillKey key(matrix);
+    string plain(letters.size(), ' ');
+    plain.resize(decryptMessage(key, letters.data(), letters.size(), &plain[0]));
+    return plain;
+}
+
+/* ---------- KNOWN PLAINTEXT ---------- */
+void cribSearch(const string& crib, int n, const string& ciphertext, size_t top,
+                const NgramModel& model, ThreadPool& pool) {
+    CribSolver solver(crib, n);
+    solver.setThreadPool(&pool);
+    solver.setModel(&model);
+
+    auto start = steady_clock::now();
+    vector<CribMatch> matches = solver.solve(ciphertext, top);
+    double seconds = duration<double>(steady_clock::now() - start).count();
+
+    cout << "Tried " << solver.alignmentsTried() << " alignments ("
+         << solver.rejectedSingular() << " singular, " << solver.rejectedMismatch()
+         << " contradicted by the crib) in " << fixed << setprecision(3) << seconds
+         << " s on " << pool.size() << " threads\n\n";
+    if (matches.empty()) {
+        cout << "No alignment of the crib fits this ciphertext.\n";
+        return;
+    }
+    for (size_t i = 0; i < matches.size(); i++) {
+        const CribMatch& m = matches[i];
+        cout << setw(3) << i + 1 << "  offset " << setw(7) << m.offset
+             << "  confirmed " << setw(3) << m.confirmedBlocks << "  " << setw(10)
+             << setprecision(1) << m.score << "  key " << left << setw(28) << keyText(m.key)
+             << right << "  " << preview(m.key, ciphertext) << "\n";
+    }
+}
+
+/* ---------- MAIN ---------- */
+// Key recovery:
+//   attack [options] [FILE]              ciphertext-only search
+//   attack --crib TEXT [options] [FILE]  known plaintext, dragged over FILE
+// The ciphertext comes from FILE, or stdin without one.
+int main(int argc, char* argv[]) {
+    int n = 3;
+    size_t top = 10, rows = 0, sample = 0;
+    bool sample_set = false;
+    unsigned threads = 0;
+    string corpus_path, in_path, crib;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            string arg = argv[i];
+            if (arg == "--size" && i + 1 < argc) {
+                n = stoi(argv[++i]);
+            } else if (arg == "--top" && i + 1 < argc) {
+                top = stoul(argv[++i]);
+            } else if (arg == "--rows" && i + 1 < argc) {
+                rows = stoul(argv[++i]);
+            } else if (arg == "--sample" && i + 1 < argc) {
+                sample = stoul(argv[++i]);
+                sample_set = true;
+            } else if (arg == "--threads" && i + 1 < argc) {
+                threads = stoul(argv[++i]);
+            } else if (arg == "--crib" && i + 1 < argc) {
+                crib = argv[++i];
+            } else if (arg == "--corpus" && i + 1 < argc) {
+                corpus_path = argv[++i];
+            } else if (arg[0] != '-' && in_path.empty()) {
+                in_path = arg;
+            } else {
+                cerr << "Usage: attack [--size 2|3] [--top 10] [--rows count] [--sample letters]\n"
+                     << "       [--crib \"known plaintext\"] [--threads n (0 = all cores)]\n"
+                     << "       [--corpus english.txt] [ciphertext file]\n";
+                return 2;
+            }
+        }
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 2;
+    }
+
+    try {
+        string ciphertext;
+        if (in_path.empty()) {
+            ciphertext = readAll(cin);
+        } else {
+            ifstream in(in_path, ios::binary);
+            if (!in) throw runtime_error("Cannot open " + in_path);
+            ciphertext = readAll(in);
+        }
+
+        // A trained model beats the built-in tables on unusual text
+        unique_ptr<NgramModel> trained;
+        if (!corpus_path.empty()) {
+            ifstream corpus(corpus_path, ios::binary);
+            if (!corpus) throw runtime_error("Cannot open " + corpus_path);
+            trained.reset(new NgramModel(NgramModel::train(corpus)));
+        }
+
+        const NgramModel& model = trained ? *trained : NgramModel::english();
+        if (!crib.empty()) {
+            ThreadPool pool(threads);
+            cribSearch(crib, n, ciphertext, top, model, pool);
+            return 0;
+        }
+
+        WorkStealingPool pool(threads);
+        HillAttack attack(model);
+        attack.setThreadPool(&pool);
+        attack.setRowCandidates(rows);
+        if (sample_set) attack.setSampleLength(sample);
+
+        auto start = steady_clock::now();
+        vector<AttackCandidate> keys = attack.recover(ciphertext, n, top);
+        double seconds = duration<double>(steady_clock::now() - start).count();
+
+        cout << "Searched " << attack.rowsScored() << " rows and " << attack.matricesScored()
+             << " matrices (" << attack.matricesPruned() << " not invertible) in "
+             << fixed << setprecision(2) << seconds << " s on " << pool.size() << " threads\n\n";
+
+        for (size_t i = 0; i < keys.size(); i++) {
+            cout << setw(3) << i + 1 << "  " << setw(10) << setprecision(1) << keys[i].score
+                 << "  key " << left << setw(28) << keyText(keys[i].key) << right
+                 << "  " << preview(keys[i].key, ciphertext) << "\n";
+        }
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
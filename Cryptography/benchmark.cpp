@@ -0,0 +1,523 @@
+#include "matrix_utils.h"
+#include "hill_kernel.h"
+#include "hill_table.h"
+#include "hill_gemm.h"
+#include "hill_key.h"
+#include "hill_message.h"
+#include "space_map.h"
+#include "hill_metrics.h"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <random>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+using namespace chrono;
+
+/* ---------- ALLOCATION COUNTING ---------- */
+// Every operator new in the process goes through here, so allocations per
+// operation can be reported next to the timings. Metrics builds already
+// replace operator new and count there.
+#ifndef HILL_METRICS
+static atomic<uint64_t> allocation_count(0);
+
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    if (!p) throw bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+// C++14 sized delete, so the pair above is never mixed with the library's
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+static uint64_t allocations() {
+    return allocation_count.load();
+}
+#else
+static uint64_t allocations() {
+    return metricsAllocations();
+}
+#endif
+
+/* ---------- HELPERS ---------- */
+vector<vector<int>> randomKey(int n, mt19937& rng) {
+    vector<vector<int>> key(n, vector<int>(n));
+    for (auto& row : key)
+        for (int& x : row) x = rng() % 26;
+    return key;
+}
+
+vector<vector<int>> randomInvertibleKey(int n, mt19937& rng) {
+    vector<vector<int>> key;
+    do {
+        key = randomKey(n, rng);
+    } while (!MatrixUtils::isInvertible(key));
+    return key;
+}
+
+// Lowercase words separated by single spaces, roughly English word lengths
+string randomMessage(size_t length, mt19937& rng) {
+    string msg(length, ' ');
+    size_t word = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (word > 0 && rng() % 6 == 0) {
+            word = 0;
+            continue;
+        }
+        msg[i] = char('a' + rng() % 26);
+        word++;
+    }
+    return msg;
+}
+
+string randomLetters(size_t length, mt19937& rng) {
+    string s(length, 'A');
+    for (char& c : s) c = char('A' + rng() % 26);
+    return s;
+}
+
+// Parses "4096", "64K", "16M" or "1G"
+uint64_t parseSize(const string& text) {
+    size_t used = 0;
+    uint64_t value = stoull(text, &used);
+    string suffix = text.substr(used);
+    if (suffix == "K" || suffix == "k") return value << 10;
+    if (suffix == "M" || suffix == "m") return value << 20;
+    if (suffix == "G" || suffix == "g") return value << 30;
+    if (!suffix.empty()) throw runtime_error("Bad size: " + text);
+    return value;
+}
+
+string sizeName(uint64_t bytes) {
+    if (bytes >= (1u << 30) && bytes % (1u << 30) == 0) return to_string(bytes >> 30) + "G";
+    if (bytes >= (1u << 20) && bytes % (1u << 20) == 0) return to_string(bytes >> 20) + "M";
+    if (bytes >= (1u << 10) && bytes % (1u << 10) == 0) return to_string(bytes >> 10) + "K";
+    return to_string(bytes);
+}
+
+/* ---------- MEASUREMENT ---------- */
+struct Settings {
+    uint64_t maxBytes = 16u << 20;
+    vector<int> keySizes = {2, 3, 4, 8, 16, 32, 64};
+    double budget = 0.2;            // seconds of timed work per measurement
+    string only;                    // run only operations containing this
+    string jsonPath;
+    unsigned threads = 0;           // encryptWithSpaces pool, 0 = all cores
+    ThreadPool* pool = nullptr;
+    bool crossover = false;
+    bool gemm = false;
+};
+
+struct Result {
+    string op;
+    int n;                  // key size, 0 when the operation has none
+    uint64_t bytes;         // input bytes per operation
+    uint64_t ops;           // operations timed
+    double seconds;
+    double p50, p90, p99;   // microseconds per operation
+    double allocsPerOp;
+};
+
+double percentile(vector<double>& sorted, double q) {
+    size_t i = size_t(q * (sorted.size() - 1) + 0.5);
+    return sorted[i];
+}
+
+// Time `op` until the budget is spent (at least 3 samples, unless single
+// operations already take several budgets). Tiny operations are timed in
+// batches so clock overhead does not dominate; each sample is a per-op time.
+template <class Op>
+Result measure(const Settings& settings, const string& name, int n, uint64_t bytes, Op op) {
+    // Warm caches and size the batch
+    size_t batch = 1;
+    auto t0 = steady_clock::now();
+    op();
+    double first = duration<double>(steady_clock::now() - t0).count();
+    if (first < 10e-6) batch = size_t(10e-6 / max(first, 1e-9)) + 1;
+
+    vector<double> samples;
+    double total = 0;
+    uint64_t ops = 0;
+    uint64_t allocs = 0;
+    while (total < settings.budget * 5 && !(total >= settings.budget && samples.size() >= 3)) {
+        uint64_t allocs_before = allocations();
+        auto start = steady_clock::now();
+        for (size_t i = 0; i < batch; i++) op();
+        double seconds = duration<double>(steady_clock::now() - start).count();
+        allocs += allocations() - allocs_before;
+        samples.push_back(seconds / batch * 1e6);
+        total += seconds;
+        ops += batch;
+    }
+
+    sort(samples.begin(), samples.end());
+    Result r;
+    r.op = name;
+    r.n = n;
+    r.bytes = bytes;
+    r.ops = ops;
+    r.seconds = total;
+    r.p50 = percentile(samples, 0.50);
+    r.p90 = percentile(samples, 0.90);
+    r.p99 = percentile(samples, 0.99);
+    r.allocsPerOp = double(allocs) / ops;
+    return r;
+}
+
+/* ---------- REPORTING ---------- */
+vector<Result> results;
+
+// Blocks per operation (a partial block is padded, so it counts)
+uint64_t blockCount(const Result& r) {
+    return r.n > 0 ? (r.bytes + r.n - 1) / r.n : 0;
+}
+
+void printHeader() {
+    cout << left << setw(22) << "operation" << right << setw(4) << "n" << setw(9) << "bytes"
+         << setw(12) << "MB/s" << setw(14) << "blocks/s" << setw(12) << "p50 us"
+         << setw(12) << "p99 us" << setw(12) << "allocs/op" << "\n";
+}
+
+void report(const Result& r) {
+    results.push_back(r);
+    double per_second = r.ops / r.seconds;
+    cout << left << setw(22) << r.op << right << setw(4);
+    if (r.n > 0) cout << r.n; else cout << "-";
+    cout << setw(9) << sizeName(r.bytes) << fixed << setprecision(1);
+    if (r.bytes > 0) cout << setw(12) << per_second * r.bytes / 1e6; else cout << setw(12) << "-";
+    if (r.n > 0 && r.bytes > 0) cout << setw(14) << setprecision(0) << per_second * blockCount(r);
+    else cout << setw(14) << "-";
+    cout << setprecision(2) << setw(12) << r.p50 << setw(12) << r.p99
+         << setw(12) << r.allocsPerOp << "\n";
+    cout.flush();
+}
+
+void writeJson(const Settings& settings) {
+    ofstream out(settings.jsonPath);
+    if (!out) throw runtime_error("Cannot open " + settings.jsonPath + " for writing");
+
+    out << "{\n  \"cpu_level\": \"" << HillKernel::levelName(HillKernel::detect()) << "\",\n"
+        << "  \"threads\": " << settings.pool->size() << ",\n"
+        << "  \"budget_seconds\": " << settings.budget << ",\n"
+        << "  \"results\": [";
+    out << setprecision(6);
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        double per_second = r.ops / r.seconds;
+        out << (i ? "," : "") << "\n    {\"op\": \"" << r.op << "\", \"n\": " << r.n
+            << ", \"bytes\": " << r.bytes << ", \"ops\": " << r.ops
+            << ", \"ops_per_s\": " << per_second
+            << ", \"mb_per_s\": " << per_second * r.bytes / 1e6
+            << ", \"blocks_per_s\": " << per_second * blockCount(r)
+            << ", \"p50_us\": " << r.p50 << ", \"p90_us\": " << r.p90 << ", \"p99_us\": " << r.p99
+            << ", \"allocs_per_op\": " << r.allocsPerOp << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+/* ---------- HOT PATHS ---------- */
+// 16B, 256B, 4K, ... and settings.maxBytes itself (1G at most)
+vector<uint64_t> inputSizes(const Settings& settings) {
+    uint64_t largest = min<uint64_t>(settings.maxBytes, 1u << 30);
+    vector<uint64_t> sizes;
+    for (uint64_t bytes = 16; bytes <= largest; bytes *= 16) {
+        sizes.push_back(bytes);
+    }
+    // The x16 steps skip 1G (256M, 4G), so the limit is always measured
+    if (largest >= 16 && sizes.back() != largest) {
+        sizes.push_back(largest);
+    }
+    return sizes;
+}
+
+bool wanted(const Settings& settings, const string& op) {
+    return settings.only.empty() || op.find(settings.only) != string::npos;
+}
+
+// The textbook per-block loop: one vector per block in, one out
+void benchMultiplyMatrixVector(const Settings& settings, mt19937& rng) {
+    for (int n : settings.keySizes) {
+        vector<vector<int>> key = randomInvertibleKey(n, rng);
+        for (uint64_t bytes : inputSizes(settings)) {
+            // Whole blocks covering `bytes` letters
+            uint64_t blocks = (bytes + n - 1) / n;
+            vector<int> letters = MatrixUtils::stringToVector(randomLetters(blocks * n, rng));
+            vector<int> output(letters.size());
+            report(measure(settings, "multiplyMatrixVector", n, bytes, [&]() {
+                for (size_t i = 0; i < letters.size(); i += n) {
+                    vector<int> block(letters.begin() + i, letters.begin() + i + n);
+                    vector<int> r = MatrixUtils::multiplyMatrixVector(key, block);
+                    copy(r.begin(), r.end(), output.begin() + i);
+                }
+            }));
+        }
+    }
+}
+
+void benchInverseMatrix(const Settings& settings, mt19937& rng) {
+    for (int n : settings.keySizes) {
+        vector<vector<int>> key = randomInvertibleKey(n, rng);
+        report(measure(settings, "inverseMatrix", n, 0, [&]() {
+            vector<vector<int>> inverse = MatrixUtils::inverseMatrix(key);
+            if (inverse.size() != size_t(n)) abort();
+        }));
+    }
+}
+
+void benchConversions(const Settings& settings, mt19937& rng) {
+    for (uint64_t bytes : inputSizes(settings)) {
+        string text = randomLetters(bytes, rng);
+        vector<int> values = MatrixUtils::stringToVector(text);
+
+        if (wanted(settings, "stringToVector")) {
+            report(measure(settings, "stringToVector", 0, bytes, [&]() {
+                vector<int> v = MatrixUtils::stringToVector(text);
+                if (v.size() != bytes) abort();
+            }));
+        }
+        if (wanted(settings, "vectorToString")) {
+            report(measure(settings, "vectorToString", 0, bytes, [&]() {
+                string s = MatrixUtils::vectorToString(values);
+                if (s.size() != bytes) abort();
+            }));
+        }
+        if (wanted(settings, "padString")) {
+            // One letter short of a block boundary, so padding always runs
+            string unpadded = text.substr(0, bytes - 1);
+            report(measure(settings, "padString", 0, bytes, [&]() {
+                string s = MatrixUtils::padString(unpadded, 3);
+                if (s.empty()) abort();
+            }));
+        }
+    }
+}
+
+void benchEncryptWithSpaces(const Settings& settings, mt19937& rng) {
+    for (int n : settings.keySizes) {
+        HillKey key(randomInvertibleKey(n, rng));
+        for (uint64_t bytes : inputSizes(settings)) {
+            string msg = randomMessage(bytes, rng);
+            report(measure(settings, "encryptWithSpaces", n, bytes, [&]() {
+                auto result = encryptWithSpaces(msg, key, *settings.pool);
+                if (result.first.size() % n != 0) abort();
+            }));
+        }
+    }
+}
+
+// Caller-buffer core: the same work as encryptWithSpaces with no allocation
+void benchMessageCore(const Settings& settings, mt19937& rng) {
+    for (int n : settings.keySizes) {
+        HillKey key(randomInvertibleKey(n, rng));
+        for (uint64_t bytes : inputSizes(settings)) {
+            string msg = randomMessage(bytes, rng);
+            MessageCounts counts = countMessage(msg.data(), msg.size());
+            vector<char> encrypted(encryptedLength(counts.letters, n));
+            vector<char> decrypted(encrypted.size());
+            vector<uint64_t> spaces(counts.spaces);
+
+            if (wanted(settings, "encryptMessage")) {
+                report(measure(settings, "encryptMessage", n, bytes, [&]() {
+                    encryptMessage(key, msg.data(), msg.size(), encrypted.data(), spaces.data(),
+                                   settings.pool);
+                }));
+            }
+            encryptMessage(key, msg.data(), msg.size(), encrypted.data(), spaces.data());
+            if (wanted(settings, "decryptMessage")) {
+                report(measure(settings, "decryptMessage", n, bytes, [&]() {
+                    decryptMessage(key, encrypted.data(), encrypted.size(), decrypted.data(),
+                                   settings.pool);
+                }));
+            }
+        }
+    }
+}
+
+void benchReconstructWithSpaces(const Settings& settings, mt19937& rng) {
+    for (uint64_t bytes : inputSizes(settings)) {
+        string msg = randomMessage(bytes, rng);
+        string letters;
+        vector<uint64_t> spaces;
+        for (size_t i = 0; i < msg.size(); i++) {
+            if (msg[i] == ' ') spaces.push_back(i);
+            else letters.push_back(char(toupper(msg[i])));
+        }
+        report(measure(settings, "reconstructWithSpaces", 0, bytes, [&]() {
+            string s = reconstructWithSpaces(letters, spaces, msg.size());
+            if (s.size() != msg.size()) abort();
+        }));
+    }
+}
+
+/* ---------- BACKEND CROSSOVER ---------- */
+// Throughput of one backend on batches of `blocks` blocks, in MB/s
+double measureBackend(const HillBackend& backend, size_t blocks, mt19937& rng) {
+    size_t n = backend.size();
+    vector<uint8_t> buffer(blocks * n);
+    for (uint8_t& x : buffer) x = rng() % 26;
+
+    // Aim for ~8MB of traffic per measurement
+    size_t reps = (8u << 20) / buffer.size() + 1;
+    auto start = steady_clock::now();
+    for (size_t r = 0; r < reps; r++) {
+        backend.apply(buffer.data(), buffer.data(), blocks);
+    }
+    double seconds = duration<double>(steady_clock::now() - start).count();
+    return double(buffer.size()) * reps / seconds / 1e6;
+}
+
+// Arithmetic kernels versus lookup tables across key and batch sizes
+void backendCrossover() {
+    mt19937 rng(26);
+    const int key_sizes[] = {2, 3, 4, 8, 16, 32, 64};
+    const size_t batch_sizes[] = {1, 16, 256, 4096, 65536};
+
+    cout << "\nBackend crossover (MB/s, letters in + out per second)\n";
+    cout << setw(4) << "n" << setw(9) << "blocks";
+    cout << setw(14) << "scalar" << setw(14) << "simd"
+         << setw(14) << "table-column" << setw(14) << "table-block" << setw(14) << "gemm" << "\n";
+
+    for (int n : key_sizes) {
+        vector<vector<int>> key = randomKey(n, rng);
+
+        auto t0 = steady_clock::now();
+        HillTable block_table(key, true);
+        double setup_us = duration<double, micro>(steady_clock::now() - t0).count();
+
+        HillKernel scalar(key, HillKernel::SCALAR);
+        HillKernel simd(key);
+        HillTable column_table(key, false);
+        HillGemm gemm(key);
+
+        for (size_t blocks : batch_sizes) {
+            cout << setw(4) << n << setw(9) << blocks << fixed << setprecision(0);
+            cout << setw(14) << measureBackend(scalar, blocks, rng);
+            if (simd.level() != HillKernel::SCALAR) {
+                cout << setw(14) << measureBackend(simd, blocks, rng);
+            } else {
+                cout << setw(14) << "-";
+            }
+            cout << setw(14) << measureBackend(column_table, blocks, rng);
+            if (n <= 3) {
+                cout << setw(14) << measureBackend(block_table, blocks, rng);
+            } else {
+                cout << setw(14) << "-";
+            }
+            cout << setw(14) << measureBackend(gemm, blocks, rng);
+            cout << "\n";
+        }
+        cout << "     table setup " << setprecision(1) << setup_us << " us, "
+             << block_table.footprint() << " bytes\n";
+    }
+}
+
+// GEMM scaling: a batch costs n*n multiply-adds per block, so if the
+// backend is compute-bound, GMAC/s stays flat while MB/s falls as 1/n
+void gemmScaling(const Settings& settings) {
+    mt19937 rng(26);
+    const size_t letters = 1u << 20;
+
+    cout << "\nGEMM scaling (" << HillGemm(randomKey(1, rng)).name() << ", batches of "
+         << sizeName(letters) << " letters, best of 5)\n";
+    cout << setw(4) << "n" << setw(12) << "MB/s" << setw(14) << "blocks/s" << setw(12) << "GMAC/s" << "\n";
+
+    for (int n : settings.keySizes) {
+        HillGemm gemm(randomKey(n, rng));
+        size_t blocks = letters / n;
+        vector<uint8_t> buffer(blocks * n);
+        for (uint8_t& x : buffer) x = rng() % 26;
+
+        double best = 1e30;
+        for (int run = 0; run < 5; run++) {
+            auto start = steady_clock::now();
+            gemm.apply(buffer.data(), buffer.data(), blocks);
+            best = min(best, duration<double>(steady_clock::now() - start).count());
+        }
+        double blocks_per_s = blocks / best;
+        cout << setw(4) << n << fixed << setprecision(1) << setw(12) << blocks_per_s * n / 1e6
+             << setprecision(0) << setw(14) << blocks_per_s
+             << setprecision(2) << setw(12) << blocks_per_s * n * n / 1e9 << "\n";
+    }
+}
+
+/* ---------- MAIN ---------- */
+int main(int argc, char* argv[]) {
+    Settings settings;
+    try {
+        for (int i = 1; i < argc; i++) {
+            string arg = argv[i];
+            if (arg == "--max-bytes" && i + 1 < argc) {
+                settings.maxBytes = parseSize(argv[++i]);
+            } else if (arg == "--keys" && i + 1 < argc) {
+                settings.keySizes.clear();
+                stringstream list(argv[++i]);
+                string item;
+                while (getline(list, item, ',')) settings.keySizes.push_back(stoi(item));
+            } else if (arg == "--budget" && i + 1 < argc) {
+                settings.budget = stod(argv[++i]);
+            } else if (arg == "--only" && i + 1 < argc) {
+                settings.only = argv[++i];
+            } else if (arg == "--json" && i + 1 < argc) {
+                settings.jsonPath = argv[++i];
+            } else if (arg == "--threads" && i + 1 < argc) {
+                settings.threads = stoul(argv[++i]);
+            } else if (arg == "--crossover") {
+                settings.crossover = true;
+            } else if (arg == "--gemm") {
+                settings.gemm = true;
+            } else {
+                cerr << "Usage: benchmark [--max-bytes 16M] [--keys 2,3,4,8,16,32,64] [--budget seconds]\n"
+                     << "       [--only operation] [--json results.json] [--threads n] [--crossover]\n"
+                     << "       [--gemm]\n";
+                return 2;
+            }
+        }
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 2;
+    }
+    ThreadPool pool(settings.threads);
+    settings.pool = &pool;
+
+    cout << "Hill cipher benchmark (cpu level: "
+         << HillKernel::levelName(HillKernel::detect()) << ", "
+         << pool.size() << " threads)\n\n";
+
+    try {
+        mt19937 rng(26);
+        printHeader();
+        if (wanted(settings, "multiplyMatrixVector")) benchMultiplyMatrixVector(settings, rng);
+        if (wanted(settings, "inverseMatrix")) benchInverseMatrix(settings, rng);
+        benchConversions(settings, rng);
+        if (wanted(settings, "encryptWithSpaces")) benchEncryptWithSpaces(settings, rng);
+        benchMessageCore(settings, rng);
+        if (wanted(settings, "reconstructWithSpaces")) benchReconstructWithSpaces(settings, rng);
+
+        if (settings.crossover) backendCrossover();
+        if (settings.gemm) gemmScaling(settings);
+        if (!settings.jsonPath.empty()) {
+            writeJson(settings);
+            cout << "\nResults written to " << settings.jsonPath << "\n";
+        }
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
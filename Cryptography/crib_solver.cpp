@@ -0,0 +1,212 @@
+#include "crib_solver.h"
+#include "matrix_utils.h"
+#include "hill_normalize.h"
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+
+using namespace std;
+
+// Letters decrypted for the trigram score of each surviving key
+static const size_t SCORE_SAMPLE_LETTERS = 600;
+
+// Block subsets tried per phase before giving up on an invertible one
+static const size_t MAX_SUBSETS = 20000;
+
+/* ---------- HELPERS ---------- */
+static vector<uint8_t> lettersOf(const string& text) {
+    vector<uint8_t> letters(text.size());
+    letters.resize(scanText(text.data(), text.size(), letters.data()).letters);
+    return letters;
+}
+
+// Next n-subset of [0, count) in lexicographic order; false after the last
+static bool nextSubset(vector<size_t>& pick, size_t count) {
+    int n = pick.size();
+    for (int i = n - 1; i >= 0; i--) {
+        if (pick[i] < count - n + i) {
+            pick[i]++;
+            for (int j = i + 1; j < n; j++) pick[j] = pick[j - 1] + 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* ---------- SETUP ---------- */
+// Consecutive windows of blocks first, then any subset
+bool CribSolver::findBasis(const vector<size_t>& blocks, int prime, Basis& basis) const {
+    size_t count = blocks.size();
+    if (count < size_t(n)) return false;
+
+    // Column j of P is crib block pick[j]
+    vector<vector<int>> p(n, vector<int>(n));
+    auto invertible = [&](const vector<size_t>& pick) {
+        for (int j = 0; j < n; j++)
+            for (int i = 0; i < n; i++) p[i][j] = crib[blocks[pick[j]] + i];
+        return MatrixUtils::isInvertible(p, prime);
+    };
+    vector<size_t> pick(n);
+    bool found = false;
+    for (size_t k = 0; k + n <= count && !found; k++) {
+        for (int j = 0; j < n; j++) pick[j] = k + j;
+        found = invertible(pick);
+    }
+    if (!found) {
+        for (int j = 0; j < n; j++) pick[j] = j;
+        for (size_t tried = 0; !found && tried < MAX_SUBSETS; tried++) {
+            found = invertible(pick);
+            if (!found && !nextSubset(pick, count)) break;
+        }
+    }
+    if (!found) return false;
+
+    basis.picks = pick;
+    basis.inverse.clear();
+    for (auto& row : MatrixUtils::inverseMatrix(p, prime)) {
+        basis.inverse.insert(basis.inverse.end(), row.begin(), row.end());
+    }
+    return true;
+}
+
+CribSolver::CribSolver(const string& text, int n)
+    : n(n), crib(lettersOf(text)), phases(n), pool(nullptr), model(nullptr),
+      triedCount(0), singularCount(0), mismatchCount(0) {
+    if (n < 2) {
+        throw runtime_error("Key size must be at least 2");
+    }
+
+    bool any = false;
+    for (int q = 0; q < n; q++) {
+        Phase& phase = phases[q];
+        for (size_t start = q; start + n <= crib.size(); start += n) {
+            phase.blocks.push_back(start);
+        }
+        phase.usable = findBasis(phase.blocks, 2, phase.mod2) &&
+                       findBasis(phase.blocks, 13, phase.mod13);
+        if (!phase.usable) continue;
+
+        phase.spare = 0;
+        for (size_t k = 0; k < phase.blocks.size(); k++) {
+            const vector<size_t>& a = phase.mod2.picks;
+            const vector<size_t>& b = phase.mod13.picks;
+            if (find(a.begin(), a.end(), k) == a.end() && find(b.begin(), b.end(), k) == b.end()) {
+                phase.spare++;
+            }
+        }
+        any = true;
+    }
+    if (!any) {
+        throw runtime_error("Crib is too short or too regular to solve a " + to_string(n) + "x" +
+                            to_string(n) + " key");
+    }
+}
+
+/* ---------- SOLVE ---------- */
+vector<CribMatch> CribSolver::solve(const string& ciphertext, size_t top) {
+    vector<uint8_t> c = lettersOf(ciphertext);
+    vector<CribMatch> matches;
+    if (c.size() < crib.size()) return matches;
+    size_t alignments = c.size() - crib.size() + 1;
+
+    // Sample decrypted for scoring
+    size_t sample = min(c.size(), SCORE_SAMPLE_LETTERS) / n * n;
+
+    mutex merge_lock;
+    auto solveRange = [&](size_t first, size_t count) {
+        vector<vector<int>> k(n, vector<int>(n));
+        vector<int> k2(n * n), k13(n * n);
+        vector<int> x(n);
+        auto solveMod = [&](size_t a, const Phase& phase, const Basis& basis, int prime,
+                            vector<int>& out) {
+            for (int i = 0; i < n; i++) {
+                for (int col = 0; col < n; col++) {
+                    int sum = 0;
+                    for (int j = 0; j < n; j++) {
+                        const uint8_t* block = c.data() + a + phase.blocks[basis.picks[j]];
+                        sum += block[i] * basis.inverse[j * n + col];
+                    }
+                    out[i * n + col] = sum % prime;
+                }
+            }
+        };
+        vector<uint8_t> plain(sample);
+        vector<CribMatch> found;
+        uint64_t singular = 0, mismatch = 0;
+
+        for (size_t a = first; a < first + count; a++) {
+            const Phase& phase = phases[(n - a % n) % n];
+            if (!phase.usable) continue;
+
+            // K = C P^-1 mod each prime, C being the ciphertext blocks under
+            // that basis as columns
+            solveMod(a, phase, phase.mod2, 2, k2);
+            solveMod(a, phase, phase.mod13, 13, k13);
+            for (int i = 0; i < n; i++) {
+                for (int col = 0; col < n; col++) {
+                    int r = k13[i * n + col];
+                    k[i][col] = (r % 2 == k2[i * n + col]) ? r : r + 13;
+                }
+            }
+            int det = MatrixUtils::determinant(k);
+            if (det % 2 == 0 || det % 13 == 0) {
+                singular++;
+                continue;
+            }
+
+            // Every crib block must encrypt to the ciphertext under it
+            bool consistent = true;
+            for (size_t at : phase.blocks) {
+                for (int i = 0; i < n; i++) x[i] = crib[at + i];
+                for (int i = 0; i < n && consistent; i++) {
+                    int sum = 0;
+                    for (int j = 0; j < n; j++) sum += k[i][j] * x[j];
+                    consistent = (sum % 26 == c[a + at + i]);
+                }
+                if (!consistent) break;
+            }
+            if (!consistent) {
+                mismatch++;
+                continue;
+            }
+
+            CribMatch match;
+            match.offset = a;
+            match.key = k;
+            match.confirmedBlocks = phase.spare;
+            match.score = 0;
+            if (model && sample > 0) {
+                vector<vector<int>> inverse = MatrixUtils::inverseMatrix(k);
+                for (size_t b = 0; b < sample; b += n) {
+                    for (int i = 0; i < n; i++) {
+                        int sum = 0;
+                        for (int j = 0; j < n; j++) sum += inverse[i][j] * c[b + j];
+                        plain[b + i] = uint8_t(sum % 26);
+                    }
+                }
+                match.score = model->score(plain.data(), plain.size());
+            }
+            found.push_back(match);
+        }
+
+        triedCount += count;
+        singularCount += singular;
+        mismatchCount += mismatch;
+        lock_guard<mutex> guard(merge_lock);
+        matches.insert(matches.end(), found.begin(), found.end());
+    };
+
+    if (pool) {
+        pool->forRanges(alignments, 1024, solveRange);
+    } else {
+        solveRange(0, alignments);
+    }
+
+    sort(matches.begin(), matches.end(), [](const CribMatch& l, const CribMatch& r) {
+        if (l.confirmedBlocks != r.confirmedBlocks) return l.confirmedBlocks > r.confirmedBlocks;
+        if (l.score != r.score) return l.score > r.score;
+        return l.offset < r.offset;
+    });
+    if (matches.size() > top) matches.resize(top);
+    return matches;
+}
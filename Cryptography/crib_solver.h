@@ -0,0 +1,77 @@
+#ifndef CRIB_SOLVER_H
+#define CRIB_SOLVER_H
+
+#include "ngram_model.h"
+#include "hill_parallel.h"
+#include <vector>
+#include <string>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// A key that maps the crib onto the ciphertext at one alignment
+struct CribMatch {
+    size_t offset;                        // crib start, in ciphertext letters
+    std::vector<std::vector<int>> key;
+    size_t confirmedBlocks;               // crib blocks beyond the n solved for
+    double score;                         // trigram score of the decryption
+};
+
+// Known-plaintext solver with crib dragging: the crib is tried at every
+// letter offset of the ciphertext and the key is solved from C = K P.
+//
+// Which crib letters fall into whole blocks depends only on the offset mod
+// n, so the crib block matrix P and its inverse are computed once per phase
+// (a handful of eliminations in total). 26 = 2 * 13, and P is chosen and
+// inverted separately mod 2 and mod 13, so a crib whose blocks are never
+// invertible mod 26 together can still pin the key down. Each alignment then
+// costs two n x n products, a determinant check and a comparison against
+// the crib blocks. Alignments are split across the thread pool.
+class CribSolver {
+public:
+    // The crib is reduced to its letters; throws if it cannot fill n blocks
+    // with an invertible set at some phase
+    CribSolver(const std::string& crib, int n);
+
+    // Spread alignments over a thread pool (nullptr = calling thread only)
+    void setThreadPool(ThreadPool* threads) { pool = threads; }
+
+    // Rank keys by how well they decrypt the ciphertext (nullptr = off)
+    void setModel(const NgramModel* scoring) { model = scoring; }
+
+    // Keys from every alignment that passes, best first: most confirmed
+    // crib blocks, then highest score
+    std::vector<CribMatch> solve(const std::string& ciphertext, size_t top = 10);
+
+    uint64_t alignmentsTried() const { return triedCount; }
+    uint64_t rejectedSingular() const { return singularCount; }
+    uint64_t rejectedMismatch() const { return mismatchCount; }
+
+private:
+    // n crib blocks whose matrix is invertible mod a prime, and its inverse
+    struct Basis {
+        std::vector<size_t> picks;        // positions in Phase::blocks
+        std::vector<int> inverse;         // flat n x n, P^-1 mod the prime
+    };
+
+    // Crib blocks starting at crib letter `phase`
+    struct Phase {
+        bool usable;
+        std::vector<size_t> blocks;       // crib letter index of each block
+        Basis mod2, mod13;
+        size_t spare;                     // blocks in neither basis
+    };
+
+    bool findBasis(const std::vector<size_t>& blocks, int prime, Basis& basis) const;
+
+    int n;
+    std::vector<uint8_t> crib;
+    std::vector<Phase> phases;
+    ThreadPool* pool;
+    const NgramModel* model;
+    std::atomic<uint64_t> triedCount;
+    std::atomic<uint64_t> singularCount;
+    std::atomic<uint64_t> mismatchCount;
+};
+
+#endif
@@ -0,0 +1,191 @@
+#include "hill_server.h"
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <csignal>
+#include <memory>
+
+using namespace std;
+using namespace chrono;
+
+const vector<vector<int>> KEY_MATRIX = {
+    {6, 24, 1},
+    {13, 16, 10},
+    {20, 17, 15}
+};
+
+/* ---------- SERVE ---------- */
+HillServer* running = nullptr;
+
+void requestStop(int) {
+    if (running) running->stop();
+}
+
+int serve(const string& socket_path, const vector<vector<int>>& key_matrix, unsigned threads) {
+    ThreadPool pool(threads);
+    HillServer server(socket_path, make_shared<HillKey>(key_matrix));
+    server.setThreadPool(&pool);
+
+    running = &server;
+    signal(SIGINT, requestStop);
+    signal(SIGTERM, requestStop);
+    cerr << "Listening on " << socket_path << "\n";
+    server.run();
+    running = nullptr;
+
+    cerr << "Served " << server.requests() << " requests in " << server.batches() << " batches\n";
+    return 0;
+}
+
+/* ---------- BENCH ---------- */
+// `clients` connections each send `requests` encrypt+decrypt pairs of a
+// short message and check the round trip
+int bench(const string& socket_path, unsigned clients, size_t requests, size_t length) {
+    string message;
+    const char* words = "attack at dawn ";
+    for (size_t i = 0; message.size() < length; i++) {
+        message += words[i % 15];
+    }
+
+    vector<vector<double>> latencies(clients);
+    vector<size_t> failures(clients, 0);
+    vector<string> errors(clients);     // a thread must not let an exception escape
+    vector<thread> workers;
+    auto start = steady_clock::now();
+    for (unsigned c = 0; c < clients; c++) {
+        workers.emplace_back([&, c]() {
+            try {
+                HillClient client(socket_path);
+                string expected;
+                for (char ch : message) {
+                    if (ch != ' ') expected += char(toupper((unsigned char)ch));
+                }
+                for (size_t r = 0; r < requests; r++) {
+                    auto t0 = steady_clock::now();
+                    string decrypted = client.decrypt(client.encrypt(message));
+                    latencies[c].push_back(duration<double, micro>(steady_clock::now() - t0).count());
+                    if (decrypted != expected) failures[c]++;
+                }
+            } catch (const exception& e) {
+                errors[c] = e.what();
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (const string& error : errors) {
+        if (!error.empty()) {
+            cerr << "Error: " << error << "\n";
+            return 1;
+        }
+    }
+    double seconds = duration<double>(steady_clock::now() - start).count();
+
+    vector<double> all;
+    size_t failed = 0;
+    for (unsigned c = 0; c < clients; c++) {
+        all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+        failed += failures[c];
+    }
+    sort(all.begin(), all.end());
+    auto percentile = [&](double p) {
+        return all.empty() ? 0.0 : all[min(all.size() - 1, size_t(p * all.size()))];
+    };
+
+    cout << fixed << setprecision(1)
+         << clients << " clients, " << all.size() << " round trips of " << length << " bytes in "
+         << setprecision(3) << seconds << " s (" << setprecision(0) << 2 * all.size() / seconds
+         << " requests/s)\n" << setprecision(1)
+         << "round trip us: p50 " << percentile(0.5) << "  p90 " << percentile(0.9)
+         << "  p99 " << percentile(0.99) << "\n";
+    HillClient client(socket_path);
+    cout << client.stats();
+    if (failed > 0) {
+        cerr << "Error: " << failed << " round trips did not match\n";
+        return 1;
+    }
+    return 0;
+}
+
+/* ---------- MAIN ---------- */
+// Resident cipher server on a Unix domain socket:
+//   hilld serve [--key K]           keep keys loaded and answer requests
+//   hilld encrypt|decrypt [--key K] one request with stdin, reply on stdout
+//   hilld stats                     server counters
+//   hilld bench                     concurrent small-request latency
+int main(int argc, char* argv[]) {
+    string mode = argc > 1 ? argv[1] : "";
+    string socket_path = "/tmp/hilld.sock";
+    vector<vector<int>> key_matrix = KEY_MATRIX;
+    bool custom_key = false;
+    unsigned threads = 1, clients = 4;
+    size_t requests = 10000, length = 64;
+
+    try {
+        if (mode != "serve" && mode != "encrypt" && mode != "decrypt" &&
+            mode != "stats" && mode != "bench") {
+            throw invalid_argument("unknown mode");
+        }
+        for (int i = 2; i < argc; i++) {
+            string arg = argv[i];
+            if (arg == "--socket" && i + 1 < argc) {
+                socket_path = argv[++i];
+            } else if (arg == "--key" && i + 1 < argc) {
+                key_matrix = HillKey::parse(argv[++i]);
+                custom_key = true;
+            } else if (arg == "--threads" && i + 1 < argc) {
+                threads = stoul(argv[++i]);
+            } else if (arg == "--clients" && i + 1 < argc) {
+                clients = stoul(argv[++i]);
+            } else if (arg == "--requests" && i + 1 < argc) {
+                requests = stoull(argv[++i]);
+            } else if (arg == "--length" && i + 1 < argc) {
+                length = stoull(argv[++i]);
+            } else {
+                throw invalid_argument(arg);
+            }
+        }
+    } catch (const exception&) {
+        cerr << "Usage: hilld serve [--socket P] [--key \"a b; c d\"] [--threads n (0 = all cores)]\n"
+             << "       hilld encrypt|decrypt [--socket P] [--key \"a b; c d\"] < input\n"
+             << "       hilld stats [--socket P]\n"
+             << "       hilld bench [--socket P] [--clients n] [--requests n] [--length bytes]\n";
+        return 2;
+    }
+
+    try {
+        if (mode == "serve") {
+            return serve(socket_path, key_matrix, threads);
+        }
+        if (mode == "bench") {
+            return bench(socket_path, clients, requests, length);
+        }
+
+        HillClient client(socket_path);
+        if (mode == "stats") {
+            cout << client.stats();
+            return 0;
+        }
+
+        // Without --key the server's own key is used
+        stringstream input;
+        input << cin.rdbuf();
+        string text = input.str();
+        vector<vector<int>> key = custom_key ? key_matrix : vector<vector<int>>();
+        if (mode == "encrypt") {
+            cout << client.encrypt(text, key) << "\n";
+        } else {
+            // Trailing newline from the shell is not part of the ciphertext
+            while (!text.empty() && isspace((unsigned char)text.back())) text.pop_back();
+            cout << client.decrypt(text, key) << "\n";
+        }
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
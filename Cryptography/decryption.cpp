@@ -1,4 +1,13 @@
 #include "matrix_utils.h"
+#include "hill_file.h"
+#include "hill_index.h"
+#include "hill_key.h"
+#include "hill_cipher.h"
+#include "hill_parallel.h"
+#include "hill_message.h"
+#include "hill_metrics.h"
+#include "hill_bytes.h"
+#include "hill_format.h"
 #include <iostream>
 #include <fstream>
 #include <chrono>
@@ -8,15 +17,19 @@
 #include <vector>
 #include <sstream>
 #include <limits>
+#include <memory>
 
 using namespace std;
 using namespace chrono;
 
-const vector<vector<int>> KEY_MATRIX = {
-    {6, 24, 1},
-    {13, 16, 10},
-    {20, 17, 15}
-};
+// Compiled-in key: its inverse is worked out, and its invertibility
+// checked, by the compiler
+typedef HillCipher<3,
+                   6, 24, 1,
+                   13, 16, 10,
+                   20, 17, 15> CompiledCipher;
+
+const vector<vector<int>> KEY_MATRIX = CompiledCipher::matrix();
 
 /* ---------- UI ---------- */
 void clearScreen() {
@@ -42,30 +55,204 @@ void box(const string& k, const string& v) {
 }
 
 /* ---------- CORE ---------- */
-// Reconstruct original message with spaces
-string reconstructWithSpaces(const string& decrypted_letters, 
-                            const vector<int>& space_positions, 
-                            int original_length) {
-    
-    string result = decrypted_letters;
-    
-    // Insert spaces at stored positions
-    for (int pos : space_positions) {
-        if (pos <= result.length()) {
-            result.insert(pos, " ");
+// The compiled-in key comes ready-made unless --key or --backend chose
+// something else
+shared_ptr<HillKey> buildKey(const vector<vector<int>>& matrix, BackendType backend) {
+    if (matrix == KEY_MATRIX && backend == BACKEND_AUTO) {
+        return make_shared<HillKey>(CompiledCipher::makeKey());
+    }
+    return make_shared<HillKey>(matrix, backend);
+}
+
+// Counter-offset mode when --nonce was given
+unique_ptr<HillCounter> makeCounter(const string& nonceText, int n, int modulus) {
+    if (nonceText.empty()) return nullptr;
+    return unique_ptr<HillCounter>(new HillCounter(HillCounter::parseNonce(nonceText), n, modulus));
+}
+
+/* ---------- COMMAND LINE MODE ---------- */
+// Non-interactive runs:
+//   --stream           ciphertext on stdin, plaintext on stdout
+//   --file IN OUT      memory-mapped file to file (buffered if IN is a pipe)
+//   --file IN --in-place --no-map   transform IN where it lies
+//   --ring NAME        records from `encryption --ring NAME`, plaintext on
+//                      stdout; spaces travel in the records
+//   --build-index FILE index sidecar (FILE.idx) for random access
+//   --range A B FILE   plaintext bytes [A, B) of FILE via its index
+//   --preserve         with --stream or --file: reverses encryption
+//                      --preserve, in place if asked; no space map
+// The space map is read lazily alongside, so memory use is bounded by the
+// chunk size.
+int commandLineMode(int argc, char* argv[]) {
+    string map_path = "space_map.bin";
+    string in_path, out_path, ring_name;
+    string index_cipher, index_path, range_cipher;
+    string metrics_path, nonce_text;
+    uint64_t range_begin = 0, range_end = 0, checkpoint_blocks = 1024;
+    bool use_file = false, in_place = false, use_bytes = false, preserve = false;
+    size_t chunk_size = 0;
+    BackendType backend = BACKEND_AUTO;
+    unsigned threads = 1;
+    vector<vector<int>> key_matrix = KEY_MATRIX;
+    bool use_map = true;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            string arg = argv[i];
+            if (arg == "--stream") {
+                use_file = false;
+            } else if (arg == "--file" && i + 1 < argc) {
+                use_file = true;
+                in_path = argv[++i];
+                if (i + 1 < argc && argv[i + 1][0] != '-') out_path = argv[++i];
+            } else if (arg == "--in-place") {
+                in_place = true;
+            } else if (arg == "--bytes") {
+                use_bytes = true;
+            } else if (arg == "--preserve") {
+                preserve = true;
+            } else if (arg == "--ring" && i + 1 < argc) {
+                ring_name = argv[++i];
+            } else if (arg == "--build-index" && i + 1 < argc) {
+                index_cipher = argv[++i];
+            } else if (arg == "--range" && i + 3 < argc) {
+                range_begin = stoull(argv[++i]);
+                range_end = stoull(argv[++i]);
+                range_cipher = argv[++i];
+            } else if (arg == "--index" && i + 1 < argc) {
+                index_path = argv[++i];
+            } else if (arg == "--checkpoint" && i + 1 < argc) {
+                checkpoint_blocks = stoull(argv[++i]);
+            } else if (arg == "--map" && i + 1 < argc) {
+                map_path = argv[++i];
+            } else if (arg == "--no-map") {
+                use_map = false;
+            } else if (arg == "--chunk" && i + 1 < argc) {
+                chunk_size = stoul(argv[++i]);
+            } else if (arg == "--key" && i + 1 < argc) {
+                key_matrix = HillKey::parse(argv[++i]);
+            } else if (arg == "--backend" && i + 1 < argc) {
+                backend = parseBackendType(argv[++i]);
+            } else if (arg == "--threads" && i + 1 < argc) {
+                threads = stoul(argv[++i]);
+            } else if (arg == "--metrics" && i + 1 < argc) {
+                metrics_path = argv[++i];
+            } else if (arg == "--nonce" && i + 1 < argc) {
+                nonce_text = argv[++i];
+            } else {
+                cerr << "Usage: decryption --stream | --file IN (OUT | --in-place) | --ring NAME\n"
+                     << "       | --build-index FILE [--checkpoint blocks] | --range A B FILE\n"
+                     << "       [--index FILE.idx]\n"
+                     << "       [--map space_map.bin | --no-map] [--chunk bytes] [--key \"a b; c d\"]\n"
+                     << "       [--backend auto|kernel|table|gemm] [--threads n (0 = all cores)]\n"
+                     << "       [--bytes (binary data, mod 256)] [--nonce N (counter-offset mode)]\n"
+                     << "       [--preserve (text from encryption --preserve; no map)]\n"
+                     << "       [--metrics out.json|out.prom]\n";
+                return 2;
+            }
+        }
+        if (use_file && out_path.empty() && !in_place) {
+            throw runtime_error("--file needs an output path or --in-place");
+        }
+        if (use_bytes && (in_place || !ring_name.empty() || !index_cipher.empty() || !range_cipher.empty())) {
+            throw runtime_error("--bytes works with --stream or --file IN OUT only");
         }
+        if (preserve && (use_bytes || !ring_name.empty() || !index_cipher.empty() || !range_cipher.empty())) {
+            throw runtime_error("--preserve works with --stream or --file only");
+        }
+        if (!metrics_path.empty() && !METRICS_ENABLED) {
+            throw runtime_error("--metrics needs a build with -DHILL_METRICS");
+        }
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 2;
     }
-    
-    // Trim to original length if needed
-    if (result.length() > original_length) {
-        result = result.substr(0, original_length);
+    if (chunk_size == 0) {
+        // Threads only pay off once a chunk holds several task-sized ranges
+        chunk_size = (threads == 1) ? (1 << 16) : (1 << 22);
     }
-    
-    return result;
+    if (!use_map) map_path.clear();
+
+    if (use_bytes) {
+        try {
+            ByteKey key(key_matrix);
+            ThreadPool pool(threads);
+            unique_ptr<HillCounter> counter = makeCounter(nonce_text, key.size(), 256);
+            if (use_file) {
+                ifstream in(in_path, ios::binary);
+                if (!in) {
+                    throw runtime_error("Cannot open " + in_path);
+                }
+                ofstream out(out_path, ios::binary);
+                if (!out) {
+                    throw runtime_error("Cannot open " + out_path + " for writing");
+                }
+                decryptByteStream(key, in, out, chunk_size, &pool, counter.get());
+            } else {
+                ios::sync_with_stdio(false);
+                decryptByteStream(key, cin, cout, chunk_size, &pool, counter.get());
+            }
+            if (!metrics_path.empty()) saveMetrics(metrics_path);
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    try {
+        auto key = buildKey(key_matrix, backend);
+        ThreadPool pool(threads);
+        unique_ptr<HillCounter> counter = makeCounter(nonce_text, key->size(), 26);
+
+        if (preserve) {
+            if (use_file) {
+                decryptFormattedFile(*key, in_path, out_path, in_place, chunk_size, counter.get());
+            } else {
+                ios::sync_with_stdio(false);
+                decryptFormattedStream(*key, cin, cout, chunk_size, counter.get());
+            }
+        } else if (!index_cipher.empty()) {
+            if (index_path.empty()) index_path = index_cipher + ".idx";
+            CipherIndex::build(*key, index_cipher, map_path, checkpoint_blocks, counter.get())
+                .save(index_path);
+        } else if (!range_cipher.empty()) {
+            if (index_path.empty()) index_path = range_cipher + ".idx";
+            RangeDecryptor ranges(key, range_cipher, map_path, index_path, counter.get());
+            cout << ranges.read(range_begin, range_end);
+        } else if (!ring_name.empty()) {
+            ShmRing ring(ring_name, ShmRing::CONSUMER);
+            ios::sync_with_stdio(false);
+            decryptFromRing(key, ring, cout, &pool, counter.get());
+        } else if (use_file) {
+            decryptFile(key, in_path, out_path, map_path, in_place, chunk_size, &pool, counter.get());
+        } else {
+            ifstream space_in;
+            unique_ptr<SpaceMapReader> space_map;
+            if (use_map) {
+                space_in.open(map_path, ios::binary);
+                if (!space_in) {
+                    throw runtime_error("Cannot open " + map_path + " (use --no-map to skip)");
+                }
+                space_map.reset(new SpaceMapReader(space_in));
+            }
+            ios::sync_with_stdio(false);
+            decryptStream(key, cin, cout, space_map.get(), chunk_size, &pool, counter.get());
+        }
+        if (!metrics_path.empty()) saveMetrics(metrics_path);
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
 }
 
 /* ---------- MAIN ---------- */
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        return commandLineMode(argc, argv);
+    }
+
     while (true) {
         clearScreen();
         banner();
@@ -80,8 +267,8 @@ int main() {
         }
 
         string encrypted_text;
-        vector<int> space_positions;
-        int original_length = 0;
+        vector<uint64_t> space_positions;
+        uint64_t original_length = 0;
         
         if (choice == "1") {
             cout << "\nEnter encrypted text (no spaces) > ";
@@ -119,15 +306,20 @@ int main() {
             getline(enc_in, encrypted_text);
             enc_in.close();
             
-            // Try to load space map
-            ifstream space_in("space_map.txt");
+            // Try to load space map (binary, or the older text file)
+            ifstream space_in("space_map.bin", ios::binary);
+            if (!space_in) space_in.open("space_map.txt", ios::binary);
             if (space_in) {
-                int encrypted_length, space_count;
-                space_in >> original_length >> encrypted_length >> space_count;
-                
-                space_positions.resize(space_count);
-                for (int i = 0; i < space_count; i++) {
-                    space_in >> space_positions[i];
+                try {
+                    SpaceMapReader space_map(space_in);
+                    original_length = space_map.originalLength();
+                    space_positions = space_map.readAll();
+                } catch (const exception& e) {
+                    cout << "\n❌ Error: " << e.what() << "\n";
+                    cout << "Press ENTER to continue...";
+                    string dummy;
+                    getline(cin, dummy);
+                    continue;
                 }
                 space_in.close();
                 cout << "\n✓ Loaded encrypted text and space map\n";
@@ -146,28 +338,9 @@ int main() {
         try {
             auto start_time = high_resolution_clock::now();
             
-            // Decrypt (standard Hill cipher decryption)
-            int n = KEY_MATRIX.size();
-            static vector<vector<int>> inverse_key = MatrixUtils::inverseMatrix(KEY_MATRIX);
-            
-            string decrypted_letters;
-            for (size_t i = 0; i < encrypted_text.size(); i += n) {
-                vector<int> block;
-                for (int j = 0; j < n && (i + j) < encrypted_text.size(); j++) {
-                    block.push_back(encrypted_text[i + j] - 'A');
-                }
-
-                vector<int> res = MatrixUtils::multiplyMatrixVector(inverse_key, block, 26);
-
-                for (int x : res) {
-                    decrypted_letters += char('A' + (x % 26));
-                }
-            }
-
-            // Remove padding
-            while (!decrypted_letters.empty() && decrypted_letters.back() == 'X') {
-                decrypted_letters.pop_back();
-            }
+            // Decrypt (standard Hill cipher decryption), padding removed
+            static const HillKey key = CompiledCipher::makeKey();
+            string decrypted_letters = decryptLetters(encrypted_text, key);
             
             // Reconstruct with spaces if we have space map
             string final_decrypted;
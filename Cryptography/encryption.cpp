@@ -1,4 +1,13 @@
 #include "matrix_utils.h"
+#include "hill_file.h"
+#include "hill_key.h"
+#include "hill_cipher.h"
+#include "hill_parallel.h"
+#include "hill_message.h"
+#include "hill_batch.h"
+#include "hill_metrics.h"
+#include "hill_bytes.h"
+#include "hill_format.h"
 #include <iostream>
 #include <fstream>
 #include <chrono>
@@ -7,15 +16,19 @@
 #include <algorithm>
 #include <vector>
 #include <limits>
+#include <memory>
 
 using namespace std;
 using namespace chrono;
 
-const vector<vector<int>> KEY_MATRIX = {
-    {6, 24, 1},
-    {13, 16, 10},
-    {20, 17, 15}
-};
+// Compiled-in key: its inverse is worked out, and its invertibility
+// checked, by the compiler
+typedef HillCipher<3,
+                   6, 24, 1,
+                   13, 16, 10,
+                   20, 17, 15> CompiledCipher;
+
+const vector<vector<int>> KEY_MATRIX = CompiledCipher::matrix();
 
 /* ---------- UI ---------- */
 void clearScreen() {
@@ -41,50 +54,227 @@ void box(const string& k, const string& v) {
 }
 
 /* ---------- CORE ---------- */
-// Returns: encrypted text, and space positions for reconstruction
-pair<string, vector<int>> encryptWithSpaces(const string& msg) {
-    int n = KEY_MATRIX.size();
-    
-    // Store original space positions
-    vector<int> space_positions;
-    for (size_t i = 0; i < msg.length(); i++) {
-        if (msg[i] == ' ') {
-            space_positions.push_back(i);
-        }
+// Compiled-in key, prepared on first use
+const HillKey& compiledKey() {
+    static const HillKey key = CompiledCipher::makeKey();
+    return key;
+}
+
+// The compiled-in key comes ready-made unless --key or --backend chose
+// something else
+shared_ptr<HillKey> buildKey(const vector<vector<int>>& matrix, BackendType backend) {
+    if (matrix == KEY_MATRIX && backend == BACKEND_AUTO) {
+        return make_shared<HillKey>(CompiledCipher::makeKey());
     }
-    
-    // Remove spaces for Hill cipher
-    string letters_only;
-    for (char c : msg) {
-        if (isalpha(c)) {
-            letters_only += toupper(c);
-        }
+    return make_shared<HillKey>(matrix, backend);
+}
+
+// Counter-offset mode when --nonce was given. A random nonce is printed,
+// since decryption needs it.
+unique_ptr<HillCounter> makeCounter(const string& nonceText, int n, int modulus) {
+    if (nonceText.empty()) return nullptr;
+    uint64_t nonce = HillCounter::parseNonce(nonceText);
+    if (nonceText == "random") {
+        cerr << "Nonce: 0x" << hex << nonce << dec << "\n";
     }
+    return unique_ptr<HillCounter>(new HillCounter(nonce, n, modulus));
+}
 
-    // Pad if needed
-    while (letters_only.size() % n != 0)
-        letters_only += 'X';
+/* ---------- COMMAND LINE MODE ---------- */
+// Non-interactive runs:
+//   --stream           plaintext on stdin, ciphertext on stdout
+//   --file IN OUT      memory-mapped file to file (buffered if IN is a pipe)
+//   --file IN --in-place   transform IN where it lies
+//   --ring NAME        plaintext on stdin into a shared-memory ring that
+//                      `decryption --ring NAME` reads; no files involved
+//   --batch DIR OUTDIR / --manifest FILE   many files, each to its own
+//                      output and map, scheduled across --threads
+//   --preserve         with --stream or --file: letters encrypted in place,
+//                      everything else kept, no space map
+// The space map goes to a file either way, and memory use is bounded by the
+// chunk size regardless of input length.
+int commandLineMode(int argc, char* argv[]) {
+    string map_path = "space_map.bin";
+    SpaceMapFormat map_format = SPACE_MAP_BINARY;
+    string in_path, out_path, ring_name;
+    string batch_dir, batch_out, manifest_path;
+    string metrics_path, nonce_text;
+    bool use_file = false, in_place = false, use_bytes = false, preserve = false;
+    size_t chunk_size = 0;
+    BackendType backend = BACKEND_AUTO;
+    unsigned threads = 1;
+    vector<vector<int>> key_matrix = KEY_MATRIX;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            string arg = argv[i];
+            if (arg == "--stream") {
+                use_file = false;
+            } else if (arg == "--file" && i + 1 < argc) {
+                use_file = true;
+                in_path = argv[++i];
+                if (i + 1 < argc && argv[i + 1][0] != '-') out_path = argv[++i];
+            } else if (arg == "--in-place") {
+                in_place = true;
+            } else if (arg == "--bytes") {
+                use_bytes = true;
+            } else if (arg == "--preserve") {
+                preserve = true;
+            } else if (arg == "--ring" && i + 1 < argc) {
+                ring_name = argv[++i];
+            } else if (arg == "--batch" && i + 2 < argc) {
+                batch_dir = argv[++i];
+                batch_out = argv[++i];
+            } else if (arg == "--manifest" && i + 1 < argc) {
+                manifest_path = argv[++i];
+            } else if (arg == "--map" && i + 1 < argc) {
+                map_path = argv[++i];
+            } else if (arg == "--map-format" && i + 1 < argc) {
+                map_format = parseSpaceMapFormat(argv[++i]);
+            } else if (arg == "--chunk" && i + 1 < argc) {
+                chunk_size = stoul(argv[++i]);
+            } else if (arg == "--key" && i + 1 < argc) {
+                key_matrix = HillKey::parse(argv[++i]);
+            } else if (arg == "--backend" && i + 1 < argc) {
+                backend = parseBackendType(argv[++i]);
+            } else if (arg == "--threads" && i + 1 < argc) {
+                threads = stoul(argv[++i]);
+            } else if (arg == "--metrics" && i + 1 < argc) {
+                metrics_path = argv[++i];
+            } else if (arg == "--nonce" && i + 1 < argc) {
+                nonce_text = argv[++i];
+            } else {
+                cerr << "Usage: encryption --stream | --file IN (OUT | --in-place) | --ring NAME\n"
+                     << "       | --batch DIR OUTDIR | --manifest FILE\n"
+                     << "       [--map space_map.bin] [--map-format binary|text]\n"
+                     << "       [--chunk bytes] [--key \"a b; c d\"]\n"
+                     << "       [--backend auto|kernel|table|gemm] [--threads n (0 = all cores)]\n"
+                     << "       [--bytes (binary data, mod 256)] [--nonce N|random (counter-offset mode)]\n"
+                     << "       [--preserve (keep case, punctuation and line breaks; no map)]\n"
+                     << "       [--metrics out.json|out.prom]\n";
+                return 2;
+            }
+        }
+        if (use_file && out_path.empty() && !in_place) {
+            throw runtime_error("--file needs an output path or --in-place");
+        }
+        if (use_bytes && (in_place || !ring_name.empty() || !batch_dir.empty() || !manifest_path.empty())) {
+            throw runtime_error("--bytes works with --stream or --file IN OUT only");
+        }
+        if (preserve && (use_bytes || !ring_name.empty() || !batch_dir.empty() || !manifest_path.empty())) {
+            throw runtime_error("--preserve works with --stream or --file only");
+        }
+        if (!nonce_text.empty() && (!batch_dir.empty() || !manifest_path.empty())) {
+            throw runtime_error("--nonce does not work with batches");
+        }
+        if (!metrics_path.empty() && !METRICS_ENABLED) {
+            throw runtime_error("--metrics needs a build with -DHILL_METRICS");
+        }
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 2;
+    }
+    if (chunk_size == 0) {
+        // Threads only pay off once a chunk holds several task-sized ranges
+        chunk_size = (threads == 1) ? (1 << 16) : (1 << 22);
+    }
 
-    // Encrypt blocks
-    string encrypted_letters;
-    for (size_t i = 0; i < letters_only.size(); i += n) {
-        vector<int> block;
-        for (int j = 0; j < n; j++) {
-            block.push_back(letters_only[i + j] - 'A');
+    int status = 0;
+    if (use_bytes) {
+        try {
+            ByteKey key(key_matrix);
+            ThreadPool pool(threads);
+            unique_ptr<HillCounter> counter = makeCounter(nonce_text, key.size(), 256);
+            if (use_file) {
+                ifstream in(in_path, ios::binary);
+                if (!in) {
+                    throw runtime_error("Cannot open " + in_path);
+                }
+                ofstream out(out_path, ios::binary);
+                if (!out) {
+                    throw runtime_error("Cannot open " + out_path + " for writing");
+                }
+                encryptByteStream(key, in, out, chunk_size, &pool, counter.get());
+            } else {
+                ios::sync_with_stdio(false);
+                encryptByteStream(key, cin, cout, chunk_size, &pool, counter.get());
+            }
+            if (!metrics_path.empty()) saveMetrics(metrics_path);
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << "\n";
+            return 1;
         }
+        return 0;
+    }
 
-        vector<int> res = MatrixUtils::multiplyMatrixVector(KEY_MATRIX, block, 26);
+    try {
+        auto key = buildKey(key_matrix, backend);
+        ThreadPool pool(threads);
+        unique_ptr<HillCounter> counter = makeCounter(nonce_text, key->size(), 26);
 
-        for (int x : res) {
-            encrypted_letters += char('A' + (x % 26));
+        if (preserve) {
+            if (use_file) {
+                encryptFormattedFile(*key, in_path, out_path, in_place, chunk_size, counter.get());
+            } else {
+                ios::sync_with_stdio(false);
+                encryptFormattedStream(*key, cin, cout, chunk_size, counter.get());
+            }
+        } else if (!batch_dir.empty() || !manifest_path.empty()) {
+            vector<BatchItem> items;
+            if (!manifest_path.empty()) {
+                ifstream manifest(manifest_path);
+                if (!manifest) {
+                    throw runtime_error("Cannot open " + manifest_path);
+                }
+                items = readManifest(manifest);
+            } else {
+                items = listDirectory(batch_dir, batch_out);
+            }
+            BatchSettings settings;
+            settings.threads = threads;
+            settings.mapFormat = map_format;
+            BatchResult result = encryptBatch(key, items, settings);
+
+            for (const string& error : result.errors) {
+                cerr << "Error: " << error << "\n";
+            }
+            double mb = result.inputBytes / 1e6;
+            cout << fixed << setprecision(2)
+                 << result.files << " files (" << result.failed << " failed), " << mb << " MB in "
+                 << setprecision(3) << result.seconds << " s = " << setprecision(1)
+                 << mb / max(result.seconds, 1e-9) << " MB/s (" << result.tasks << " tasks, "
+                 << result.steals << " steals)\n";
+            status = result.failed ? 1 : 0;
+        } else if (!ring_name.empty()) {
+            ShmRing ring(ring_name, ShmRing::PRODUCER);
+            ios::sync_with_stdio(false);
+            encryptToRing(key, cin, ring, chunk_size, &pool, counter.get());
+        } else if (use_file) {
+            encryptFile(key, in_path, out_path, map_path, in_place, chunk_size, &pool, map_format,
+                        counter.get());
+        } else {
+            ofstream space_out(map_path, ios::binary);
+            if (!space_out) {
+                throw runtime_error("Cannot open " + map_path + " for writing");
+            }
+            ios::sync_with_stdio(false);
+            SpaceMapWriter space_map(space_out, map_format);
+            encryptStream(key, cin, cout, &space_map, chunk_size, &pool, counter.get());
         }
+        if (!metrics_path.empty()) saveMetrics(metrics_path);
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 1;
     }
-    
-    return {encrypted_letters, space_positions};
+    return status;
 }
 
 /* ---------- MAIN ---------- */
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        return commandLineMode(argc, argv);
+    }
+
     while (true) {
         clearScreen();
         banner();
@@ -141,7 +331,7 @@ int main() {
 
         try {
             auto start_time = high_resolution_clock::now();
-            auto result = encryptWithSpaces(message);
+            auto result = encryptWithSpaces(message, compiledKey());
             string encrypted = result.first;
             vector<int> space_positions = result.second;
             auto end_time = high_resolution_clock::now();
@@ -166,17 +356,15 @@ int main() {
             }
             
             // Save space map
-            ofstream space_out("space_map.txt");
+            ofstream space_out("space_map.bin", ios::binary);
             if (space_out) {
-                // Format: original_length encrypted_length space_count pos1 pos2 pos3...
-                space_out << message.length() << " " 
-                         << encrypted.length() << " " 
-                         << space_positions.size();
+                SpaceMapWriter space_map(space_out);
                 for (int pos : space_positions) {
-                    space_out << " " << pos;
+                    space_map.add(pos);
                 }
+                space_map.finish(message.length(), encrypted.length());
                 space_out.close();
-                cout << "✓ Space map saved to space_map.txt\n";
+                cout << "✓ Space map saved to space_map.bin\n";
             }
             
         } catch (const exception& e) {
@@ -0,0 +1,291 @@
+#include "hill_attack.h"
+#include "hill_kernel.h"
+#include "matrix_utils.h"
+#include "hill_normalize.h"
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HILL_ATTACK_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Scoring sample used when setSampleLength() is not called
+static const size_t DEFAULT_SAMPLE_LETTERS = 1200;
+
+/* ---------- COLUMN UPDATE ---------- */
+// p[i] = (p[i] + col[i]) mod 26 for values already in 0..25
+static void addColumnScalar(uint8_t* p, const uint8_t* col, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint8_t x = p[i] + col[i];
+        p[i] = x >= 26 ? x - 26 : x;
+    }
+}
+
+#ifdef HILL_ATTACK_X86
+// x - 26 wraps past 229 when x < 26, so the unsigned minimum picks the
+// reduced value either way
+__attribute__((target("avx2")))
+static void addColumnAVX2(uint8_t* p, const uint8_t* col, size_t count) {
+    const __m256i m = _mm256_set1_epi8(26);
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i x = _mm256_add_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i)),
+                                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(col + i)));
+        x = _mm256_min_epu8(x, _mm256_sub_epi8(x, m));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p + i), x);
+    }
+    addColumnScalar(p + i, col + i, count - i);
+}
+#endif
+
+static void addColumn(uint8_t* p, const uint8_t* col, size_t count) {
+#ifdef HILL_ATTACK_X86
+    static const bool avx2 = HillKernel::detect() == HillKernel::AVX2;
+    if (avx2) {
+        addColumnAVX2(p, col, count);
+        return;
+    }
+#endif
+    addColumnScalar(p, col, count);
+}
+
+/* ---------- ROW SCORING ---------- */
+// Sum of the letter log-probabilities of p[0] .. p[count - 1]
+static double unigramScoreScalar(const uint8_t* p, size_t count, const float* uni) {
+    uint32_t counts[26] = {0};
+    for (size_t b = 0; b < count; b++) counts[p[b]]++;
+    double score = 0;
+    for (int l = 0; l < 26; l++) score += counts[l] * uni[l];
+    return score;
+}
+
+#ifdef HILL_ATTACK_X86
+// 16 letters per step: widened to 32-bit indices and looked up with two
+// 8-lane gathers, each into its own sum
+__attribute__((target("avx2")))
+static double unigramScoreAVX2(const uint8_t* p, size_t count, const float* uni) {
+    __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+    size_t b = 0;
+    for (; b + 16 <= count; b += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + b));
+        sum0 = _mm256_add_ps(sum0, _mm256_i32gather_ps(uni, _mm256_cvtepu8_epi32(v), 4));
+        sum1 = _mm256_add_ps(sum1, _mm256_i32gather_ps(uni, _mm256_cvtepu8_epi32(_mm_srli_si128(v, 8)), 4));
+    }
+    float lanes[8];
+    _mm256_storeu_ps(lanes, _mm256_add_ps(sum0, sum1));
+    double score = 0;
+    for (float x : lanes) score += x;
+    for (; b < count; b++) score += uni[p[b]];
+    return score;
+}
+#endif
+
+static double unigramScore(const uint8_t* p, size_t count, const float* uni) {
+#ifdef HILL_ATTACK_X86
+    static const bool avx2 = HillKernel::detect() == HillKernel::AVX2;
+    if (avx2) return unigramScoreAVX2(p, count, uni);
+#endif
+    return unigramScoreScalar(p, count, uni);
+}
+
+/* ---------- HELPERS ---------- */
+// (score, id) pairs; keeps the `limit` highest scores seen
+class TopList {
+public:
+    explicit TopList(size_t limit) : limit(limit) {}
+
+    void offer(double score, uint64_t id) {
+        if (items.size() < limit) {
+            items.push_back(make_pair(score, id));
+            push_heap(items.begin(), items.end(), greater<pair<double, uint64_t>>());
+        } else if (score > items.front().first) {
+            pop_heap(items.begin(), items.end(), greater<pair<double, uint64_t>>());
+            items.back() = make_pair(score, id);
+            push_heap(items.begin(), items.end(), greater<pair<double, uint64_t>>());
+        }
+    }
+
+    void merge(const TopList& other) {
+        for (auto& item : other.items) offer(item.first, item.second);
+    }
+
+    // Highest score first
+    vector<pair<double, uint64_t>> sorted() const {
+        vector<pair<double, uint64_t>> out = items;
+        sort(out.begin(), out.end(), greater<pair<double, uint64_t>>());
+        return out;
+    }
+
+private:
+    size_t limit;
+    vector<pair<double, uint64_t>> items;   // min-heap on score
+};
+
+// Row entries from a base-26 code, most significant first
+static void decodeRow(uint64_t code, int n, int* row) {
+    for (int j = n - 1; j >= 0; j--) {
+        row[j] = int(code % 26);
+        code /= 26;
+    }
+}
+
+// A row whose entries share a factor with 26 makes every determinant share it
+static bool rowCanBeInvertible(const int* row, int n) {
+    bool odd = false, not13 = false;
+    for (int j = 0; j < n; j++) {
+        if (row[j] % 2) odd = true;
+        if (row[j] % 13) not13 = true;
+    }
+    return odd && not13;
+}
+
+static void runTasks(WorkStealingPool* pool, size_t count, const function<void(size_t)>& task) {
+    if (!pool) {
+        for (size_t i = 0; i < count; i++) task(i);
+        return;
+    }
+    vector<WorkStealingPool::Task> tasks;
+    for (size_t i = 0; i < count; i++) {
+        tasks.push_back([&task, i]() { task(i); });
+    }
+    pool->run(move(tasks));
+}
+
+/* ---------- ATTACK ---------- */
+HillAttack::HillAttack(const NgramModel& model)
+    : model(model), pool(nullptr), rowLimit(0), sampleLimit(DEFAULT_SAMPLE_LETTERS),
+      rowCount(0), matrixCount(0), prunedCount(0) {
+}
+
+vector<AttackCandidate> HillAttack::recover(const string& ciphertext, int n, size_t top) {
+    if (n != 2 && n != 3) {
+        throw runtime_error("Ciphertext-only search supports 2x2 and 3x3 keys");
+    }
+    if (top == 0) top = 1;
+
+    vector<uint8_t> letters(ciphertext.size());
+    letters.resize(scanText(ciphertext.data(), ciphertext.size(), letters.data()).letters);
+    size_t usable = letters.size();
+    if (sampleLimit > 0) usable = min(usable, sampleLimit);
+    size_t blocks = usable / n;
+    if (blocks < 4) {
+        throw runtime_error("Ciphertext too short for a ciphertext-only search");
+    }
+
+    // Column j holds letter j of every block, so one row's output letters
+    // are a weighted sum of contiguous columns
+    vector<uint8_t> columns(n * blocks);
+    for (size_t b = 0; b < blocks; b++)
+        for (int j = 0; j < n; j++) columns[j * blocks + b] = letters[b * n + j];
+
+    /* Stage 1: every row, scored by letter frequencies */
+    size_t keep = rowLimit ? rowLimit : (n == 2 ? 26 : 60);
+    uint64_t row_space = 1;
+    for (int j = 0; j < n; j++) row_space *= 26;
+    keep = min<size_t>(keep, row_space);
+
+    const float* uni = model.unigrams();
+    TopList best_rows(keep);
+    mutex merge_lock;
+    runTasks(pool, 26, [&](size_t first) {
+        // Row codes first * 26^(n-1) .. (first + 1) * 26^(n-1) - 1
+        vector<uint8_t> p(blocks, 0);
+        for (size_t k = 0; k < first; k++) addColumn(p.data(), columns.data(), blocks);
+        TopList local(keep);
+        uint64_t per_task = row_space / 26, scored = 0;
+        int d[3] = {int(first), 0, 0};
+
+        for (uint64_t i = 0; i < per_task; i++) {
+            if (rowCanBeInvertible(d, n)) {
+                local.offer(unigramScore(p.data(), blocks, uni), first * per_task + i);
+                scored++;
+            }
+            // Odometer step; adding a column 26 times brings p back round,
+            // so a wrapping digit needs no correction
+            for (int j = n - 1; j > 0; j--) {
+                addColumn(p.data(), columns.data() + j * blocks, blocks);
+                if (++d[j] < 26) break;
+                d[j] = 0;
+            }
+        }
+        rowCount += scored;
+        lock_guard<mutex> guard(merge_lock);
+        best_rows.merge(local);
+    });
+
+    vector<pair<double, uint64_t>> rows = best_rows.sorted();
+    size_t m = rows.size();
+    vector<vector<int>> row_entries(m, vector<int>(n));
+    vector<uint8_t> streams(m * blocks);
+    for (size_t r = 0; r < m; r++) {
+        decodeRow(rows[r].second, n, row_entries[r].data());
+        uint8_t* s = streams.data() + r * blocks;
+        for (size_t b = 0; b < blocks; b++) {
+            int sum = 0;
+            for (int j = 0; j < n; j++) sum += row_entries[r][j] * columns[j * blocks + b];
+            s[b] = uint8_t(sum % 26);
+        }
+    }
+
+    /* Stage 2: distinct rows combined into matrices, trigram scored */
+    TopList best_keys(top);
+    runTasks(pool, m, [&](size_t i) {
+        TopList local(top);
+        vector<vector<int>> matrix(n, vector<int>(n));
+        vector<uint8_t> plain(blocks * n);
+        uint64_t scored = 0, pruned = 0;
+
+        auto consider = [&](const size_t* pick) {
+            for (int r = 0; r < n; r++) matrix[r] = row_entries[pick[r]];
+            int det = MatrixUtils::determinant(matrix);
+            if (det % 2 == 0 || det % 13 == 0) {
+                pruned++;
+                return;
+            }
+            for (int r = 0; r < n; r++) {
+                const uint8_t* s = streams.data() + pick[r] * blocks;
+                for (size_t b = 0; b < blocks; b++) plain[b * n + r] = s[b];
+            }
+            uint64_t id = 0;
+            for (int r = 0; r < n; r++) id = id * m + pick[r];
+            local.offer(model.score(plain.data(), plain.size()), id);
+            scored++;
+        };
+
+        size_t pick[3] = {i, 0, 0};
+        for (pick[1] = 0; pick[1] < m; pick[1]++) {
+            if (pick[1] == i) continue;
+            if (n == 2) {
+                consider(pick);
+                continue;
+            }
+            for (pick[2] = 0; pick[2] < m; pick[2]++) {
+                if (pick[2] == i || pick[2] == pick[1]) continue;
+                consider(pick);
+            }
+        }
+        matrixCount += scored;
+        prunedCount += pruned;
+        lock_guard<mutex> guard(merge_lock);
+        best_keys.merge(local);
+    });
+
+    vector<AttackCandidate> result;
+    for (auto& item : best_keys.sorted()) {
+        AttackCandidate candidate;
+        candidate.inverse.assign(n, vector<int>());
+        uint64_t id = item.second;
+        for (int r = n - 1; r >= 0; r--) {
+            candidate.inverse[r] = row_entries[id % m];
+            id /= m;
+        }
+        candidate.key = MatrixUtils::inverseMatrix(candidate.inverse);
+        candidate.score = item.first;
+        result.push_back(candidate);
+    }
+    return result;
+}
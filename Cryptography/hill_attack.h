@@ -0,0 +1,65 @@
+#ifndef HILL_ATTACK_H
+#define HILL_ATTACK_H
+
+#include "ngram_model.h"
+#include "hill_parallel.h"
+#include <vector>
+#include <string>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// One recovered key: the encryption key, the decryption matrix that was
+// actually searched for, and the trigram score of the decrypted sample
+struct AttackCandidate {
+    std::vector<std::vector<int>> key;
+    std::vector<std::vector<int>> inverse;
+    double score;
+};
+
+// Ciphertext-only key recovery for 2x2 and 3x3 Hill keys.
+//
+// Each plaintext letter at block offset r depends only on row r of the
+// decryption matrix, so rows are searched on their own: all 26^n rows are
+// tried against the sample and scored by letter frequencies, keeping the
+// best few. Rows that are all even or all multiples of 13 are skipped, as no
+// invertible matrix can contain them. The surviving rows are then combined
+// into matrices, non-invertible ones are dropped by their determinant, and
+// the rest are scored on the full sample with trigram statistics.
+//
+// Both scoring passes are table lookups done 16 letters at a time with
+// AVX2 gathers when the CPU has them. Both stages split their work into
+// tasks on a work-stealing pool; a thread that runs out takes tasks from
+// the others, so uneven tasks balance out.
+class HillAttack {
+public:
+    explicit HillAttack(const NgramModel& model = NgramModel::english());
+
+    // Spread the search over a thread pool (nullptr = calling thread only)
+    void setThreadPool(WorkStealingPool* threads) { pool = threads; }
+
+    // Rows kept per position after the first stage (0 = default for n)
+    void setRowCandidates(size_t count) { rowLimit = count; }
+
+    // Letters of ciphertext used for scoring (default 1200, 0 = all of it)
+    void setSampleLength(size_t letters) { sampleLimit = letters; }
+
+    // Best `top` keys, highest score first. Non-letters in the ciphertext
+    // are ignored; it needs at least a few dozen letters to be meaningful.
+    std::vector<AttackCandidate> recover(const std::string& ciphertext, int n, size_t top = 10);
+
+    uint64_t rowsScored() const { return rowCount; }
+    uint64_t matricesScored() const { return matrixCount; }
+    uint64_t matricesPruned() const { return prunedCount; }
+
+private:
+    const NgramModel& model;
+    WorkStealingPool* pool;
+    size_t rowLimit;
+    size_t sampleLimit;
+    std::atomic<uint64_t> rowCount;
+    std::atomic<uint64_t> matrixCount;
+    std::atomic<uint64_t> prunedCount;
+};
+
+#endif
@@ -0,0 +1,37 @@
+#include "hill_backend.h"
+#include "hill_kernel.h"
+#include "hill_table.h"
+#include "hill_gemm.h"
+#include <stdexcept>
+
+using namespace std;
+
+unique_ptr<HillBackend> createBackend(const vector<vector<int>>& key, BackendType type) {
+    if (type == BACKEND_AUTO) {
+        // See benchmark: for 2x2 and 3x3 keys the SIMD kernel matches or beats
+        // the full-block table without its setup cost. From 4x4 up the AVX2
+        // GEMM wins (from 8x8 its portable loop too); in between the tables
+        // avoid the multiplies and are at least as fast as the scalar loop.
+        int n = key.size();
+        HillKernel::Level level = HillKernel::detect();
+        bool simd = (n == 2 || n == 3) && level != HillKernel::SCALAR;
+        bool gemm = n >= 8 || (n >= 4 && level == HillKernel::AVX2);
+        type = simd ? BACKEND_KERNEL : gemm ? BACKEND_GEMM : BACKEND_TABLE;
+    }
+
+    if (type == BACKEND_TABLE) {
+        return unique_ptr<HillBackend>(new HillTable(key));
+    }
+    if (type == BACKEND_GEMM) {
+        return unique_ptr<HillBackend>(new HillGemm(key));
+    }
+    return unique_ptr<HillBackend>(new HillKernel(key));
+}
+
+BackendType parseBackendType(const string& name) {
+    if (name == "auto") return BACKEND_AUTO;
+    if (name == "kernel") return BACKEND_KERNEL;
+    if (name == "table") return BACKEND_TABLE;
+    if (name == "gemm") return BACKEND_GEMM;
+    throw runtime_error("Unknown backend '" + name + "' (expected auto, kernel, table or gemm)");
+}
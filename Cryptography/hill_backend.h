@@ -0,0 +1,36 @@
+#ifndef HILL_BACKEND_H
+#define HILL_BACKEND_H
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Common interface of the block backends. Letters are indices 0..25 stored
+// one per byte; apply() transforms `blocks` blocks of size() letters from in
+// to out, and out may equal in.
+class HillBackend {
+public:
+    virtual ~HillBackend() {}
+
+    virtual void apply(const uint8_t* in, uint8_t* out, size_t blocks) const = 0;
+    virtual int size() const = 0;
+    virtual const char* name() const = 0;
+};
+
+enum BackendType {
+    BACKEND_AUTO,     // fastest backend for this key size and CPU
+    BACKEND_KERNEL,   // arithmetic kernel (HillKernel)
+    BACKEND_TABLE,    // precomputed lookup tables (HillTable)
+    BACKEND_GEMM      // tiled matrix multiply over whole batches (HillGemm)
+};
+
+// Build a backend for the given key
+std::unique_ptr<HillBackend> createBackend(const std::vector<std::vector<int>>& key,
+                                           BackendType type = BACKEND_AUTO);
+
+// Parse "auto", "kernel", "table" or "gemm" (throws on anything else)
+BackendType parseBackendType(const std::string& name);
+
+#endif
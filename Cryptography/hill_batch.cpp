@@ -0,0 +1,404 @@
+#include "hill_batch.h"
+#include "hill_file.h"
+#include "hill_message.h"
+#include "hill_normalize.h"
+#include "mapped_file.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <set>
+#include <stdexcept>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <cerrno>
+#endif
+
+using namespace std;
+
+/* ---------- LISTING ---------- */
+static bool statFile(const string& path, uint64_t& size, bool& directory) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    size = st.st_size;
+    directory = S_ISDIR(st.st_mode);
+    return S_ISDIR(st.st_mode) || S_ISREG(st.st_mode);
+}
+
+#ifndef _WIN32
+static void walk(const string& dir, const string& relative, vector<string>& files) {
+    DIR* d = opendir(dir.c_str());
+    if (!d) {
+        throw runtime_error("Cannot open directory " + dir);
+    }
+    vector<string> names;
+    while (dirent* entry = readdir(d)) {
+        string name = entry->d_name;
+        if (name != "." && name != "..") names.push_back(name);
+    }
+    closedir(d);
+    sort(names.begin(), names.end());
+
+    for (const string& name : names) {
+        uint64_t size;
+        bool directory;
+        if (!statFile(dir + "/" + name, size, directory)) continue;
+        if (directory) {
+            walk(dir + "/" + name, relative + name + "/", files);
+        } else {
+            files.push_back(relative + name);
+        }
+    }
+}
+
+static void makeDirectories(const string& path) {
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+        string prefix = path.substr(0, slash);
+        if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) {
+            throw runtime_error("Cannot create directory " + prefix);
+        }
+        if (slash == string::npos) return;
+    }
+}
+
+vector<BatchItem> listDirectory(const string& dir, const string& outDir) {
+    vector<string> files;
+    walk(dir, "", files);
+    vector<BatchItem> items;
+    for (const string& file : files) {
+        string output = outDir + "/" + file;
+        items.push_back({dir + "/" + file, output, output + ".map"});
+    }
+    return items;
+}
+#else
+static void makeDirectories(const string&) {
+}
+
+vector<BatchItem> listDirectory(const string&, const string&) {
+    throw runtime_error("Directory batches need POSIX directory listing; use a manifest");
+}
+#endif
+
+vector<BatchItem> readManifest(istream& in) {
+    vector<BatchItem> items;
+    string line;
+    for (size_t number = 1; getline(in, line); number++) {
+        istringstream fields(line);
+        BatchItem item;
+        if (!(fields >> item.input) || item.input[0] == '#') continue;
+        if (!(fields >> item.output)) {
+            throw runtime_error("Manifest line " + to_string(number) + " has no output path");
+        }
+        if (!(fields >> item.map)) item.map = item.output + ".map";
+        items.push_back(item);
+    }
+    return items;
+}
+
+/* ---------- RESULTS ---------- */
+// Shared by every task of a run
+struct BatchRecorder {
+    mutex lock;
+    BatchResult& result;
+
+    void success(uint64_t in, uint64_t out) {
+        lock_guard<mutex> guard(lock);
+        result.files++;
+        result.inputBytes += in;
+        result.outputBytes += out;
+    }
+
+    void failure(const string& path, const string& reason) {
+        lock_guard<mutex> guard(lock);
+        result.files++;
+        result.failed++;
+        result.errors.push_back(path + ": " + reason);
+    }
+};
+
+/* ---------- SPLIT FILES ---------- */
+// A large file encrypted piece by piece. Count tasks find the letters in
+// each piece; the last one to finish lays out the output, opens the space
+// map and spawns the first gather tasks, which place each piece's letters at
+// their final offset and encrypt the blocks lying wholly inside it. Space
+// positions go into the map in piece order as soon as every earlier piece
+// is done, and only a window of pieces ahead of that is gathered at a time,
+// so memory is bounded by the window and not the file. The last piece to be
+// written out pads, encrypts the few blocks that straddle pieces and
+// finishes the map.
+struct SplitFile {
+    BatchItem item;
+    shared_ptr<const HillKey> key;
+    SpaceMapFormat mapFormat;
+    BatchRecorder* recorder;
+    WorkStealingPool* pool;
+
+    MappedFile input;
+    MappedFile output;
+    uint64_t pieceBytes;
+    size_t pieces;
+    vector<uint64_t> offsets;           // letters per piece, then letters before it
+    vector<uint64_t> spaceCounts;
+    vector<vector<uint64_t>> spaces;    // absolute positions, per piece in the window
+    uint64_t letters;
+    atomic<size_t> remaining;
+
+    ofstream mapOut;
+    unique_ptr<SpaceMapWriter> spaceMap;
+    vector<bool> gathered;
+    size_t written;                     // pieces whose spaces are in the map
+    size_t spawned;                     // gather tasks started
+
+    mutex lock;
+    string error;
+
+    void fail(const string& reason) {
+        lock_guard<mutex> guard(lock);
+        if (error.empty()) error = reason;
+    }
+
+    size_t pieceLength(size_t piece) const {
+        return min<uint64_t>(pieceBytes, input.size() - piece * pieceBytes);
+    }
+};
+
+static void finishSplit(shared_ptr<SplitFile> file);
+static void gatherPiece(shared_ptr<SplitFile> file, size_t piece);
+
+// Gather tasks allowed ahead of the first piece not yet in the map
+static size_t gatherWindow(const SplitFile& file) {
+    return 2 * size_t(file.pool->size());
+}
+
+static void countPiece(shared_ptr<SplitFile> file, size_t piece) {
+    MessageCounts counts = countMessage(file->input.data() + piece * file->pieceBytes,
+                                        file->pieceLength(piece));
+    file->offsets[piece] = counts.letters;
+    file->spaceCounts[piece] = counts.spaces;
+    if (--file->remaining > 0) return;
+
+    // Last count: lay out the output and the map, and start gathering
+    try {
+        uint64_t total = 0;
+        for (uint64_t& offset : file->offsets) {
+            uint64_t count = offset;
+            offset = total;
+            total += count;
+        }
+        file->letters = total;
+        if (!file->output.create(file->item.output, encryptedLength(total, file->key->size()))) {
+            throw runtime_error("Cannot create " + file->item.output);
+        }
+        file->mapOut.open(file->item.map, ios::binary);
+        if (!file->mapOut) {
+            throw runtime_error("Cannot open " + file->item.map + " for writing");
+        }
+        file->spaceMap.reset(new SpaceMapWriter(file->mapOut, file->mapFormat));
+    } catch (const exception& e) {
+        file->output.close();
+        file->recorder->failure(file->item.input, e.what());
+        return;
+    }
+    file->spawned = min(gatherWindow(*file), file->pieces);
+    for (size_t p = 0; p < file->spawned; p++) {
+        file->pool->spawn([file, p]() { gatherPiece(file, p); });
+    }
+}
+
+static void gatherPiece(shared_ptr<SplitFile> file, size_t piece) {
+    try {
+        const char* src = file->input.data() + piece * file->pieceBytes;
+        size_t len = file->pieceLength(piece);
+        uint64_t offset = file->offsets[piece];
+        uint8_t* letters = reinterpret_cast<uint8_t*>(file->output.data());
+        vector<uint64_t>& spaces = file->spaces[piece];
+        spaces.resize(file->spaceCounts[piece]);
+
+        uint64_t at = offset + scanText(src, len, letters + offset, spaces.data(),
+                                        piece * file->pieceBytes).letters;
+
+        // Only blocks wholly inside this piece; the rest wait for finishSplit
+        size_t n = file->key->size();
+        uint64_t first = (offset + n - 1) / n, last = at / n;
+        if (last > first) {
+            uint8_t* blocks = letters + first * n;
+            file->key->encryptor().apply(blocks, blocks, last - first);
+            for (size_t i = 0; i < (last - first) * n; i++) {
+                blocks[i] += 'A';
+            }
+        }
+    } catch (const exception& e) {
+        file->fail(e.what());
+    }
+
+    // Write out every finished piece at the front of the window, and let
+    // the window slide on by as many pieces
+    bool last = false;
+    {
+        lock_guard<mutex> guard(file->lock);
+        file->gathered[piece] = true;
+        while (file->written < file->pieces && file->gathered[file->written]) {
+            vector<uint64_t>& spaces = file->spaces[file->written];
+            try {
+                if (file->error.empty()) {
+                    for (uint64_t pos : spaces) file->spaceMap->add(pos);
+                }
+            } catch (const exception& e) {
+                file->error = e.what();
+            }
+            vector<uint64_t>().swap(spaces);
+            file->written++;
+            if (file->spawned < file->pieces) {
+                size_t next = file->spawned++;
+                file->pool->spawn([file, next]() { gatherPiece(file, next); });
+            }
+        }
+        last = file->written == file->pieces;
+    }
+    if (last) finishSplit(file);
+}
+
+static void finishSplit(shared_ptr<SplitFile> file) {
+    try {
+        if (!file->error.empty()) throw runtime_error(file->error);
+        size_t n = file->key->size();
+        uint64_t total = file->letters;
+        uint64_t length = encryptedLength(total, n);
+        uint8_t* letters = reinterpret_cast<uint8_t*>(file->output.data());
+        for (uint64_t i = total; i < length; i++) {
+            letters[i] = 'X' - 'A';
+        }
+
+        // Blocks cut by a piece boundary, plus the padded one
+        set<uint64_t> straddling;
+        for (size_t p = 1; p < file->pieces; p++) {
+            if (file->offsets[p] % n != 0) straddling.insert(file->offsets[p] / n);
+        }
+        if (total % n != 0) straddling.insert(total / n);
+        for (uint64_t b : straddling) {
+            uint8_t* block = letters + b * n;
+            file->key->encryptor().apply(block, block, 1);
+            for (size_t i = 0; i < n; i++) {
+                block[i] += 'A';
+            }
+        }
+
+        uint64_t input_size = file->input.size();
+        file->spaceMap->finish(input_size, length);
+        file->output.close(length);
+        file->input.close();
+        file->recorder->success(input_size, length);
+    } catch (const exception& e) {
+        file->output.close();
+        file->recorder->failure(file->item.input, e.what());
+    }
+}
+
+// Map the file and spawn a count task per piece
+static void startSplit(shared_ptr<SplitFile> file) {
+    if (file->item.input == file->item.output) {
+        throw runtime_error("Input and output are the same file");
+    }
+    if (!file->input.openRead(file->item.input)) {
+        // Not mappable after all; do it in one go
+        FileResult r = encryptFile(file->key, file->item.input, file->item.output, file->item.map,
+                                   false, DEFAULT_CHUNK_SIZE, nullptr, file->mapFormat);
+        file->recorder->success(r.inputBytes, r.outputBytes);
+        return;
+    }
+    file->input.adviseSequential();
+    file->pieces = (file->input.size() + file->pieceBytes - 1) / file->pieceBytes;
+    file->offsets.resize(file->pieces);
+    file->spaceCounts.resize(file->pieces);
+    file->spaces.resize(file->pieces);
+    file->gathered.assign(file->pieces, false);
+    file->written = 0;
+    file->spawned = 0;
+    file->remaining = file->pieces;
+    for (size_t p = 0; p < file->pieces; p++) {
+        file->pool->spawn([file, p]() { countPiece(file, p); });
+    }
+}
+
+/* ---------- SCHEDULING ---------- */
+BatchResult encryptBatch(shared_ptr<const HillKey> key, const vector<BatchItem>& items,
+                         const BatchSettings& settings) {
+    BatchResult result = {0, 0, 0, 0, 0, 0, 0.0, {}};
+    BatchRecorder recorder{{}, result};
+    WorkStealingPool pool(settings.threads);
+    auto start = chrono::steady_clock::now();
+
+    vector<WorkStealingPool::Task> tasks;
+    vector<BatchItem> group;
+    uint64_t group_bytes = 0;
+    SpaceMapFormat format = settings.mapFormat;
+    auto flushGroup = [&]() {
+        if (group.empty()) return;
+        tasks.push_back([key, group, format, &recorder]() {
+            for (const BatchItem& item : group) {
+                try {
+                    FileResult r = encryptFile(key, item.input, item.output, item.map,
+                                               false, DEFAULT_CHUNK_SIZE, nullptr, format);
+                    recorder.success(r.inputBytes, r.outputBytes);
+                } catch (const exception& e) {
+                    recorder.failure(item.input, e.what());
+                }
+            }
+        });
+        group.clear();
+        group_bytes = 0;
+    };
+
+    set<string> directories;
+    for (const BatchItem& item : items) {
+        uint64_t size = 0;
+        bool directory = false;
+        try {
+            for (const string& path : {item.output, item.map}) {
+                size_t slash = path.rfind('/');
+                if (slash != string::npos && slash > 0 && directories.insert(path.substr(0, slash)).second) {
+                    makeDirectories(path.substr(0, slash));
+                }
+            }
+            if (!statFile(item.input, size, directory) || directory) {
+                throw runtime_error("Not a regular file");
+            }
+        } catch (const exception& e) {
+            recorder.failure(item.input, e.what());
+            continue;
+        }
+
+        if (size >= settings.splitBytes && settings.pieceBytes > 0) {
+            auto file = make_shared<SplitFile>();
+            file->item = item;
+            file->key = key;
+            file->mapFormat = format;
+            file->recorder = &recorder;
+            file->pool = &pool;
+            file->pieceBytes = settings.pieceBytes;
+            tasks.push_back([file]() {
+                try {
+                    startSplit(file);
+                } catch (const exception& e) {
+                    file->recorder->failure(file->item.input, e.what());
+                }
+            });
+            continue;
+        }
+        group.push_back(item);
+        group_bytes += size;
+        if (group_bytes >= settings.groupBytes) flushGroup();
+    }
+    flushGroup();
+
+    result.tasks = tasks.size();
+    pool.run(move(tasks));
+    result.steals = pool.steals();
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return result;
+}
@@ -0,0 +1,56 @@
+#ifndef HILL_BATCH_H
+#define HILL_BATCH_H
+
+#include "hill_key.h"
+#include "space_map.h"
+#include <vector>
+#include <string>
+#include <istream>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+// One file of a batch run
+struct BatchItem {
+    std::string input;
+    std::string output;
+    std::string map;
+};
+
+// Every regular file under dir (recursively), to the same relative path
+// under outDir, with its space map next to it as <output>.map
+std::vector<BatchItem> listDirectory(const std::string& dir, const std::string& outDir);
+
+// One file per line: "input output [map]". The map defaults to <output>.map;
+// blank lines and lines starting with '#' are skipped.
+std::vector<BatchItem> readManifest(std::istream& in);
+
+// Task shaping for encryptBatch
+struct BatchSettings {
+    unsigned threads = 0;                  // 0 = all cores
+    uint64_t groupBytes = 1 << 20;         // small files are bundled up to this size
+    uint64_t splitBytes = 16 << 20;        // files from this size are split...
+    uint64_t pieceBytes = 4 << 20;         // ...into pieces of this size
+    SpaceMapFormat mapFormat = SPACE_MAP_BINARY;
+};
+
+struct BatchResult {
+    uint64_t files;
+    uint64_t failed;
+    uint64_t inputBytes;
+    uint64_t outputBytes;
+    uint64_t tasks;                        // initial tasks, before pieces spawn
+    uint64_t steals;
+    double seconds;
+    std::vector<std::string> errors;       // "path: reason" for each failure
+};
+
+// Encrypt every item to its own output and space map, exactly as
+// encryptFile would. Work is scheduled with a WorkStealingPool: bundles of
+// small files are one task each, and each large file is counted, gathered
+// and encrypted in block-aligned pieces spread over all threads. A failing
+// file is reported in the result and does not stop the others.
+BatchResult encryptBatch(std::shared_ptr<const HillKey> key, const std::vector<BatchItem>& items,
+                         const BatchSettings& settings = BatchSettings());
+
+#endif
@@ -0,0 +1,174 @@
+#include "hill_bytes.h"
+#include "hill_gemm.h"
+#include "hill_metrics.h"
+#include "matrix_utils.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+/* ---------- KEY ---------- */
+// Square, small enough for one padding byte, entries reduced mod 256 and
+// an odd determinant (a unit mod 2^8)
+static vector<vector<int>> byteMatrix(const vector<vector<int>>& matrix) {
+    int n = matrix.size();
+    if (n == 0) {
+        throw runtime_error("Key matrix is empty");
+    }
+    if (n > MAX_BYTE_KEY_SIZE) {
+        throw runtime_error("Byte keys are limited to " + to_string(MAX_BYTE_KEY_SIZE) + "x" +
+                            to_string(MAX_BYTE_KEY_SIZE));
+    }
+    vector<vector<int>> key = matrix;
+    for (auto& row : key) {
+        if ((int)row.size() != n) {
+            throw runtime_error("Key matrix must be square");
+        }
+        for (int& x : row) {
+            x = ((x % 256) + 256) % 256;
+        }
+    }
+    if (MatrixUtils::determinant(key, 256) % 2 == 0) {
+        throw runtime_error("Key matrix is not invertible modulo 256 (its determinant is even)");
+    }
+    return key;
+}
+
+// Same size rule as createBackend's auto mode (there are no byte tables)
+static unique_ptr<HillBackend> byteBackend(const vector<vector<int>>& key, HillKernel::Level level) {
+    int n = key.size();
+    bool avx2 = level == HillKernel::AVX2;
+    if (n >= 8 || (n >= 4 && avx2)) {
+        return unique_ptr<HillBackend>(new HillGemm(key, 256, avx2));
+    }
+    return unique_ptr<HillBackend>(new HillKernel(key, level, 256));
+}
+
+ByteKey::ByteKey(const vector<vector<int>>& matrix, HillKernel::Level level)
+    : n(matrix.size()), key(byteMatrix(matrix)),
+      inverseKey(MatrixUtils::inverseMatrix(key, 256)),
+      forward(byteBackend(key, level)), backward(byteBackend(inverseKey, level)) {
+}
+
+/* ---------- BUFFERS ---------- */
+size_t encryptBytes(const ByteKey& key, const uint8_t* in, size_t len, uint8_t* out,
+                    ThreadPool* pool, const HillCounter* counter, uint64_t firstBlock) {
+    int n = key.size();
+    bool timed = len >= METRICS_TIMED_BYTES;
+    if (out != in) memmove(out, in, len);
+
+    size_t length = paddedByteLength(len, n);
+    HILL_STAGE_IF(padding, STAGE_PAD, length - len, timed);
+    memset(out + len, int(length - len), length - len);
+    HILL_STAGE_END(padding);
+
+    applyBlocks(key.encryptor(), counter, false, out, out, length / n, firstBlock, pool);
+    return length;
+}
+
+size_t decryptBytes(const ByteKey& key, const uint8_t* in, size_t len, uint8_t* out,
+                    ThreadPool* pool, const HillCounter* counter, uint64_t firstBlock) {
+    int n = key.size();
+    if (len == 0 || len % n != 0) {
+        throw runtime_error("Encrypted data length is not a non-zero multiple of the block size");
+    }
+    applyBlocks(key.decryptor(), counter, true, in, out, len / n, firstBlock, pool);
+
+    size_t pad = out[len - 1];
+    if (pad == 0 || pad > size_t(n)) {
+        throw runtime_error("Bad padding in decrypted data (wrong key?)");
+    }
+    for (size_t i = len - pad; i < len; i++) {
+        if (out[i] != pad) {
+            throw runtime_error("Bad padding in decrypted data (wrong key?)");
+        }
+    }
+    return len - pad;
+}
+
+/* ---------- STREAMS ---------- */
+// Chunk size rounded down to whole blocks, plus room for one more block
+// (the carried remainder, or the padding)
+static vector<uint8_t> blockBuffer(size_t chunkSize, int n) {
+    size_t chunk = max<size_t>(chunkSize / n, 1) * n;
+    return vector<uint8_t>(chunk + n);
+}
+
+static size_t readInto(istream& in, uint8_t* dest, size_t count) {
+    HILL_STAGE(read, STAGE_READ, 0);
+    in.read(reinterpret_cast<char*>(dest), count);
+    HILL_STAGE_BYTES(read, in.gcount());
+    return in.gcount();
+}
+
+static void writeFrom(ostream& out, const uint8_t* data, size_t count) {
+    HILL_STAGE(write, STAGE_WRITE, count);
+    out.write(reinterpret_cast<const char*>(data), count);
+}
+
+FileResult encryptByteStream(const ByteKey& key, istream& in, ostream& out,
+                             size_t chunkSize, ThreadPool* pool, const HillCounter* counter) {
+    size_t n = key.size();
+    vector<uint8_t> buffer = blockBuffer(chunkSize, n);
+    size_t chunk = buffer.size() - n;
+    uint64_t consumed = 0, produced = 0;
+
+    // have: bytes at the front of the buffer, fewer than n between reads
+    size_t have = 0;
+    while (size_t len = readInto(in, buffer.data() + have, chunk)) {
+        consumed += len;
+        have += len;
+        size_t blocks = have / n;
+        applyBlocks(key.encryptor(), counter, false, buffer.data(), buffer.data(), blocks,
+                    produced / n, pool);
+        writeFrom(out, buffer.data(), blocks * n);
+        produced += blocks * n;
+        memmove(buffer.data(), buffer.data() + blocks * n, have - blocks * n);
+        have -= blocks * n;
+    }
+
+    size_t last = encryptBytes(key, buffer.data(), have, buffer.data(), nullptr, counter,
+                               produced / n);
+    writeFrom(out, buffer.data(), last);
+    produced += last;
+    out.flush();
+    if (!out) {
+        throw runtime_error("Failed to write encrypted output");
+    }
+    return {consumed, produced, false};
+}
+
+FileResult decryptByteStream(const ByteKey& key, istream& in, ostream& out,
+                             size_t chunkSize, ThreadPool* pool, const HillCounter* counter) {
+    size_t n = key.size();
+    vector<uint8_t> buffer = blockBuffer(chunkSize, n);
+    size_t chunk = buffer.size() - n;
+    uint64_t consumed = 0, produced = 0;
+
+    // have: carried bytes, at most one block; a whole block is held back in
+    // case it is the last one
+    size_t have = 0;
+    while (size_t len = readInto(in, buffer.data() + have, chunk)) {
+        consumed += len;
+        have += len;
+        size_t blocks = have / n;
+        if (have % n == 0) blocks--;
+        applyBlocks(key.decryptor(), counter, true, buffer.data(), buffer.data(), blocks,
+                    (consumed - have) / n, pool);
+        writeFrom(out, buffer.data(), blocks * n);
+        produced += blocks * n;
+        memmove(buffer.data(), buffer.data() + blocks * n, have - blocks * n);
+        have -= blocks * n;
+    }
+
+    size_t last = decryptBytes(key, buffer.data(), have, buffer.data(), nullptr, counter,
+                               (consumed - have) / n);
+    writeFrom(out, buffer.data(), last);
+    produced += last;
+    out.flush();
+    if (!out) {
+        throw runtime_error("Failed to write decrypted output");
+    }
+    return {consumed, produced, false};
+}
@@ -0,0 +1,80 @@
+#ifndef HILL_BYTES_H
+#define HILL_BYTES_H
+
+#include "hill_kernel.h"
+#include "hill_backend.h"
+#include "hill_parallel.h"
+#include "hill_counter.h"
+#include "hill_file.h"
+#include <vector>
+#include <memory>
+#include <istream>
+#include <ostream>
+#include <cstddef>
+#include <cstdint>
+
+// Byte-alphabet Hill mode for binary data: every byte 0..255 is a symbol
+// and all arithmetic is mod 256, so nothing is dropped, folded to upper
+// case or rejected. A key is usable when its determinant is odd.
+//
+// The last block is padded the PKCS#7 way: p bytes of value p, with p
+// from 1 to n, so a block-aligned input gets a whole block of padding and
+// the exact length always comes back. Keys are therefore limited to
+// MAX_BYTE_KEY_SIZE.
+const int MAX_BYTE_KEY_SIZE = 255;
+
+// A validated mod-256 key with its inverse and a backend per direction:
+// the SIMD kernel for 2x2 and 3x3, the GEMM where it is faster (see
+// createBackend), the scalar kernel otherwise
+class ByteKey {
+public:
+    // Throws if the matrix is not square, is larger than MAX_BYTE_KEY_SIZE
+    // or has an even determinant
+    explicit ByteKey(const std::vector<std::vector<int>>& matrix,
+                     HillKernel::Level level = HillKernel::detect());
+
+    int size() const { return n; }
+    const std::vector<std::vector<int>>& matrix() const { return key; }
+    const std::vector<std::vector<int>>& inverse() const { return inverseKey; }
+
+    const HillBackend& encryptor() const { return *forward; }
+    const HillBackend& decryptor() const { return *backward; }
+
+private:
+    int n;
+    std::vector<std::vector<int>> key;
+    std::vector<std::vector<int>> inverseKey;
+    std::unique_ptr<HillBackend> forward;
+    std::unique_ptr<HillBackend> backward;
+};
+
+// Ciphertext length for len plaintext bytes: always at least one byte longer
+inline size_t paddedByteLength(size_t len, int n) {
+    return (len / n + 1) * n;
+}
+
+// Encrypt len bytes into out, which needs paddedByteLength(len, n) bytes
+// (out may equal in). With a counter (modulus 256) the offsets start at
+// block index firstBlock. Returns the ciphertext length.
+size_t encryptBytes(const ByteKey& key, const uint8_t* in, size_t len, uint8_t* out,
+                    ThreadPool* pool = nullptr, const HillCounter* counter = nullptr,
+                    uint64_t firstBlock = 0);
+
+// Decrypt len bytes (a non-zero multiple of the key size) into out, which
+// needs len bytes (out may equal in), and remove the padding. Throws if the
+// padding is malformed, which almost always means the wrong key. Returns
+// the plaintext length.
+size_t decryptBytes(const ByteKey& key, const uint8_t* in, size_t len, uint8_t* out,
+                    ThreadPool* pool = nullptr, const HillCounter* counter = nullptr,
+                    uint64_t firstBlock = 0);
+
+// Buffered streaming. Decryption holds back the last block until the end of
+// the input, since only that block carries padding.
+FileResult encryptByteStream(const ByteKey& key, std::istream& in, std::ostream& out,
+                             size_t chunkSize = DEFAULT_CHUNK_SIZE, ThreadPool* pool = nullptr,
+                             const HillCounter* counter = nullptr);
+FileResult decryptByteStream(const ByteKey& key, std::istream& in, std::ostream& out,
+                             size_t chunkSize = DEFAULT_CHUNK_SIZE, ThreadPool* pool = nullptr,
+                             const HillCounter* counter = nullptr);
+
+#endif
@@ -0,0 +1,271 @@
+#ifndef HILL_CIPHER_H
+#define HILL_CIPHER_H
+
+#include "hill_backend.h"
+#include "hill_key.h"
+#include "hill_kernel.h"
+#include <vector>
+#include <memory>
+#include <utility>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HILL_CIPHER_X86 1
+#endif
+
+#ifdef __GNUC__
+#define HILL_CIPHER_INLINE __attribute__((always_inline)) inline
+#else
+#define HILL_CIPHER_INLINE inline
+#endif
+
+// Hill cipher with the key fixed at compile time (needs C++14):
+//
+//   typedef HillCipher<2, 3, 3, 2, 5> Cipher;     // key "3 3; 2 5"
+//   Cipher::encrypt(letters, letters, blocks);
+//
+// The key is reduced mod 26 and its determinant and inverse are worked out
+// by the compiler, the same way MatrixUtils::inverseMatrix() does at run
+// time: Gauss-Jordan modulo 2 and modulo 13, recombined with the CRT. A key
+// that is not invertible does not compile. The block transforms are fully
+// unrolled, one multiply-add per key entry with the entry as an immediate
+// (zero entries drop out), over groups of 16 blocks so each multiply-add
+// covers the whole group in vector lanes. There is no setup and no key in
+// memory.
+//
+// The runtime-key backends stay as they are; makeKey() wraps the unrolled
+// transforms in a HillKey so every existing pipeline can use them.
+
+namespace hill_fixed {
+
+template <int N>
+struct Matrix {
+    int v[N * N];
+};
+
+// Determinant and inverse modulo one prime
+template <int N>
+struct Solved {
+    int det;        // 0 when singular (inv is then meaningless)
+    Matrix<N> inv;
+};
+
+constexpr int inverseMod(int a, int p) {
+    for (int x = 1; x < p; x++) {
+        if (a * x % p == 1) return x;
+    }
+    return 0;
+}
+
+template <int N>
+constexpr Solved<N> solveMod(const Matrix<N>& m, int p) {
+    int a[N][N] = {}, b[N][N] = {};
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) {
+            a[i][j] = m.v[i * N + j] % p;
+            b[i][j] = i == j ? 1 : 0;
+        }
+    }
+
+    int det = 1;
+    for (int c = 0; c < N; c++) {
+        int r = c;
+        while (r < N && a[r][c] == 0) r++;
+        if (r == N) return Solved<N>{0, Matrix<N>{}};
+        if (r != c) {
+            for (int j = 0; j < N; j++) {
+                int t = a[r][j]; a[r][j] = a[c][j]; a[c][j] = t;
+                t = b[r][j]; b[r][j] = b[c][j]; b[c][j] = t;
+            }
+            det = (p - det) % p;
+        }
+        det = det * a[c][c] % p;
+
+        int s = inverseMod(a[c][c], p);
+        for (int j = 0; j < N; j++) {
+            a[c][j] = a[c][j] * s % p;
+            b[c][j] = b[c][j] * s % p;
+        }
+        for (int i = 0; i < N; i++) {
+            int f = a[i][c];
+            if (i == c || f == 0) continue;
+            for (int j = 0; j < N; j++) {
+                a[i][j] = (a[i][j] + (p - f) * a[c][j]) % p;
+                b[i][j] = (b[i][j] + (p - f) * b[c][j]) % p;
+            }
+        }
+    }
+
+    Solved<N> out{det, Matrix<N>{}};
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) out.inv.v[i * N + j] = b[i][j];
+    }
+    return out;
+}
+
+// x = two (mod 2), x = thirteen (mod 13): 13 is 1 mod 2 and 14 is 1 mod 13
+constexpr int crt26(int two, int thirteen) {
+    return (two * 13 + thirteen * 14) % 26;
+}
+
+template <int N>
+constexpr Solved<N> solve(const Matrix<N>& m) {
+    Solved<N> two = solveMod(m, 2), thirteen = solveMod(m, 13);
+    Solved<N> out{crt26(two.det, thirteen.det), Matrix<N>{}};
+    for (int k = 0; k < N * N; k++) out.inv.v[k] = crt26(two.inv.v[k], thirteen.inv.v[k]);
+    return out;
+}
+
+// Sum of the arguments in their own type (C++14 has no fold expressions)
+template <class T>
+constexpr T sum(T x) { return x; }
+
+template <class T, class... Rest>
+constexpr T sum(T x, Rest... rest) {
+    return T(x + sum(rest...));
+}
+
+}  // namespace hill_fixed
+
+template <int N, int... Key>
+class HillCipher {
+    static_assert(N > 0 && sizeof...(Key) == size_t(N) * N, "HillCipher<N, Key...> takes N * N key entries");
+
+public:
+    typedef hill_fixed::Matrix<N> Matrix;
+
+    static constexpr Matrix key = {{(((Key % 26) + 26) % 26)...}};
+    static constexpr hill_fixed::Solved<N> solved = hill_fixed::solve(key);
+    static constexpr int determinant = solved.det;
+    static_assert(determinant % 2 != 0 && determinant % 13 != 0,
+                  "Key matrix is not invertible modulo 26 (determinant shares a factor with 26)");
+    static constexpr Matrix inverse = solved.inv;
+
+    static constexpr int size() { return N; }
+
+    // Transform `blocks` blocks of N letters (indices 0..25); out may equal in
+    static void encrypt(const uint8_t* in, uint8_t* out, size_t blocks) { run<false>(in, out, blocks); }
+    static void decrypt(const uint8_t* in, uint8_t* out, size_t blocks) { run<true>(in, out, blocks); }
+
+    // Key and inverse as rows, for the runtime API
+    static std::vector<std::vector<int>> matrix() { return rows(key); }
+    static std::vector<std::vector<int>> inverseMatrix() { return rows(inverse); }
+
+    // The unrolled transforms behind the common backend interface
+    template <bool Inverse>
+    class Backend : public HillBackend {
+    public:
+        void apply(const uint8_t* in, uint8_t* out, size_t blocks) const override {
+            run<Inverse>(in, out, blocks);
+        }
+        int size() const override { return N; }
+        const char* name() const override { return "fixed"; }
+    };
+
+    // A ready HillKey: nothing is inverted, validated or tabulated at run
+    // time. 2x2 and 3x3 keys keep the hand-written SIMD kernels, which hold
+    // the key in registers and beat the generic groups; building one only
+    // copies the entries.
+    static HillKey makeKey() {
+        return HillKey(matrix(), inverseMatrix(), backend<false>(), backend<true>());
+    }
+
+private:
+    typedef std::make_index_sequence<N> Indices;
+
+    template <bool Inverse>
+    static std::unique_ptr<HillBackend> backend() {
+        if ((N == 2 || N == 3) && HillKernel::detect() != HillKernel::SCALAR) {
+            return std::unique_ptr<HillBackend>(new HillKernel(Inverse ? inverseMatrix() : matrix()));
+        }
+        return std::unique_ptr<HillBackend>(new Backend<Inverse>());
+    }
+
+    template <bool Inverse, int K>
+    static constexpr int entry() { return Inverse ? inverse.v[K] : key.v[K]; }
+
+    // Blocks per group: letter j of 16 blocks sits in one row of lanes, so a
+    // key row becomes N multiply-adds on whole vectors
+    static const int LANES = 16;
+
+    // 16-bit lanes while N * 25 * 25 fits, else 32-bit
+    typedef typename std::conditional<(N * 625 < 65536), uint16_t, uint32_t>::type Lane;
+
+    // Key row R times every block of the group, each entry a compile-time
+    // constant
+    template <bool Inverse, int R, size_t... J>
+    HILL_CIPHER_INLINE static void row(const Lane (*col)[LANES], Lane* res, std::index_sequence<J...>) {
+        for (int c = 0; c < LANES; c++) {
+            res[c] = Lane(hill_fixed::sum(Lane(std::integral_constant<int, entry<Inverse, R * N + int(J)>()>::value *
+                                               col[J][c])...) % 26);
+        }
+    }
+
+    // The group is read in full before any of it is written, so y may be x
+    template <bool Inverse, size_t... R>
+    HILL_CIPHER_INLINE static void group(const uint8_t* x, uint8_t* y, std::index_sequence<R...>) {
+        Lane col[N][LANES], res[N][LANES];
+        for (int c = 0; c < LANES; c++) {
+            for (int j = 0; j < N; j++) col[j][c] = x[c * N + j];
+        }
+        int rows[] = {(row<Inverse, int(R)>(col, res[R], Indices()), 0)...};
+        (void)rows;
+        for (int c = 0; c < LANES; c++) {
+            for (int i = 0; i < N; i++) y[c * N + i] = uint8_t(res[i][c]);
+        }
+    }
+
+#ifdef HILL_CIPHER_X86
+    // The same groups compiled for AVX2, so each row runs on 16 lanes at once
+    template <bool Inverse>
+    __attribute__((target("avx2")))
+    static size_t groupsAVX2(const uint8_t* in, uint8_t* out, size_t blocks) {
+        size_t b = 0;
+        for (; b + LANES <= blocks; b += LANES) {
+            group<Inverse>(in + b * N, out + b * N, Indices());
+        }
+        return b;
+    }
+#endif
+
+    template <bool Inverse>
+    static void run(const uint8_t* in, uint8_t* out, size_t blocks) {
+        size_t b = 0;
+#ifdef HILL_CIPHER_X86
+        static const bool wide = HillKernel::detect() == HillKernel::AVX2;
+        if (wide) b = groupsAVX2<Inverse>(in, out, blocks);
+#endif
+        for (; b + LANES <= blocks; b += LANES) {
+            group<Inverse>(in + b * N, out + b * N, Indices());
+        }
+        if (b < blocks) {
+            // Last partial group through a zero-padded copy
+            uint8_t tail[LANES * N] = {};
+            for (size_t k = 0; k < (blocks - b) * N; k++) tail[k] = in[b * N + k];
+            group<Inverse>(tail, tail, Indices());
+            for (size_t k = 0; k < (blocks - b) * N; k++) out[b * N + k] = tail[k];
+        }
+    }
+
+    static std::vector<std::vector<int>> rows(const Matrix& m) {
+        std::vector<std::vector<int>> out(N, std::vector<int>(N));
+        for (int i = 0; i < N; i++) {
+            for (int j = 0; j < N; j++) out[i][j] = m.v[i * N + j];
+        }
+        return out;
+    }
+};
+
+// Definitions of the constexpr members (required before C++17)
+template <int N, int... Key>
+constexpr hill_fixed::Matrix<N> HillCipher<N, Key...>::key;
+template <int N, int... Key>
+constexpr hill_fixed::Solved<N> HillCipher<N, Key...>::solved;
+template <int N, int... Key>
+constexpr int HillCipher<N, Key...>::determinant;
+template <int N, int... Key>
+constexpr hill_fixed::Matrix<N> HillCipher<N, Key...>::inverse;
+
+#endif
@@ -0,0 +1,234 @@
+#include "hill_counter.h"
+#include "hill_kernel.h"
+#include "hill_metrics.h"
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HILL_COUNTER_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+static const uint64_t GOLDEN = 0x9E3779B97F4A7C15ull;
+
+// Offsets generated per batch, and bytes transformed before their offsets
+// are applied (small enough that the data is still in cache)
+static const size_t BATCH_SYMBOLS = 4096;
+static const size_t SLICE_BYTES = 16384;
+
+// SplitMix64 finalizer
+static inline uint64_t mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+#ifdef HILL_COUNTER_X86
+/* ---------- SIMD ---------- */
+// 64-bit low multiply from three 32x32 products (AVX2 has no vpmullq)
+__attribute__((target("avx2")))
+static inline __m256i mullo64(__m256i a, __m256i b) {
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                                     _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+    return _mm256_add_epi64(_mm256_mul_epu32(a, b), _mm256_slli_epi64(cross, 32));
+}
+
+// Four generator outputs at once; same results as the scalar loop in fill().
+// Letters are the 16-bit lanes scaled by a multiply-high, packed to bytes.
+__attribute__((target("avx2")))
+static size_t fillWordsAVX2(uint64_t seed, uint64_t word, size_t words, bool letters, uint8_t* out) {
+    const __m256i c1 = _mm256_set1_epi64x(0xBF58476D1CE4E5B9ull);
+    const __m256i c2 = _mm256_set1_epi64x(0x94D049BB133111EBull);
+    const __m256i step = _mm256_set1_epi64x(4 * GOLDEN);
+    __m256i x = _mm256_setr_epi64x(seed + word * GOLDEN, seed + (word + 1) * GOLDEN,
+                                   seed + (word + 2) * GOLDEN, seed + (word + 3) * GOLDEN);
+    size_t w = 0;
+    for (; w + 4 <= words; w += 4) {
+        __m256i z = x;
+        z = mullo64(_mm256_xor_si256(z, _mm256_srli_epi64(z, 30)), c1);
+        z = mullo64(_mm256_xor_si256(z, _mm256_srli_epi64(z, 27)), c2);
+        z = _mm256_xor_si256(z, _mm256_srli_epi64(z, 31));
+        if (letters) {
+            __m256i r = _mm256_mulhi_epu16(z, _mm256_set1_epi16(26));
+            r = _mm256_permute4x64_epi64(_mm256_packus_epi16(r, r), 0x08);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * w), _mm256_castsi256_si128(r));
+        } else {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 8 * w), z);
+        }
+        x = _mm256_add_epi64(x, step);
+    }
+    return w;
+}
+#endif
+
+/* ---------- GENERATOR ---------- */
+HillCounter::HillCounter(uint64_t nonce, int n, int modulus)
+    : seed(nonce), mixedSeed(mix(nonce + GOLDEN)), n(n), mod(modulus),
+      wide(HillKernel::detect() == HillKernel::AVX2) {
+    if (n <= 0) {
+        throw runtime_error("Counter mode needs a key size of at least 1");
+    }
+    if (mod != 26 && mod != 256) {
+        throw runtime_error("Counter modulus must be 26 or 256");
+    }
+}
+
+// Symbol s of the stream is part `s % per` of generator output `s / per`
+void HillCounter::fill(uint64_t start, size_t count, uint8_t* out) const {
+    int per = (mod == 256) ? 8 : 4;
+    uint64_t word = start / per;
+    size_t k = 0;
+
+    // Partial word at the start
+    int part = start % per;
+    if (part != 0) {
+        uint64_t z = mix(mixedSeed + word * GOLDEN);
+        for (; part < per && k < count; part++) {
+            out[k++] = symbol(z, part);
+        }
+        word++;
+    }
+
+    // Whole words
+#ifdef HILL_COUNTER_X86
+    if (wide) {
+        size_t done = fillWordsAVX2(mixedSeed, word, (count - k) / per, mod == 26, out + k);
+        k += done * per;
+        word += done;
+    }
+#endif
+    if (mod == 256) {
+        for (; k + 8 <= count; k += 8, word++) {
+            uint64_t z = mix(mixedSeed + word * GOLDEN);
+            for (int p = 0; p < 8; p++) {
+                out[k + p] = uint8_t(z >> (8 * p));
+            }
+        }
+    } else {
+        for (; k + 4 <= count; k += 4, word++) {
+            uint64_t z = mix(mixedSeed + word * GOLDEN);
+            for (int p = 0; p < 4; p++) {
+                out[k + p] = uint8_t((((z >> (16 * p)) & 0xFFFF) * 26) >> 16);
+            }
+        }
+    }
+
+    // Partial word at the end
+    if (k < count) {
+        uint64_t z = mix(mixedSeed + word * GOLDEN);
+        for (part = 0; k < count; part++) {
+            out[k++] = symbol(z, part);
+        }
+    }
+}
+
+// One symbol out of a generator output: a byte, or 16 random bits scaled
+// into 0..25 (multiply-high, no division)
+uint8_t HillCounter::symbol(uint64_t z, int part) const {
+    if (mod == 256) return uint8_t(z >> (8 * part));
+    return uint8_t((((z >> (16 * part)) & 0xFFFF) * 26) >> 16);
+}
+
+void HillCounter::offsets(uint64_t block, uint8_t* out) const {
+    fill(block * n, n, out);
+}
+
+template <bool SUBTRACT>
+void HillCounter::combine(const uint8_t* in, uint8_t* out, uint64_t first, size_t blocks) const {
+    uint8_t local[BATCH_SYMBOLS];
+    vector<uint8_t> large;
+    uint8_t* offs = local;
+    size_t batch = BATCH_SYMBOLS / n;
+    if (batch == 0) {
+        large.resize(n);
+        offs = large.data();
+        batch = 1;
+    }
+
+    for (size_t b = 0; b < blocks; b += batch) {
+        size_t count = min(batch, blocks - b);
+        fill((first + b) * n, count * n, offs);
+        const uint8_t* src = in + b * n;
+        uint8_t* dst = out + b * n;
+        size_t symbols = count * n;
+        if (mod == 256) {
+            for (size_t i = 0; i < symbols; i++) {
+                dst[i] = SUBTRACT ? uint8_t(src[i] - offs[i]) : uint8_t(src[i] + offs[i]);
+            }
+        } else if (SUBTRACT) {
+            for (size_t i = 0; i < symbols; i++) {
+                uint8_t v = src[i] - offs[i];
+                dst[i] = src[i] < offs[i] ? uint8_t(v + 26) : v;
+            }
+        } else {
+            for (size_t i = 0; i < symbols; i++) {
+                uint8_t v = src[i] + offs[i];
+                dst[i] = v >= 26 ? uint8_t(v - 26) : v;
+            }
+        }
+    }
+}
+
+void HillCounter::add(const uint8_t* in, uint8_t* out, uint64_t first, size_t blocks) const {
+    combine<false>(in, out, first, blocks);
+}
+
+void HillCounter::subtract(const uint8_t* in, uint8_t* out, uint64_t first, size_t blocks) const {
+    combine<true>(in, out, first, blocks);
+}
+
+uint64_t HillCounter::parseNonce(const string& text) {
+    if (text == "random") {
+        random_device rd;
+        return (uint64_t(rd()) << 32) ^ rd();
+    }
+    size_t used = 0;
+    uint64_t nonce = stoull(text, &used, 0);
+    if (used != text.size()) {
+        throw runtime_error("Invalid nonce '" + text + "'");
+    }
+    return nonce;
+}
+
+/* ---------- APPLY ---------- */
+void applyBlocks(const HillBackend& backend, const HillCounter* counter, bool decrypt,
+                 const uint8_t* in, uint8_t* out, size_t blocks, uint64_t firstBlock,
+                 ThreadPool* pool) {
+    if (!counter) {
+        parallelApply(backend, in, out, blocks, pool);
+        return;
+    }
+    if (counter->size() != backend.size()) {
+        throw runtime_error("Counter and key sizes differ");
+    }
+    size_t n = backend.size();
+    size_t slice = max<size_t>(SLICE_BYTES / n, 1);
+    bool timed = blocks * n >= METRICS_TIMED_BYTES;
+    // Timed per range, on the thread that runs it
+    auto range = [&](size_t first, size_t count) {
+        HILL_STAGE_IF(multiply, STAGE_MULTIPLY, count * n, timed);
+        HILL_STAGE_BLOCKS(multiply, count);
+        for (size_t b = first; b < first + count; b += slice) {
+            size_t part = min(slice, first + count - b);
+            const uint8_t* src = in + b * n;
+            uint8_t* dst = out + b * n;
+            if (decrypt) {
+                counter->subtract(src, dst, firstBlock + b, part);
+                backend.apply(dst, dst, part);
+            } else {
+                backend.apply(src, dst, part);
+                counter->add(dst, dst, firstBlock + b, part);
+            }
+        }
+    };
+    if (blocks == 0) return;
+    if (!pool) {
+        range(0, blocks);
+    } else {
+        pool->forRanges(blocks, PARALLEL_GRAIN_BLOCKS, range);
+    }
+}
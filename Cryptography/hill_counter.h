@@ -0,0 +1,61 @@
+#ifndef HILL_COUNTER_H
+#define HILL_COUNTER_H
+
+#include "hill_backend.h"
+#include "hill_parallel.h"
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Counter-offset (affine) mode: block i is encrypted as
+//   C_i = K * P_i + f(nonce, i)  (mod m)
+// where f is a counter-based generator, so equal plaintext blocks no longer
+// give equal ciphertext. Every block still depends only on its own index,
+// so blocks can be split across threads, run through the SIMD kernels and
+// decrypted from any position, exactly like plain Hill.
+//
+// The offsets of all blocks form one stream: symbol s (block s / n) comes
+// from SplitMix64 output s / 4 for letters (16 bits each, scaled into
+// 0..25) or s / 8 for bytes, so one generator call covers several symbols
+// whatever the key size. It hides repetition; it is not a cryptographic
+// keystream.
+class HillCounter {
+public:
+    // n: key size; modulus: 26 (letters) or 256 (bytes)
+    HillCounter(uint64_t nonce, int n, int modulus = 26);
+
+    uint64_t nonce() const { return seed; }
+    int size() const { return n; }
+
+    // The n offsets of one block
+    void offsets(uint64_t block, uint8_t* out) const;
+
+    // out = in + f or in - f, for `blocks` blocks starting at block index
+    // `first` (out may equal in)
+    void add(const uint8_t* in, uint8_t* out, uint64_t first, size_t blocks) const;
+    void subtract(const uint8_t* in, uint8_t* out, uint64_t first, size_t blocks) const;
+
+    // "random" for a fresh nonce, otherwise decimal or 0x-prefixed hex
+    static uint64_t parseNonce(const std::string& text);
+
+private:
+    void fill(uint64_t start, size_t count, uint8_t* out) const;
+    uint8_t symbol(uint64_t z, int part) const;
+    template <bool SUBTRACT>
+    void combine(const uint8_t* in, uint8_t* out, uint64_t first, size_t blocks) const;
+
+    uint64_t seed;
+    uint64_t mixedSeed;
+    int n;
+    int mod;
+    bool wide;      // AVX2 generator
+};
+
+// parallelApply for both modes: with a counter, encryption adds the offsets
+// after the transform and decryption subtracts them before it, inside the
+// same block-aligned ranges. firstBlock is the index of the first block.
+void applyBlocks(const HillBackend& backend, const HillCounter* counter, bool decrypt,
+                 const uint8_t* in, uint8_t* out, size_t blocks, uint64_t firstBlock,
+                 ThreadPool* pool);
+
+#endif
@@ -0,0 +1,324 @@
+#include "hill_file.h"
+#include "mapped_file.h"
+#include "hill_message.h"
+#include "hill_metrics.h"
+#include "hill_normalize.h"
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cstdio>
+
+using namespace std;
+
+/* ---------- BUFFERED ---------- */
+// One chunk of input; 0 at the end
+static size_t readChunk(istream& in, vector<char>& buffer) {
+    HILL_STAGE(read, STAGE_READ, 0);
+    in.read(buffer.data(), buffer.size());
+    HILL_STAGE_BYTES(read, in.gcount());
+    return in.gcount();
+}
+
+static void writeChunk(ostream& out, const string& chunk) {
+    HILL_STAGE(write, STAGE_WRITE, chunk.size());
+    out.write(chunk.data(), chunk.size());
+}
+
+FileResult encryptStream(shared_ptr<const HillKey> key, istream& in, ostream& out,
+                         SpaceMapWriter* spaceMap, size_t chunkSize, ThreadPool* pool,
+                         const HillCounter* counter) {
+    HillStreamEncryptor encryptor(key, spaceMap);
+    encryptor.setThreadPool(pool);
+    encryptor.setCounter(counter);
+
+    vector<char> buffer(max<size_t>(chunkSize, 1));
+    string chunk;
+    chunk.reserve(buffer.size());
+    while (size_t len = readChunk(in, buffer)) {
+        encryptor.update(buffer.data(), len, chunk);
+        writeChunk(out, chunk);
+        chunk.clear();
+    }
+    encryptor.finish(chunk);
+    writeChunk(out, chunk);
+    out.flush();
+    if (!out) {
+        throw runtime_error("Failed to write encrypted output");
+    }
+
+    if (spaceMap) {
+        HILL_STAGE(layout, STAGE_LAYOUT, 0);
+        spaceMap->finish(encryptor.consumed(), encryptor.produced());
+    }
+    return {encryptor.consumed(), encryptor.produced(), false};
+}
+
+FileResult decryptStream(shared_ptr<const HillKey> key, istream& in, ostream& out,
+                         SpaceMapReader* spaceMap, size_t chunkSize, ThreadPool* pool,
+                         const HillCounter* counter) {
+    HillStreamDecryptor decryptor(key, spaceMap);
+    decryptor.setThreadPool(pool);
+    decryptor.setCounter(counter);
+
+    vector<char> buffer(max<size_t>(chunkSize, 1));
+    string chunk;
+    chunk.reserve(buffer.size());
+    uint64_t consumed = 0;
+    while (size_t len = readChunk(in, buffer)) {
+        consumed += len;
+        decryptor.update(buffer.data(), len, chunk);
+        writeChunk(out, chunk);
+        chunk.clear();
+    }
+    decryptor.finish(chunk);
+    writeChunk(out, chunk);
+    out.flush();
+    if (!out) {
+        throw runtime_error("Failed to write decrypted output");
+    }
+    return {consumed, decryptor.produced(), false};
+}
+
+/* ---------- SHARED MEMORY ---------- */
+// Record layout: letters u64 | spaces u64 | space positions u64[spaces]
+// (relative to the chunk) | ciphertext, encryptedLength(letters) bytes
+const uint32_t RING_CHUNK = 1;
+const size_t CHUNK_RECORD_HEADER = 16;
+
+FileResult encryptToRing(shared_ptr<const HillKey> key, istream& in, ShmRing& ring,
+                         size_t chunkSize, ThreadPool* pool, const HillCounter* counter) {
+    // Worst case is all spaces, eight bytes of record each
+    size_t limit = (ring.maxRecord() - CHUNK_RECORD_HEADER - key->size()) / 8;
+    vector<char> buffer(max<size_t>(min(chunkSize, limit), 1));
+    uint64_t consumed = 0, produced = 0;
+    while (in.read(buffer.data(), buffer.size()) || in.gcount() > 0) {
+        size_t len = in.gcount();
+        MessageCounts counts = countMessage(buffer.data(), len);
+        size_t cipher = encryptedLength(counts.letters, key->size());
+        size_t bytes = CHUNK_RECORD_HEADER + 8 * counts.spaces + cipher;
+
+        char* record = ring.reserve(bytes);
+        uint64_t sizes[2] = {counts.letters, counts.spaces};
+        memcpy(record, sizes, sizeof(sizes));
+        uint64_t* spaces = reinterpret_cast<uint64_t*>(record + CHUNK_RECORD_HEADER);
+        // Chunks are padded separately, so block indices run on across them
+        encryptMessage(*key, buffer.data(), len, record + CHUNK_RECORD_HEADER + 8 * counts.spaces,
+                       spaces, pool, counter, produced / key->size());
+        ring.commit(bytes, RING_CHUNK);
+
+        consumed += len;
+        produced += cipher;
+    }
+    ring.finish();
+    return {consumed, produced, false};
+}
+
+FileResult decryptFromRing(shared_ptr<const HillKey> key, ShmRing& ring, ostream& out,
+                           ThreadPool* pool, const HillCounter* counter) {
+    vector<char> letters, text;
+    uint64_t consumed = 0, produced = 0;
+    const char* record;
+    size_t bytes;
+    uint32_t type;
+    while (ring.next(record, bytes, type)) {
+        uint64_t sizes[2];
+        if (type != RING_CHUNK || bytes < CHUNK_RECORD_HEADER) {
+            throw runtime_error("Unexpected record in the ring");
+        }
+        memcpy(sizes, record, sizeof(sizes));
+        size_t cipher = encryptedLength(sizes[0], key->size());
+        if (bytes != CHUNK_RECORD_HEADER + 8 * sizes[1] + cipher) {
+            throw runtime_error("Corrupt record in the ring (wrong key size?)");
+        }
+        const uint64_t* spaces = reinterpret_cast<const uint64_t*>(record + CHUNK_RECORD_HEADER);
+        const char* ciphertext = record + CHUNK_RECORD_HEADER + 8 * sizes[1];
+
+        // The record says how many letters are real, so padding is cut exactly
+        letters.resize(max<size_t>(cipher, 1));
+        text.resize(max<size_t>(sizes[0] + sizes[1], 1));
+        decryptMessage(*key, ciphertext, cipher, letters.data(), pool, counter, consumed / key->size());
+        size_t length = reconstructWithSpaces(letters.data(), sizes[0], spaces, sizes[1], 0, text.data());
+        ring.release();
+
+        out.write(text.data(), length);
+        consumed += cipher;
+        produced += length;
+    }
+    out.flush();
+    if (!out) {
+        throw runtime_error("Failed to write decrypted output");
+    }
+    return {consumed, produced, false};
+}
+
+/* ---------- MEMORY MAPPED ---------- */
+static uint64_t countLetters(const char* data, size_t len) {
+    return countText(data, len).letters;
+}
+
+// Creating the output would truncate the input under its own mapping
+static void checkPaths(const string& inPath, const string& outPath, bool inPlace) {
+    if (!inPlace && inPath == outPath) {
+        throw runtime_error("Input and output are the same file; use in-place mode");
+    }
+}
+
+// Map the input (read-write when transforming in place). Returns false if it
+// cannot be mapped, which is an error only for in-place runs.
+static bool mapInput(MappedFile& input, const string& path, bool inPlace) {
+    bool mapped = inPlace ? input.openReadWrite(path) : input.openRead(path);
+    if (!mapped && inPlace) {
+        throw runtime_error("In-place mode needs a regular file: " + path);
+    }
+    if (mapped) input.adviseSequential();
+    return mapped;
+}
+
+FileResult encryptFile(shared_ptr<const HillKey> key, const string& inPath,
+                       const string& outPath, const string& mapPath,
+                       bool inPlace, size_t chunkSize, ThreadPool* pool,
+                       SpaceMapFormat mapFormat, const HillCounter* counter) {
+    if (chunkSize == 0) chunkSize = DEFAULT_CHUNK_SIZE;
+    checkPaths(inPath, outPath, inPlace);
+    ofstream map_out(mapPath, ios::binary);
+    if (!map_out) {
+        throw runtime_error("Cannot open " + mapPath + " for writing");
+    }
+    SpaceMapWriter space_map(map_out, mapFormat);
+
+    MappedFile input;
+    if (!mapInput(input, inPath, inPlace)) {
+        ifstream in(inPath, ios::binary);
+        if (!in) {
+            throw runtime_error("Cannot open " + inPath);
+        }
+        ofstream out(outPath, ios::binary);
+        if (!out) {
+            throw runtime_error("Cannot open " + outPath + " for writing");
+        }
+        return encryptStream(key, in, out, &space_map, chunkSize, pool, counter);
+    }
+
+    // Size the output exactly: every letter, padded to a whole block
+    size_t n = key->size();
+    uint64_t letters = countLetters(input.data(), input.size());
+    size_t output_size = (letters + n - 1) / n * n;
+
+    MappedFile output;
+    char* dest = input.data();
+    if (inPlace) {
+        if (output_size > input.size()) {
+            throw runtime_error("In-place encryption needs room for padding; use a separate output");
+        }
+    } else {
+        if (!output.create(outPath, output_size)) {
+            throw runtime_error("Cannot create " + outPath);
+        }
+        dest = output.data();
+    }
+
+    // Output never overtakes the input position, so in place is safe: each
+    // chunk is gathered before any of its ciphertext is written
+    HillStreamEncryptor encryptor(key, &space_map);
+    encryptor.setThreadPool(pool);
+    encryptor.setCounter(counter);
+    size_t written = 0;
+    for (size_t off = 0; off < input.size(); off += chunkSize) {
+        size_t len = min(chunkSize, input.size() - off);
+        written += encryptor.update(input.data() + off, len, dest + written);
+    }
+    written += encryptor.finish(dest + written);
+
+    uint64_t input_size = input.size();
+    if (inPlace) {
+        input.close(written);
+    } else {
+        output.close(written);
+        input.close();
+    }
+    HILL_STAGE(layout, STAGE_LAYOUT, 0);
+    space_map.finish(input_size, written);
+    return {input_size, written, true};
+}
+
+FileResult decryptFile(shared_ptr<const HillKey> key, const string& inPath,
+                       const string& outPath, const string& mapPath,
+                       bool inPlace, size_t chunkSize, ThreadPool* pool,
+                       const HillCounter* counter) {
+    if (chunkSize == 0) chunkSize = DEFAULT_CHUNK_SIZE;
+    checkPaths(inPath, outPath, inPlace);
+    ifstream map_in;
+    unique_ptr<SpaceMapReader> space_map;
+    if (!mapPath.empty()) {
+        if (inPlace) {
+            throw runtime_error("In-place decryption cannot re-insert spaces; run without a space map");
+        }
+        map_in.open(mapPath, ios::binary);
+        if (!map_in) {
+            throw runtime_error("Cannot open " + mapPath);
+        }
+        space_map.reset(new SpaceMapReader(map_in));
+    }
+
+    MappedFile input;
+    if (!mapInput(input, inPath, inPlace)) {
+        ifstream in(inPath, ios::binary);
+        if (!in) {
+            throw runtime_error("Cannot open " + inPath);
+        }
+        ofstream out(outPath, ios::binary);
+        if (!out) {
+            throw runtime_error("Cannot open " + outPath + " for writing");
+        }
+        return decryptStream(key, in, out, space_map.get(), chunkSize, pool, counter);
+    }
+
+    // Upper bound: every ciphertext letter plus every mapped space; the file
+    // is trimmed to the real length (padding dropped) at the end. The block
+    // count is checked first so a bad file never leaves an output behind.
+    uint64_t letters = countLetters(input.data(), input.size());
+    if (letters % key->size() != 0) {
+        throw runtime_error("Encrypted text length is not a multiple of the block size");
+    }
+    uint64_t bound = letters;
+    if (space_map) bound += space_map->spaceCount();
+
+    MappedFile output;
+    char* dest = input.data();
+    if (!inPlace) {
+        if (!output.create(outPath, bound)) {
+            throw runtime_error("Cannot create " + outPath);
+        }
+        dest = output.data();
+    }
+
+    HillStreamDecryptor decryptor(key, space_map.get());
+    decryptor.setThreadPool(pool);
+    decryptor.setCounter(counter);
+    size_t written = 0;
+    try {
+        for (size_t off = 0; off < input.size(); off += chunkSize) {
+            size_t len = min(chunkSize, input.size() - off);
+            written += decryptor.update(input.data() + off, len, dest + written);
+        }
+        written += decryptor.finish(dest + written);
+    } catch (...) {
+        // Never leave a pre-sized, half-written output behind
+        if (!inPlace) {
+            output.close(0);
+            remove(outPath.c_str());
+        }
+        throw;
+    }
+
+    uint64_t input_size = input.size();
+    if (inPlace) {
+        input.close(written);
+    } else {
+        output.close(written);
+        input.close();
+    }
+    return {input_size, written, true};
+}
@@ -0,0 +1,65 @@
+#ifndef HILL_FILE_H
+#define HILL_FILE_H
+
+#include "hill_key.h"
+#include "hill_stream.h"
+#include "hill_parallel.h"
+#include "shm_ring.h"
+#include <string>
+#include <istream>
+#include <ostream>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+// Outcome of a file-to-file run
+struct FileResult {
+    uint64_t inputBytes;
+    uint64_t outputBytes;
+    bool mapped;            // false when the buffered fallback was used
+};
+
+// Default read size for the buffered paths
+const size_t DEFAULT_CHUNK_SIZE = 1 << 16;
+
+// Every function here takes an optional counter for counter-offset mode
+// (see hill_counter.h); nullptr is plain Hill.
+
+// Buffered streaming: reads `in` in chunks and writes to `out` as it goes
+FileResult encryptStream(std::shared_ptr<const HillKey> key, std::istream& in, std::ostream& out,
+                        SpaceMapWriter* spaceMap, size_t chunkSize = DEFAULT_CHUNK_SIZE,
+                        ThreadPool* pool = nullptr, const HillCounter* counter = nullptr);
+FileResult decryptStream(std::shared_ptr<const HillKey> key, std::istream& in, std::ostream& out,
+                        SpaceMapReader* spaceMap, size_t chunkSize = DEFAULT_CHUNK_SIZE,
+                        ThreadPool* pool = nullptr, const HillCounter* counter = nullptr);
+
+// Shared-memory pipeline between two processes. Each chunk of input becomes
+// one ring record holding its letter count, space positions and ciphertext
+// (padded to a whole block on its own), encrypted straight into the ring;
+// the decrypting side reads records where they lie and writes the restored
+// text to `out`.
+FileResult encryptToRing(std::shared_ptr<const HillKey> key, std::istream& in, ShmRing& ring,
+                         size_t chunkSize = DEFAULT_CHUNK_SIZE, ThreadPool* pool = nullptr,
+                         const HillCounter* counter = nullptr);
+FileResult decryptFromRing(std::shared_ptr<const HillKey> key, ShmRing& ring, std::ostream& out,
+                           ThreadPool* pool = nullptr, const HillCounter* counter = nullptr);
+
+// File to file through memory maps: the input is mapped read-only, the output
+// file is sized up front and ciphertext is written straight into its mapping.
+// With inPlace the input itself is mapped read-write and transformed where it
+// lies (outPath is ignored). Inputs that cannot be mapped, such as pipes, go
+// through the buffered path instead. mapPath is the space map to write
+// (encrypt) or read (decrypt; empty for none). Either map format is accepted
+// when decrypting.
+FileResult encryptFile(std::shared_ptr<const HillKey> key, const std::string& inPath,
+                       const std::string& outPath, const std::string& mapPath,
+                       bool inPlace = false, size_t chunkSize = DEFAULT_CHUNK_SIZE,
+                       ThreadPool* pool = nullptr,
+                       SpaceMapFormat mapFormat = SPACE_MAP_BINARY,
+                       const HillCounter* counter = nullptr);
+FileResult decryptFile(std::shared_ptr<const HillKey> key, const std::string& inPath,
+                       const std::string& outPath, const std::string& mapPath,
+                       bool inPlace = false, size_t chunkSize = DEFAULT_CHUNK_SIZE,
+                       ThreadPool* pool = nullptr, const HillCounter* counter = nullptr);
+
+#endif
@@ -0,0 +1,290 @@
+#include "hill_format.h"
+#include "mapped_file.h"
+#include "hill_metrics.h"
+#include "hill_normalize.h"
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+using namespace std;
+
+/* ---------- LETTERS ---------- */
+// Letters gathered per batch, small enough to stay in L1 with their text
+static const size_t BATCH_LETTERS = 4096;
+
+// The first count letters of text, as indices
+static void gather(const char* text, uint8_t* vals, size_t count) {
+    for (size_t pos = 0, k = 0; k < count; pos++) {
+        uint8_t v = letterIndex(text[pos]);
+        if (v != NOT_A_LETTER) vals[k++] = v;
+    }
+}
+
+// Write count letters back over the first count letters of text, keeping
+// the case of each position (0x20 is the lower-case bit in ASCII)
+static void scatter(char* text, const uint8_t* vals, size_t count) {
+    for (size_t pos = 0, k = 0; k < count; pos++) {
+        unsigned char c = text[pos];
+        if (letterIndex(c) != NOT_A_LETTER) {
+            text[pos] = char(('A' + vals[k++]) | (c & 0x20));
+        }
+    }
+}
+
+// Text with some letters but fewer than a block cannot be encrypted
+static runtime_error tooFewLetters(size_t n, size_t got) {
+    return runtime_error("Format-preserving mode needs at least " + to_string(n) +
+                         " letters (the key size); the text has " + to_string(got));
+}
+
+/* ---------- CIPHER ---------- */
+FormatCipher::FormatCipher(const HillKey& key, bool decrypt, const HillCounter* counter)
+    : key(key), decrypt(decrypt), counter(counter), block(0), held(false) {
+}
+
+size_t FormatCipher::update(char* text, size_t len) {
+    return pass(text, len, false);
+}
+
+void FormatCipher::finish(char* text, size_t len) {
+    pass(text, len, true);
+}
+
+size_t FormatCipher::pass(char* text, size_t len, bool final) {
+    size_t n = key.size();
+    const HillBackend& backend = decrypt ? key.decryptor() : key.encryptor();
+
+    uint8_t local[BATCH_LETTERS];
+    vector<uint8_t> large;
+    uint8_t* vals = local;
+    size_t cap = BATCH_LETTERS / n * n;
+    if (cap == 0) {
+        large.resize(n);
+        vals = large.data();
+        cap = n;
+    }
+
+    // lastBlock: first letter of the last whole block (len while there is
+    // none); the block carried over from the last call is already done
+    size_t pos = 0, lastBlock = len;
+    if (held) {
+        for (size_t k = 0; k < n && pos < len; pos++) {
+            if (letterIndex(text[pos]) == NOT_A_LETTER) continue;
+            if (k++ == 0) lastBlock = pos;
+        }
+    }
+
+    size_t tail = 0, tailStart = len;
+    while (pos < len) {
+        // Gather up to a batch of letters, noting where each block starts
+        size_t start = pos, got = 0;
+        size_t blockStart = len, prevStart = len;
+        {
+            HILL_STAGE_IF(normalize, STAGE_NORMALIZE, 0, len - start >= METRICS_TIMED_BYTES);
+            for (; pos < len && got < cap; pos++) {
+                uint8_t v = letterIndex(text[pos]);
+                if (v == NOT_A_LETTER) continue;
+                if (got % n == 0) {
+                    prevStart = blockStart;
+                    blockStart = pos;
+                }
+                vals[got++] = v;
+            }
+            HILL_STAGE_BYTES(normalize, pos - start);
+        }
+
+        size_t whole = got / n;
+        if (whole > 0) {
+            bool timed = got >= METRICS_TIMED_BYTES;
+            applyBlocks(backend, counter, decrypt, vals, vals, whole, block, nullptr);
+            block += whole;
+
+            HILL_STAGE_IF(layout, STAGE_LAYOUT, pos - start, timed);
+            scatter(text + start, vals, whole * n);
+        }
+
+        // A short block can only be the end of the text
+        tail = got - whole * n;
+        if (tail > 0) {
+            tailStart = blockStart;
+            if (whole > 0) lastBlock = prevStart;
+        } else if (whole > 0) {
+            lastBlock = blockStart;
+        }
+    }
+
+    if (!final) {
+        held = lastBlock != len;
+        return held ? lastBlock : tailStart;
+    }
+    if (tail > 0) {
+        if (lastBlock == len) {
+            throw tooFewLetters(n, tail);
+        }
+        finishWindow(text + lastBlock, tail);
+    }
+    held = false;
+    return len;
+}
+
+// text starts at the last whole block and holds it plus `tail` more letters.
+// The window is the last n of those letters.
+void FormatCipher::finishWindow(char* text, size_t tail) {
+    size_t n = key.size();
+    size_t count = n + tail;
+    uint8_t local[BATCH_LETTERS];
+    vector<uint8_t> large;
+    uint8_t* vals = local;
+    if (count > BATCH_LETTERS) {
+        large.resize(count);
+        vals = large.data();
+    }
+    gather(text, vals, count);
+
+    uint8_t* last = vals;
+    uint8_t* window = vals + tail;
+    if (decrypt) {
+        // The last block was decrypted before the window was known: take it
+        // back to ciphertext, peel off the window, then decrypt it again
+        applyBlocks(key.encryptor(), counter, false, last, last, 1, block - 1, nullptr);
+        applyBlocks(key.decryptor(), counter, true, window, window, 1, block, nullptr);
+        applyBlocks(key.decryptor(), counter, true, last, last, 1, block - 1, nullptr);
+    } else {
+        applyBlocks(key.encryptor(), counter, false, window, window, 1, block, nullptr);
+    }
+    block++;
+    scatter(text, vals, count);
+}
+
+/* ---------- BUFFERS ---------- */
+void encryptFormatted(const HillKey& key, char* text, size_t len, const HillCounter* counter) {
+    FormatCipher(key, false, counter).finish(text, len);
+}
+
+void decryptFormatted(const HillKey& key, char* text, size_t len, const HillCounter* counter) {
+    FormatCipher(key, true, counter).finish(text, len);
+}
+
+/* ---------- STREAMS ---------- */
+static size_t readInto(istream& in, char* dest, size_t count) {
+    HILL_STAGE(read, STAGE_READ, 0);
+    in.read(dest, count);
+    HILL_STAGE_BYTES(read, in.gcount());
+    return in.gcount();
+}
+
+static void writeFrom(ostream& out, const char* data, size_t count) {
+    HILL_STAGE(write, STAGE_WRITE, count);
+    out.write(data, count);
+}
+
+// The carried stretch stays at the front of the buffer and each chunk is
+// read in behind it
+static FileResult formatStream(FormatCipher& cipher, bool decrypt, istream& in, ostream& out,
+                               size_t chunkSize) {
+    size_t chunk = max<size_t>(chunkSize, 1);
+    vector<char> buffer(chunk);
+    size_t have = 0;
+    uint64_t consumed = 0;
+    while (true) {
+        if (buffer.size() < have + chunk) buffer.resize(have + chunk);
+        size_t len = readInto(in, buffer.data() + have, chunk);
+        if (len == 0) break;
+        consumed += len;
+        have += len;
+        size_t done = cipher.update(buffer.data(), have);
+        writeFrom(out, buffer.data(), done);
+        memmove(buffer.data(), buffer.data() + done, have - done);
+        have -= done;
+    }
+    cipher.finish(buffer.data(), have);
+    writeFrom(out, buffer.data(), have);
+    out.flush();
+    if (!out) {
+        throw runtime_error(decrypt ? "Failed to write decrypted output" : "Failed to write encrypted output");
+    }
+    return {consumed, consumed, false};
+}
+
+FileResult encryptFormattedStream(const HillKey& key, istream& in, ostream& out,
+                                  size_t chunkSize, const HillCounter* counter) {
+    FormatCipher cipher(key, false, counter);
+    return formatStream(cipher, false, in, out, chunkSize);
+}
+
+FileResult decryptFormattedStream(const HillKey& key, istream& in, ostream& out,
+                                  size_t chunkSize, const HillCounter* counter) {
+    FormatCipher cipher(key, true, counter);
+    return formatStream(cipher, true, in, out, chunkSize);
+}
+
+/* ---------- MEMORY MAPPED ---------- */
+static FileResult formatFile(const HillKey& key, bool decrypt, const string& inPath,
+                             const string& outPath, bool inPlace, size_t chunkSize,
+                             const HillCounter* counter) {
+    if (chunkSize == 0) chunkSize = DEFAULT_CHUNK_SIZE;
+    if (!inPlace && inPath == outPath) {
+        throw runtime_error("Input and output are the same file; use in-place mode");
+    }
+    FormatCipher cipher(key, decrypt, counter);
+
+    MappedFile input;
+    bool mapped = inPlace ? input.openReadWrite(inPath) : input.openRead(inPath);
+    if (!mapped) {
+        if (inPlace) {
+            throw runtime_error("In-place mode needs a regular file: " + inPath);
+        }
+        ifstream in(inPath, ios::binary);
+        if (!in) {
+            throw runtime_error("Cannot open " + inPath);
+        }
+        ofstream out(outPath, ios::binary);
+        if (!out) {
+            throw runtime_error("Cannot open " + outPath + " for writing");
+        }
+        return formatStream(cipher, decrypt, in, out, chunkSize);
+    }
+    input.adviseSequential();
+
+    // Checked before the output exists, so a failed run never leaves the
+    // copied text behind as if it were the result
+    size_t size = input.size();
+    size_t letters = countText(input.data(), size).letters;
+    if (letters > 0 && letters < size_t(key.size())) {
+        throw tooFewLetters(key.size(), letters);
+    }
+    MappedFile output;
+    char* dest = input.data();
+    if (!inPlace) {
+        if (!output.create(outPath, size)) {
+            throw runtime_error("Cannot create " + outPath);
+        }
+        dest = output.data();
+    }
+
+    // Copy a chunk and transform it while it is still in cache; everything
+    // before `done` is final
+    size_t done = 0;
+    for (size_t off = 0; off < size; off += chunkSize) {
+        size_t len = min(chunkSize, size - off);
+        if (!inPlace) memcpy(dest + off, input.data() + off, len);
+        done += cipher.update(dest + done, off + len - done);
+    }
+    cipher.finish(dest + done, size - done);
+
+    if (!inPlace) output.close();
+    input.close();
+    return {size, size, true};
+}
+
+FileResult encryptFormattedFile(const HillKey& key, const string& inPath, const string& outPath,
+                                bool inPlace, size_t chunkSize, const HillCounter* counter) {
+    return formatFile(key, false, inPath, outPath, inPlace, chunkSize, counter);
+}
+
+FileResult decryptFormattedFile(const HillKey& key, const string& inPath, const string& outPath,
+                                bool inPlace, size_t chunkSize, const HillCounter* counter) {
+    return formatFile(key, true, inPath, outPath, inPlace, chunkSize, counter);
+}
@@ -0,0 +1,82 @@
+#ifndef HILL_FORMAT_H
+#define HILL_FORMAT_H
+
+#include "hill_key.h"
+#include "hill_counter.h"
+#include "hill_file.h"
+#include <string>
+#include <istream>
+#include <ostream>
+#include <cstddef>
+#include <cstdint>
+
+// Format-preserving mode: letters are encrypted where they stand and every
+// other byte (digits, punctuation, spaces, newlines) is left alone, as is the
+// case of each position. The output has the same length as the input, so
+// there is no space map, no padding and no separate letters-only copy, and a
+// file can be transformed in place.
+//
+// Letters are gathered a few thousand at a time into a small cache-resident
+// array, transformed with the key's backend and written back over the same
+// stretch of text while it is still in cache, so each byte is read and
+// written once.
+//
+// A final block of r < n letters cannot be padded without growing the text.
+// Instead the last n letters (r new ones plus n - r from the last whole
+// block, already encrypted) are encrypted once more as a window, the way
+// ciphertext stealing works for block ciphers. The text therefore needs at
+// least n letters, or none at all.
+class FormatCipher {
+public:
+    FormatCipher(const HillKey& key, bool decrypt, const HillCounter* counter = nullptr);
+
+    // Transform the letters of text[0, len) in place. Returns how many bytes
+    // at the front are final. The rest (from the last whole block on) must
+    // be passed again at the front of the next call, followed by new text.
+    size_t update(char* text, size_t len);
+
+    // Transform everything left, including a short last block
+    void finish(char* text, size_t len);
+
+    // Blocks transformed so far
+    uint64_t blocks() const { return block; }
+
+private:
+    size_t pass(char* text, size_t len, bool final);
+    void finishWindow(char* text, size_t tail);
+
+    const HillKey& key;
+    bool decrypt;
+    const HillCounter* counter;
+    uint64_t block;     // index of the next block
+    bool held;          // the front of the next call starts with a done block
+};
+
+// Whole buffer in one call (out of place: copy first)
+void encryptFormatted(const HillKey& key, char* text, size_t len,
+                      const HillCounter* counter = nullptr);
+void decryptFormatted(const HillKey& key, char* text, size_t len,
+                      const HillCounter* counter = nullptr);
+
+// Buffered streaming. Memory use is the chunk size plus the carried stretch
+// from the last whole block on, which only grows across text with fewer
+// than n letters per chunk.
+FileResult encryptFormattedStream(const HillKey& key, std::istream& in, std::ostream& out,
+                                  size_t chunkSize = DEFAULT_CHUNK_SIZE,
+                                  const HillCounter* counter = nullptr);
+FileResult decryptFormattedStream(const HillKey& key, std::istream& in, std::ostream& out,
+                                  size_t chunkSize = DEFAULT_CHUNK_SIZE,
+                                  const HillCounter* counter = nullptr);
+
+// Memory-mapped file to file, or in place (outPath ignored); falls back to
+// the stream functions when the input cannot be mapped
+FileResult encryptFormattedFile(const HillKey& key, const std::string& inPath,
+                                const std::string& outPath, bool inPlace,
+                                size_t chunkSize = DEFAULT_CHUNK_SIZE,
+                                const HillCounter* counter = nullptr);
+FileResult decryptFormattedFile(const HillKey& key, const std::string& inPath,
+                                const std::string& outPath, bool inPlace,
+                                size_t chunkSize = DEFAULT_CHUNK_SIZE,
+                                const HillCounter* counter = nullptr);
+
+#endif
@@ -0,0 +1,215 @@
+#include "hill_gemm.h"
+#include "hill_kernel.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HILL_GEMM_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+/* ---------- TILING ---------- */
+// A register tile is MR blocks by one or two key panels of LANES letters.
+// Packed input per chunk is at most PACK_VALUES 16-bit letters (32KB).
+static const int    LANES = 16;
+static const int    MR = 6;
+static const size_t PACK_VALUES = 16384;
+
+/* ---------- MOD 26 REDUCTION ---------- */
+// A reduced carry (< 26) plus 104 products of at most 25 * 25 stays below
+// 65536, so 16-bit lanes fold once per FOLD_TERMS terms.
+static const int FOLD_TERMS = 104;
+
+// floor(y * 2520 / 65536) is floor(y / 26) or one less for every 16-bit y,
+// so the remainder is below 52 and one conditional subtract finishes it
+static const uint16_t BARRETT26_LOW = 2520;
+
+static inline uint16_t fold26(uint32_t y) {
+    uint32_t r = y - ((y * BARRETT26_LOW) >> 16) * 26;
+    return uint16_t(r >= 26 ? r - 26 : r);
+}
+
+// Portable tile: the same loop order as the SIMD one, on arrays the
+// compiler can keep in vector registers
+template <int NV, bool BYTES>
+static void tileScalar(const uint16_t* a, const uint16_t* k, int n, uint8_t* out,
+                       int rows, int cols) {
+    uint16_t acc[MR][NV * LANES] = {};
+    for (int j0 = 0; j0 < n; j0 += FOLD_TERMS) {
+        int j1 = BYTES ? n : min(n, j0 + FOLD_TERMS);
+        for (int j = j0; j < j1; j++) {
+            const uint16_t* col = a + j * MR;
+            for (int v = 0; v < NV; v++) {
+                const uint16_t* kv = k + (v * n + j) * LANES;
+                for (int r = 0; r < MR; r++) {
+                    for (int c = 0; c < LANES; c++) {
+                        acc[r][v * LANES + c] += uint16_t(col[r] * kv[c]);
+                    }
+                }
+            }
+        }
+        if (BYTES) break;
+        for (int r = 0; r < MR; r++) {
+            for (int c = 0; c < NV * LANES; c++) acc[r][c] = fold26(acc[r][c]);
+        }
+    }
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < cols; c++) out[r * n + c] = uint8_t(acc[r][c]);
+    }
+}
+
+#ifdef HILL_GEMM_X86
+/* ---------- SIMD ---------- */
+__attribute__((target("avx2")))
+static inline __m256i fold26_epu16(__m256i y) {
+    __m256i q = _mm256_mulhi_epu16(y, _mm256_set1_epi16(BARRETT26_LOW));
+    __m256i r = _mm256_sub_epi16(y, _mm256_mullo_epi16(q, _mm256_set1_epi16(26)));
+    return _mm256_min_epu16(r, _mm256_sub_epi16(r, _mm256_set1_epi16(26)));
+}
+
+// One step of the tile: key row j of both panels times MR broadcast letters
+#define HILL_GEMM_ROW(r)                                                        \
+    {                                                                           \
+        __m256i x = _mm256_set1_epi16(short(col[r]));                           \
+        a##r##0 = _mm256_add_epi16(a##r##0, _mm256_mullo_epi16(x, k0));        \
+        if (NV == 2) a##r##1 = _mm256_add_epi16(a##r##1, _mm256_mullo_epi16(x, k1)); \
+    }
+
+// MR x (NV * 16) tile. The accumulators are named variables rather than an
+// array so they stay in registers (12 of the 16 ymm registers for NV = 2).
+template <int NV, bool BYTES>
+__attribute__((target("avx2")))
+static void tileAVX2(const uint16_t* a, const uint16_t* k, int n, uint8_t* out,
+                     int rows, int cols) {
+    __m256i a00 = _mm256_setzero_si256(), a01 = a00, a10 = a00, a11 = a00, a20 = a00, a21 = a00,
+            a30 = a00, a31 = a00, a40 = a00, a41 = a00, a50 = a00, a51 = a00;
+    for (int j0 = 0; j0 < n; j0 += FOLD_TERMS) {
+        int j1 = BYTES ? n : min(n, j0 + FOLD_TERMS);
+        for (int j = j0; j < j1; j++) {
+            const uint16_t* col = a + j * MR;
+            __m256i k0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(k + j * LANES));
+            __m256i k1 = k0;
+            if (NV == 2) k1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(k + (n + j) * LANES));
+            HILL_GEMM_ROW(0) HILL_GEMM_ROW(1) HILL_GEMM_ROW(2)
+            HILL_GEMM_ROW(3) HILL_GEMM_ROW(4) HILL_GEMM_ROW(5)
+        }
+        if (BYTES) break;
+        a00 = fold26_epu16(a00); a10 = fold26_epu16(a10); a20 = fold26_epu16(a20);
+        a30 = fold26_epu16(a30); a40 = fold26_epu16(a40); a50 = fold26_epu16(a50);
+        if (NV == 2) {
+            a01 = fold26_epu16(a01); a11 = fold26_epu16(a11); a21 = fold26_epu16(a21);
+            a31 = fold26_epu16(a31); a41 = fold26_epu16(a41); a51 = fold26_epu16(a51);
+        }
+    }
+    const __m256i acc[MR][2] = {{a00, a01}, {a10, a11}, {a20, a21}, {a30, a31}, {a40, a41}, {a50, a51}};
+
+    // Narrow to bytes (mod 256 keeps the low byte; packus would saturate)
+    const __m256i low = _mm256_set1_epi16(0x00FF);
+    for (int r = 0; r < rows; r++) {
+        __m256i y0 = BYTES ? _mm256_and_si256(acc[r][0], low) : acc[r][0];
+        __m256i y1 = y0;
+        if (NV == 2) y1 = BYTES ? _mm256_and_si256(acc[r][1], low) : acc[r][1];
+        __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(y0, y1), 0xD8);
+        uint8_t* dst = out + r * n;
+        if (cols == NV * LANES) {
+            if (NV == 2) _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), bytes);
+            else _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm256_castsi256_si128(bytes));
+        } else {
+            uint8_t tmp[2 * LANES];
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(tmp), bytes);
+            memcpy(dst, tmp, cols);
+        }
+    }
+}
+#undef HILL_GEMM_ROW
+#endif
+
+/* ---------- BACKEND ---------- */
+HillGemm::HillGemm(const vector<vector<int>>& key, int modulus, bool simd)
+    : n(key.size()), mod(modulus), panels((n + LANES - 1) / LANES),
+      wide(simd && HillKernel::detect() == HillKernel::AVX2) {
+    if (n == 0) {
+        throw runtime_error("Key matrix is empty");
+    }
+    if (mod != 26 && mod != 256) {
+        throw runtime_error("GEMM modulus must be 26 or 256");
+    }
+#ifndef HILL_GEMM_X86
+    wide = false;
+#endif
+    packed.assign(size_t(panels) * n * LANES, 0);
+    for (int i = 0; i < n; i++) {
+        if ((int)key[i].size() != n) {
+            throw runtime_error("Key matrix must be square");
+        }
+        for (int j = 0; j < n; j++) {
+            packed[((i / LANES) * n + j) * LANES + i % LANES] = uint16_t(((key[i][j] % mod) + mod) % mod);
+        }
+    }
+}
+
+typedef void (*TileFn)(const uint16_t*, const uint16_t*, int, uint8_t*, int, int);
+
+template <bool BYTES>
+static void tiles(bool wide, TileFn fn[2]) {
+#ifdef HILL_GEMM_X86
+    if (wide) {
+        fn[0] = tileAVX2<1, BYTES>;
+        fn[1] = tileAVX2<2, BYTES>;
+        return;
+    }
+#else
+    (void)wide;
+#endif
+    fn[0] = tileScalar<1, BYTES>;
+    fn[1] = tileScalar<2, BYTES>;
+}
+
+void HillGemm::apply(const uint8_t* in, uint8_t* out, size_t blocks) const {
+    TileFn tile[2];
+    if (mod == 256) tiles<true>(wide, tile);
+    else tiles<false>(wide, tile);
+
+    // Packed chunk: tiles of MR blocks, each [j][r] so a step reads MR letters
+    uint16_t local[PACK_VALUES];
+    vector<uint16_t> large;
+    uint16_t* pack = local;
+    size_t tileValues = size_t(n) * MR;
+    size_t chunkTiles = PACK_VALUES / tileValues;
+    if (chunkTiles == 0) {
+        large.resize(tileValues);
+        pack = large.data();
+        chunkTiles = 1;
+    }
+
+    for (size_t b0 = 0; b0 < blocks; b0 += chunkTiles * MR) {
+        size_t count = min(chunkTiles * MR, blocks - b0);
+        size_t tileCount = (count + MR - 1) / MR;
+
+        // Pack the whole chunk before writing any of it, so in-place works
+        for (size_t t = 0; t < tileCount; t++) {
+            uint16_t* dst = pack + t * tileValues;
+            size_t rows = min<size_t>(MR, count - t * MR);
+            const uint8_t* src = in + (b0 + t * MR) * n;
+            for (size_t r = 0; r < size_t(MR); r++) {
+                for (int j = 0; j < n; j++) {
+                    dst[j * MR + r] = r < rows ? src[r * n + j] : 0;
+                }
+            }
+        }
+
+        for (int p = 0; p < panels; p += 2) {
+            int nv = min(2, panels - p);
+            int cols = min(nv * LANES, n - p * LANES);
+            const uint16_t* k = packed.data() + size_t(p) * n * LANES;
+            for (size_t t = 0; t < tileCount; t++) {
+                int rows = int(min<size_t>(MR, count - t * MR));
+                tile[nv - 1](pack + t * tileValues, k, n, out + (b0 + t * MR) * n + p * LANES,
+                             rows, cols);
+            }
+        }
+    }
+}
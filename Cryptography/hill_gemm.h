@@ -0,0 +1,41 @@
+#ifndef HILL_GEMM_H
+#define HILL_GEMM_H
+
+#include "hill_backend.h"
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Tiled integer GEMM backend for larger keys (n = 8..64 and beyond). A batch
+// of B blocks is one B x n matrix P, and the whole batch is P * K^T, so the
+// key is loaded once per tile instead of once per block.
+//
+// The key is packed once into 16-letter column panels. Each chunk of blocks
+// is widened to 16 bits and packed in tiles of 6 blocks, sized to stay in
+// cache next to the key. A 6 x 32 register tile then gets one key row and
+// six broadcast letters per step. Products of letters (at most 25 * 25)
+// build up in 16-bit lanes, and reduction mod 26 only runs when a lane could
+// overflow: every 104 terms, so once per tile for any n up to 104. With
+// modulus 256 the wrapped 16-bit sums are already exact.
+class HillGemm : public HillBackend {
+public:
+    // modulus is 26 (letters) or 256 (bytes); simd = false forces the
+    // portable tile loop even on AVX2 machines
+    explicit HillGemm(const std::vector<std::vector<int>>& key, int modulus = 26,
+                      bool simd = true);
+
+    void apply(const uint8_t* in, uint8_t* out, size_t blocks) const override;
+
+    int size() const override { return n; }
+    const char* name() const override { return wide ? "gemm-avx2" : "gemm"; }
+    int modulus() const { return mod; }
+
+private:
+    int n;
+    int mod;
+    int panels;                      // 16-letter column panels, ceil(n / 16)
+    bool wide;                       // AVX2 tiles
+    std::vector<uint16_t> packed;    // [(panel * n + j) * 16 + c] = K[panel * 16 + c][j]
+};
+
+#endif
@@ -0,0 +1,267 @@
+#include "hill_index.h"
+#include "hill_message.h"
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+using namespace std;
+
+static const char INDEX_MAGIC[4] = {'\x89', 'H', 'I', 'X'};
+static const uint8_t INDEX_VERSION = 1;
+
+// Letters decrypted per read window
+static const size_t WINDOW_LETTERS = 1 << 16;
+
+static void writeU64(ostream& out, uint64_t v) {
+    char bytes[8];
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = char((v >> (8 * i)) & 0xFF);
+    }
+    out.write(bytes, 8);
+}
+
+static uint64_t readU64(istream& in) {
+    unsigned char bytes[8];
+    if (!in.read(reinterpret_cast<char*>(bytes), 8)) {
+        throw runtime_error("Truncated index");
+    }
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) {
+        v = (v << 8) | bytes[i];
+    }
+    return v;
+}
+
+/* ---------- SPACE REPLAY ---------- */
+// The space map as the streaming decryptor consumes it: one position of
+// lookahead, plus the cursor from before that lookahead was read
+struct SpaceFeed {
+    SpaceMapReader* reader;
+    bool have;
+    uint64_t next;
+    SpaceMapCursor before;
+
+    explicit SpaceFeed(SpaceMapReader* reader) : reader(reader), have(false), next(0), before() {
+        advance();
+    }
+
+    void advance() {
+        if (!reader) return;
+        before = reader->tell();
+        have = reader->next(next);
+    }
+
+    // Resumable state covering the lookahead
+    SpaceMapCursor cursor() {
+        return have ? before : (reader ? reader->tell() : SpaceMapCursor());
+    }
+};
+
+/* ---------- BUILD ---------- */
+// Letters in the ciphertext, ignoring trailing whitespace
+static uint64_t cipherLength(const MappedFile& cipher) {
+    uint64_t length = cipher.size();
+    while (length > 0 && isspace((unsigned char)cipher.data()[length - 1])) {
+        length--;
+    }
+    return length;
+}
+
+CipherIndex CipherIndex::build(const HillKey& key, const string& cipherPath, const string& mapPath,
+                               uint64_t blocksPerCheckpoint, const HillCounter* counter) {
+    MappedFile cipher;
+    if (!cipher.openRead(cipherPath)) {
+        throw runtime_error("Cannot map " + cipherPath + " (indexing needs a regular file)");
+    }
+    uint64_t n = key.size();
+    CipherIndex index;
+    index.fingerprint = key.fingerprint();
+    index.keySize = n;
+    index.blocksPerCheckpoint = max<uint64_t>(blocksPerCheckpoint, 1);
+    index.cipherLetters = cipherLength(cipher);
+    if (index.cipherLetters % n != 0) {
+        throw runtime_error("Encrypted text length is not a multiple of the block size");
+    }
+
+    // Trailing 'X' letters are padding; decrypt backwards until a real letter
+    vector<char> block(n);
+    uint64_t letters = index.cipherLetters;
+    for (uint64_t end = letters; end > 0 && letters == end; end -= n) {
+        decryptMessage(key, cipher.data() + end - n, n, block.data(), nullptr, counter, end / n - 1);
+        size_t kept = n;
+        while (kept > 0 && block[kept - 1] == 'X') kept--;
+        letters = end - n + kept;
+    }
+    index.plainLetters = letters;
+
+    ifstream map_in;
+    unique_ptr<SpaceMapReader> reader;
+    uint64_t limit = 0;
+    if (!mapPath.empty()) {
+        map_in.open(mapPath, ios::binary);
+        if (!map_in) {
+            throw runtime_error("Cannot open " + mapPath);
+        }
+        reader.reset(new SpaceMapReader(map_in));
+        if (reader->encryptedLength() != 0 && reader->encryptedLength() != index.cipherLetters) {
+            throw runtime_error("Space map does not belong to " + cipherPath);
+        }
+        limit = reader->originalLength();
+    }
+
+    // Replay the decryptor's space insertion, jumping from space to space:
+    // a space at s is emitted just before letter j + (s - offset)
+    SpaceFeed spaces(reader.get());
+    uint64_t offset = 0, j = 0;
+    uint64_t step = index.blocksPerCheckpoint * n;
+    index.checkpoints.push_back({0, spaces.cursor()});
+    for (uint64_t target = min(step, letters); ; target = min(target + step, letters)) {
+        while (spaces.have) {
+            if (spaces.next < offset) {
+                spaces.advance();
+                continue;
+            }
+            uint64_t before = j + (spaces.next - offset);
+            if (before >= target) break;
+            offset = spaces.next + 1;
+            j = before;
+            spaces.advance();
+        }
+        offset += target - j;
+        j = target;
+        if (target == letters) break;
+        index.checkpoints.push_back({offset, spaces.cursor()});
+    }
+
+    // Spaces after the last letter
+    while (spaces.have && spaces.next <= offset) {
+        if (spaces.next == offset) offset++;
+        spaces.advance();
+    }
+    index.plainLength = limit > 0 ? min(offset, limit) : offset;
+    return index;
+}
+
+/* ---------- FILE ---------- */
+void CipherIndex::save(const string& path) const {
+    ofstream out(path, ios::binary);
+    if (!out) {
+        throw runtime_error("Cannot open " + path + " for writing");
+    }
+    char header[8] = {INDEX_MAGIC[0], INDEX_MAGIC[1], INDEX_MAGIC[2], INDEX_MAGIC[3],
+                      char(INDEX_VERSION), 0, 0, 0};
+    out.write(header, 8);
+    for (uint64_t v : {fingerprint, keySize, blocksPerCheckpoint, cipherLetters, plainLetters,
+                       plainLength, uint64_t(checkpoints.size())}) {
+        writeU64(out, v);
+    }
+    for (const Checkpoint& c : checkpoints) {
+        for (uint64_t v : {c.plainOffset, c.cursor.offset, c.cursor.read, c.cursor.last,
+                           c.cursor.runGap, c.cursor.runLeft}) {
+            writeU64(out, v);
+        }
+    }
+    if (!out) {
+        throw runtime_error("Failed to write " + path);
+    }
+}
+
+CipherIndex CipherIndex::load(const string& path) {
+    ifstream in(path, ios::binary);
+    if (!in) {
+        throw runtime_error("Cannot open " + path);
+    }
+    char header[8];
+    if (!in.read(header, 8) || string(header, 4) != string(INDEX_MAGIC, 4)) {
+        throw runtime_error(path + " is not a ciphertext index");
+    }
+    if (uint8_t(header[4]) != INDEX_VERSION) {
+        throw runtime_error("Unsupported index version " + to_string(uint8_t(header[4])));
+    }
+
+    CipherIndex index;
+    index.fingerprint = readU64(in);
+    index.keySize = readU64(in);
+    index.blocksPerCheckpoint = readU64(in);
+    index.cipherLetters = readU64(in);
+    index.plainLetters = readU64(in);
+    index.plainLength = readU64(in);
+    uint64_t count = readU64(in);
+    if (index.keySize == 0 || count == 0 || count > index.cipherLetters / index.keySize + 1) {
+        throw runtime_error("Malformed index " + path);
+    }
+    index.checkpoints.resize(count);
+    for (Checkpoint& c : index.checkpoints) {
+        c.plainOffset = readU64(in);
+        c.cursor = {readU64(in), readU64(in), readU64(in), readU64(in), readU64(in)};
+    }
+    return index;
+}
+
+/* ---------- RANGES ---------- */
+RangeDecryptor::RangeDecryptor(shared_ptr<const HillKey> key, const string& cipherPath,
+                               const string& mapPath, const string& indexPath,
+                               const HillCounter* counter)
+    : key(key), counter(counter ? new HillCounter(*counter) : nullptr),
+      index(CipherIndex::load(indexPath)) {
+    if (index.fingerprint != key->fingerprint() || index.keySize != uint64_t(key->size())) {
+        throw runtime_error(indexPath + " was built with a different key");
+    }
+    if (!cipher.openRead(cipherPath) || cipherLength(cipher) != index.cipherLetters) {
+        throw runtime_error(indexPath + " does not match " + cipherPath);
+    }
+    if (!mapPath.empty()) {
+        mapStream.open(mapPath, ios::binary);
+        if (!mapStream) {
+            throw runtime_error("Cannot open " + mapPath);
+        }
+        spaceMap.reset(new SpaceMapReader(mapStream));
+        // The same check build() makes; a wrong map would give wrong text
+        if (spaceMap->encryptedLength() != 0 && spaceMap->encryptedLength() != index.cipherLetters) {
+            throw runtime_error("Space map does not belong to " + cipherPath);
+        }
+    }
+    window.resize(WINDOW_LETTERS / key->size() * key->size());
+}
+
+string RangeDecryptor::read(uint64_t begin, uint64_t end) {
+    end = min(end, index.plainLength);
+    string out;
+    if (begin >= end) return out;
+    out.reserve(end - begin);
+
+    // Last checkpoint at or before begin
+    auto after = upper_bound(index.checkpoints.begin(), index.checkpoints.end(), begin,
+                             [](uint64_t offset, const CipherIndex::Checkpoint& c) {
+                                 return offset < c.plainOffset;
+                             });
+    size_t c = after - index.checkpoints.begin() - 1;
+    uint64_t offset = index.checkpoints[c].plainOffset;
+    uint64_t j = c * index.blocksPerCheckpoint * index.keySize;
+    if (spaceMap) spaceMap->seek(index.checkpoints[c].cursor);
+    SpaceFeed spaces(spaceMap.get());
+
+    // Same emission order as HillStreamDecryptor, from the checkpoint on
+    uint64_t windowStart = j, windowEnd = j;
+    while (offset < end) {
+        while (spaces.have && spaces.next <= offset && offset < end) {
+            if (spaces.next == offset) {
+                if (offset >= begin) out.push_back(' ');
+                offset++;
+            }
+            spaces.advance();
+        }
+        if (j >= index.plainLetters || offset >= end) break;
+
+        if (j >= windowEnd) {
+            windowStart = j;
+            windowEnd = min<uint64_t>(j + window.size(), index.cipherLetters);
+            decryptMessage(*key, cipher.data() + windowStart, windowEnd - windowStart, window.data(),
+                           nullptr, counter.get(), windowStart / index.keySize);
+        }
+        if (offset >= begin) out.push_back(window[j - windowStart]);
+        offset++;
+        j++;
+    }
+    return out;
+}
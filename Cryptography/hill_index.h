@@ -0,0 +1,80 @@
+#ifndef HILL_INDEX_H
+#define HILL_INDEX_H
+
+#include "hill_key.h"
+#include "space_map.h"
+#include "mapped_file.h"
+#include "hill_counter.h"
+#include <vector>
+#include <string>
+#include <fstream>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+// Index sidecar for random access into a ciphertext. Every `blocks` blocks
+// it checkpoints where the plaintext stands (its offset, counting the spaces
+// put back so far) and where the space map reader stands, so any plaintext
+// range can be decrypted starting from the nearest checkpoint instead of the
+// beginning. Hill blocks decrypt independently, which makes that exact.
+//
+// Layout (version 1), all integers little-endian u64 unless noted:
+//   magic "\x89HIX" | version u8 | 3 reserved bytes
+//   key fingerprint | key size | blocks per checkpoint
+//   ciphertext letters | plaintext letters (padding removed) | plaintext length
+//   checkpoint count, then per checkpoint:
+//     plaintext offset | space map cursor (offset, read, last, runGap, runLeft)
+// Checkpoint c is the state just before letter c * blocks * n.
+struct CipherIndex {
+    struct Checkpoint {
+        uint64_t plainOffset;
+        SpaceMapCursor cursor;
+    };
+
+    uint64_t fingerprint;
+    uint64_t keySize;
+    uint64_t blocksPerCheckpoint;
+    uint64_t cipherLetters;
+    uint64_t plainLetters;
+    uint64_t plainLength;
+    std::vector<Checkpoint> checkpoints;
+
+    // Walk the space map (mapPath empty for none) and decrypt the last
+    // blocks to find the padding. The ciphertext must be letters only, as
+    // the programs write it (trailing whitespace is ignored). counter is
+    // needed for counter-offset ciphertext.
+    static CipherIndex build(const HillKey& key, const std::string& cipherPath,
+                             const std::string& mapPath, uint64_t blocksPerCheckpoint = 1024,
+                             const HillCounter* counter = nullptr);
+
+    void save(const std::string& path) const;
+    static CipherIndex load(const std::string& path);
+};
+
+// Decrypts arbitrary plaintext ranges of an indexed ciphertext. A range
+// costs its own length plus at most one checkpoint interval, whatever the
+// size of the file.
+class RangeDecryptor {
+public:
+    // counter: for counter-offset ciphertext (copied), nullptr for plain Hill
+    RangeDecryptor(std::shared_ptr<const HillKey> key, const std::string& cipherPath,
+                   const std::string& mapPath, const std::string& indexPath,
+                   const HillCounter* counter = nullptr);
+
+    // Plaintext bytes the full decryption produces
+    uint64_t length() const { return index.plainLength; }
+
+    // Plaintext bytes [begin, end), clipped to length()
+    std::string read(uint64_t begin, uint64_t end);
+
+private:
+    std::shared_ptr<const HillKey> key;
+    std::unique_ptr<HillCounter> counter;
+    CipherIndex index;
+    MappedFile cipher;
+    std::ifstream mapStream;
+    std::unique_ptr<SpaceMapReader> spaceMap;
+    std::vector<char> window;
+};
+
+#endif
@@ -0,0 +1,329 @@
+#include "hill_kernel.h"
+#include <stdexcept>
+#include <algorithm>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HILL_KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+/* ---------- MOD 26 REDUCTION ---------- */
+// floor(y / 26) == (y * 80660) >> 21 for every y < 53248, which keeps the
+// product inside 32 bits. The scalar loop folds the sum before it gets there.
+static const uint32_t BARRETT26_32 = 80660;
+static const int      BARRETT26_SHIFT = 21;
+static const uint32_t SCALAR_FOLD_TERMS = 64;   // 64 * 25 * 25 + 25 < 53248
+
+// 16-bit variant used in SIMD lanes: floor(y / 26) == (y * 2521) >> 16 for
+// y < 6553, and a 3-term dot product never exceeds 3 * 25 * 25 = 1875.
+static const uint16_t BARRETT26_16 = 2521;
+
+static inline uint32_t reduce26(uint32_t y) {
+    uint32_t q = (y * BARRETT26_32) >> BARRETT26_SHIFT;
+    return y - q * 26;
+}
+
+// BYTES: modulus 256. A uint32 sum wraps at a multiple of 256, so its low
+// byte is exact however many terms it holds and nothing is folded.
+template <bool BYTES>
+static void applyScalar(const int16_t* key, int n, const uint8_t* in, uint8_t* out, size_t blocks) {
+    uint32_t acc[64];
+    vector<uint32_t> wide;
+    uint32_t* sums = acc;
+    if (n > 64) {
+        wide.resize(n);
+        sums = wide.data();
+    }
+
+    for (size_t b = 0; b < blocks; b++) {
+        const uint8_t* x = in + b * n;
+        // Compute all rows before storing so in-place calls work
+        for (int i = 0; i < n; i++) {
+            const int16_t* row = key + i * n;
+            uint32_t sum = 0;
+            if (BYTES) {
+                for (int j = 0; j < n; j++) {
+                    sum += uint32_t(row[j]) * x[j];
+                }
+                sums[i] = sum;
+                continue;
+            }
+            for (int j0 = 0; j0 < n; j0 += SCALAR_FOLD_TERMS) {
+                int j1 = min(n, j0 + int(SCALAR_FOLD_TERMS));
+                for (int j = j0; j < j1; j++) {
+                    sum += uint32_t(row[j]) * x[j];
+                }
+                sum = reduce26(sum);
+            }
+            sums[i] = sum;
+        }
+        uint8_t* y = out + b * n;
+        for (int i = 0; i < n; i++) {
+            y[i] = uint8_t(sums[i]);
+        }
+    }
+}
+
+#ifdef HILL_KERNEL_X86
+/* ---------- SIMD ---------- */
+// Shuffle masks that split 48 interleaved bytes (16 blocks of 3) into three
+// 16-byte lanes x0, x1, x2 and merge them back. 0x80 zeroes the byte.
+struct ShuffleMasks3 {
+    uint8_t split[3][3][16];   // [component][source chunk]
+    uint8_t merge[3][3][16];   // [dest chunk][component]
+
+    ShuffleMasks3() {
+        for (int c = 0; c < 3; c++) {
+            for (int t = 0; t < 3; t++) {
+                for (int k = 0; k < 16; k++) {
+                    int p = 3 * k + c;
+                    split[c][t][k] = (p / 16 == t) ? uint8_t(p % 16) : 0x80;
+                }
+            }
+        }
+        for (int t = 0; t < 3; t++) {
+            for (int c = 0; c < 3; c++) {
+                for (int b = 0; b < 16; b++) {
+                    int p = 16 * t + b;
+                    merge[t][c][b] = (p % 3 == c) ? uint8_t(p / 3) : 0x80;
+                }
+            }
+        }
+    }
+};
+
+static const ShuffleMasks3 MASKS3;
+
+__attribute__((target("ssse3")))
+static inline void split3(const uint8_t* in, __m128i x[3]) {
+    __m128i a[3];
+    for (int t = 0; t < 3; t++) {
+        a[t] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 16 * t));
+    }
+    for (int c = 0; c < 3; c++) {
+        __m128i v = _mm_setzero_si128();
+        for (int t = 0; t < 3; t++) {
+            __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(MASKS3.split[c][t]));
+            v = _mm_or_si128(v, _mm_shuffle_epi8(a[t], m));
+        }
+        x[c] = v;
+    }
+}
+
+__attribute__((target("ssse3")))
+static inline void merge3(const __m128i y[3], uint8_t* out) {
+    for (int t = 0; t < 3; t++) {
+        __m128i v = _mm_setzero_si128();
+        for (int c = 0; c < 3; c++) {
+            __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(MASKS3.merge[t][c]));
+            v = _mm_or_si128(v, _mm_shuffle_epi8(y[c], m));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16 * t), v);
+    }
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i mod26_epu16(__m128i y) {
+    __m128i q = _mm_mulhi_epu16(y, _mm_set1_epi16(BARRETT26_16));
+    return _mm_sub_epi16(y, _mm_mullo_epi16(q, _mm_set1_epi16(26)));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i mod26_epu16(__m256i y) {
+    __m256i q = _mm256_mulhi_epu16(y, _mm256_set1_epi16(BARRETT26_16));
+    return _mm256_sub_epi16(y, _mm256_mullo_epi16(q, _mm256_set1_epi16(26)));
+}
+
+// Mod 256: the wrapped 16-bit sum only needs its high byte cleared
+__attribute__((target("ssse3")))
+static inline __m128i mod256_epu16(__m128i y) {
+    return _mm_and_si128(y, _mm_set1_epi16(0x00FF));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i mod256_epu16(__m256i y) {
+    return _mm256_and_si256(y, _mm256_set1_epi16(0x00FF));
+}
+
+template <bool BYTES>
+__attribute__((target("ssse3")))
+static inline __m128i reduce_epu16(__m128i y) {
+    return BYTES ? mod256_epu16(y) : mod26_epu16(y);
+}
+
+template <bool BYTES>
+__attribute__((target("avx2")))
+static inline __m256i reduce_epu16(__m256i y) {
+    return BYTES ? mod256_epu16(y) : mod26_epu16(y);
+}
+
+// 2x2: each block is one 16-bit lane (low byte x0, high byte x1)
+template <bool BYTES>
+__attribute__((target("ssse3")))
+static size_t apply2SSSE3(const int16_t* key, const uint8_t* in, uint8_t* out, size_t blocks) {
+    const __m128i lo = _mm_set1_epi16(0x00FF);
+    const __m128i k00 = _mm_set1_epi16(key[0]), k01 = _mm_set1_epi16(key[1]);
+    const __m128i k10 = _mm_set1_epi16(key[2]), k11 = _mm_set1_epi16(key[3]);
+
+    size_t b = 0;
+    for (; b + 8 <= blocks; b += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2 * b));
+        __m128i x0 = _mm_and_si128(v, lo);
+        __m128i x1 = _mm_srli_epi16(v, 8);
+        __m128i y0 = _mm_add_epi16(_mm_mullo_epi16(k00, x0), _mm_mullo_epi16(k01, x1));
+        __m128i y1 = _mm_add_epi16(_mm_mullo_epi16(k10, x0), _mm_mullo_epi16(k11, x1));
+        __m128i r = _mm_or_si128(reduce_epu16<BYTES>(y0), _mm_slli_epi16(reduce_epu16<BYTES>(y1), 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * b), r);
+    }
+    return b;
+}
+
+template <bool BYTES>
+__attribute__((target("avx2")))
+static size_t apply2AVX2(const int16_t* key, const uint8_t* in, uint8_t* out, size_t blocks) {
+    const __m256i lo = _mm256_set1_epi16(0x00FF);
+    const __m256i k00 = _mm256_set1_epi16(key[0]), k01 = _mm256_set1_epi16(key[1]);
+    const __m256i k10 = _mm256_set1_epi16(key[2]), k11 = _mm256_set1_epi16(key[3]);
+
+    size_t b = 0;
+    for (; b + 16 <= blocks; b += 16) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 2 * b));
+        __m256i x0 = _mm256_and_si256(v, lo);
+        __m256i x1 = _mm256_srli_epi16(v, 8);
+        __m256i y0 = _mm256_add_epi16(_mm256_mullo_epi16(k00, x0), _mm256_mullo_epi16(k01, x1));
+        __m256i y1 = _mm256_add_epi16(_mm256_mullo_epi16(k10, x0), _mm256_mullo_epi16(k11, x1));
+        __m256i r = _mm256_or_si256(reduce_epu16<BYTES>(y0), _mm256_slli_epi16(reduce_epu16<BYTES>(y1), 8));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2 * b), r);
+    }
+    return b;
+}
+
+// 3x3: split 16 blocks into structure-of-arrays lanes, widen to 16 bits
+template <bool BYTES>
+__attribute__((target("ssse3")))
+static size_t apply3SSSE3(const int16_t* key, const uint8_t* in, uint8_t* out, size_t blocks) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i k[9];
+    for (int i = 0; i < 9; i++) k[i] = _mm_set1_epi16(key[i]);
+
+    size_t b = 0;
+    for (; b + 16 <= blocks; b += 16) {
+        __m128i x[3], y[3];
+        split3(in + 3 * b, x);
+
+        __m128i xl[3], xh[3];
+        for (int j = 0; j < 3; j++) {
+            xl[j] = _mm_unpacklo_epi8(x[j], zero);
+            xh[j] = _mm_unpackhi_epi8(x[j], zero);
+        }
+        for (int i = 0; i < 3; i++) {
+            __m128i sl = _mm_mullo_epi16(k[3 * i], xl[0]);
+            __m128i sh = _mm_mullo_epi16(k[3 * i], xh[0]);
+            for (int j = 1; j < 3; j++) {
+                sl = _mm_add_epi16(sl, _mm_mullo_epi16(k[3 * i + j], xl[j]));
+                sh = _mm_add_epi16(sh, _mm_mullo_epi16(k[3 * i + j], xh[j]));
+            }
+            y[i] = _mm_packus_epi16(reduce_epu16<BYTES>(sl), reduce_epu16<BYTES>(sh));
+        }
+        merge3(y, out + 3 * b);
+    }
+    return b;
+}
+
+template <bool BYTES>
+__attribute__((target("avx2")))
+static size_t apply3AVX2(const int16_t* key, const uint8_t* in, uint8_t* out, size_t blocks) {
+    __m256i k[9];
+    for (int i = 0; i < 9; i++) k[i] = _mm256_set1_epi16(key[i]);
+
+    size_t b = 0;
+    for (; b + 16 <= blocks; b += 16) {
+        __m128i x[3], y[3];
+        split3(in + 3 * b, x);
+
+        __m256i w[3];
+        for (int j = 0; j < 3; j++) w[j] = _mm256_cvtepu8_epi16(x[j]);
+
+        for (int i = 0; i < 3; i++) {
+            __m256i s = _mm256_mullo_epi16(k[3 * i], w[0]);
+            s = _mm256_add_epi16(s, _mm256_mullo_epi16(k[3 * i + 1], w[1]));
+            s = _mm256_add_epi16(s, _mm256_mullo_epi16(k[3 * i + 2], w[2]));
+            s = reduce_epu16<BYTES>(s);
+            y[i] = _mm_packus_epi16(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+        }
+        merge3(y, out + 3 * b);
+    }
+    return b;
+}
+#endif
+
+/* ---------- DISPATCH ---------- */
+HillKernel::Level HillKernel::detect() {
+#ifdef HILL_KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return AVX2;
+    if (__builtin_cpu_supports("ssse3")) return SSSE3;
+#endif
+    return SCALAR;
+}
+
+const char* HillKernel::levelName(Level level) {
+    switch (level) {
+        case AVX2:  return "avx2";
+        case SSSE3: return "ssse3";
+        default:    return "scalar";
+    }
+}
+
+HillKernel::HillKernel(const vector<vector<int>>& matrix, Level level, int modulus)
+    : n(matrix.size()), mod(modulus), active(SCALAR) {
+    if (n == 0) {
+        throw runtime_error("Key matrix is empty");
+    }
+    if (mod != 26 && mod != 256) {
+        throw runtime_error("Kernel modulus must be 26 or 256");
+    }
+    key.resize(n * n);
+    for (int i = 0; i < n; i++) {
+        if ((int)matrix[i].size() != n) {
+            throw runtime_error("Key matrix must be square");
+        }
+        for (int j = 0; j < n; j++) {
+            key[i * n + j] = int16_t(((matrix[i][j] % mod) + mod) % mod);
+        }
+    }
+
+    // Never run a level the CPU does not have, whatever the caller asked for
+    Level supported = detect();
+    if (level > supported) level = supported;
+    if (n == 2 || n == 3) active = level;
+}
+
+template <bool BYTES>
+static void applyLevel(HillKernel::Level level, const int16_t* key, int n,
+                       const uint8_t* in, uint8_t* out, size_t blocks) {
+    size_t done = 0;
+#ifdef HILL_KERNEL_X86
+    if (level == HillKernel::AVX2) {
+        done = (n == 2) ? apply2AVX2<BYTES>(key, in, out, blocks)
+                        : apply3AVX2<BYTES>(key, in, out, blocks);
+    } else if (level == HillKernel::SSSE3) {
+        done = (n == 2) ? apply2SSSE3<BYTES>(key, in, out, blocks)
+                        : apply3SSSE3<BYTES>(key, in, out, blocks);
+    }
+#else
+    (void)level;
+#endif
+    // Tail blocks (and every block on the scalar level)
+    applyScalar<BYTES>(key, n, in + done * n, out + done * n, blocks - done);
+}
+
+void HillKernel::apply(const uint8_t* in, uint8_t* out, size_t blocks) const {
+    if (mod == 256) {
+        applyLevel<true>(active, key.data(), n, in, out, blocks);
+    } else {
+        applyLevel<false>(active, key.data(), n, in, out, blocks);
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef HILL_KERNEL_H
+#define HILL_KERNEL_H
+
+#include "hill_backend.h"
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Batched Hill block kernel. Letters are stored one per byte as indices
+// 0..25; apply() transforms many n-letter blocks at once (out may equal in).
+// 2x2 and 3x3 keys run in 16-bit SIMD lanes (AVX2 or SSSE3, picked at run
+// time); other sizes and older CPUs use the scalar loop. Reduction mod 26 is
+// a multiply-high (Barrett) step, not a division.
+//
+// With modulus 256 the symbols are whole bytes 0..255 (see hill_bytes.h).
+// Sums then simply wrap: the low byte of a 16- or 32-bit sum is already the
+// result, so there is no reduction step at all.
+class HillKernel : public HillBackend {
+public:
+    enum Level { SCALAR = 0, SSSE3 = 1, AVX2 = 2 };
+
+    // modulus is 26 (letters) or 256 (bytes); anything else throws
+    explicit HillKernel(const std::vector<std::vector<int>>& key, Level level = detect(),
+                        int modulus = 26);
+
+    // Transform `blocks` blocks of size() letters from in to out
+    void apply(const uint8_t* in, uint8_t* out, size_t blocks) const override;
+
+    int size() const override { return n; }
+    const char* name() const override { return levelName(active); }
+    Level level() const { return active; }
+    int modulus() const { return mod; }
+
+    // Best level supported by this CPU
+    static Level detect();
+    static const char* levelName(Level level);
+
+private:
+    int n;
+    int mod;
+    Level active;
+    std::vector<int16_t> key;   // row-major n*n, entries 0..mod-1
+};
+
+#endif
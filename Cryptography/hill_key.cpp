@@ -0,0 +1,154 @@
+#include "hill_key.h"
+#include "matrix_utils.h"
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+/* ---------- KEY ---------- */
+HillKey::HillKey(const vector<vector<int>>& matrix, BackendType backend)
+    : n(matrix.size()), key(matrix) {
+    if (n == 0) {
+        throw runtime_error("Key matrix is empty");
+    }
+    for (auto& row : key) {
+        if ((int)row.size() != n) {
+            throw runtime_error("Key matrix must be square");
+        }
+        for (int& x : row) {
+            x = ((x % 26) + 26) % 26;
+        }
+    }
+
+    // inverseMatrix throws if the determinant shares a factor with 26
+    inverseKey = MatrixUtils::inverseMatrix(key);
+    for (int i = 0; i < n; i++) {
+        flatKey.insert(flatKey.end(), key[i].begin(), key[i].end());
+        flatInverse.insert(flatInverse.end(), inverseKey[i].begin(), inverseKey[i].end());
+    }
+    forward = createBackend(key, backend);
+    backward = createBackend(inverseKey, backend);
+    print = fingerprint(key);
+}
+
+HillKey::HillKey(const vector<vector<int>>& matrix, const vector<vector<int>>& inverse,
+                 unique_ptr<HillBackend> forward, unique_ptr<HillBackend> backward)
+    : n(matrix.size()), key(matrix), inverseKey(inverse),
+      forward(move(forward)), backward(move(backward)) {
+    for (int i = 0; i < n; i++) {
+        flatKey.insert(flatKey.end(), key[i].begin(), key[i].end());
+        flatInverse.insert(flatInverse.end(), inverseKey[i].begin(), inverseKey[i].end());
+    }
+    print = fingerprint(key);
+}
+
+uint64_t HillKey::fingerprint(const vector<vector<int>>& matrix) {
+    uint64_t h = 14695981039346656037ull;
+    auto mix = [&](uint64_t v) {
+        h ^= v;
+        h *= 1099511628211ull;
+    };
+    mix(matrix.size());
+    for (auto& row : matrix) {
+        for (int x : row) {
+            mix(uint64_t(((x % 26) + 26) % 26));
+        }
+    }
+    return h;
+}
+
+vector<vector<int>> HillKey::parse(const string& text) {
+    vector<vector<int>> matrix;
+    string row_text;
+    istringstream rows(text);
+    while (getline(rows, row_text, ';')) {
+        istringstream lines(row_text);
+        string line;
+        while (getline(lines, line)) {
+            for (char& c : line) {
+                if (c == ',') c = ' ';
+            }
+            istringstream cells(line);
+            vector<int> row;
+            int x;
+            while (cells >> x) {
+                row.push_back(x);
+            }
+            if (!cells.eof()) {
+                throw runtime_error("Invalid key entry in '" + line + "'");
+            }
+            if (!row.empty()) matrix.push_back(row);
+        }
+    }
+    if (matrix.empty()) {
+        throw runtime_error("Key matrix is empty");
+    }
+    return matrix;
+}
+
+/* ---------- CACHE ---------- */
+HillKeyCache::HillKeyCache(size_t capacity, BackendType backend)
+    : limit(capacity == 0 ? 1 : capacity), backend(backend),
+      hitCount(0), missCount(0), evictionCount(0) {
+}
+
+static bool sameMatrix(const vector<vector<int>>& reduced, const vector<vector<int>>& matrix) {
+    if (reduced.size() != matrix.size()) return false;
+    for (size_t i = 0; i < matrix.size(); i++) {
+        if (reduced[i].size() != matrix[i].size()) return false;
+        for (size_t j = 0; j < matrix[i].size(); j++) {
+            if (reduced[i][j] != ((matrix[i][j] % 26) + 26) % 26) return false;
+        }
+    }
+    return true;
+}
+
+shared_ptr<const HillKey> HillKeyCache::get(const vector<vector<int>>& matrix) {
+    uint64_t print = HillKey::fingerprint(matrix);
+    {
+        lock_guard<mutex> guard(lock);
+        auto it = index.find(print);
+        if (it != index.end() && sameMatrix((*it->second)->matrix(), matrix)) {
+            order.splice(order.begin(), order, it->second);
+            hitCount++;
+            return order.front();
+        }
+    }
+
+    // Build outside the lock; validation and table setup are the slow part
+    missCount++;
+    shared_ptr<const HillKey> built = make_shared<HillKey>(matrix, backend);
+
+    lock_guard<mutex> guard(lock);
+    auto it = index.find(print);
+    if (it != index.end()) {
+        if (sameMatrix((*it->second)->matrix(), matrix)) {
+            // Another thread built the same key meanwhile; keep theirs
+            order.splice(order.begin(), order, it->second);
+            return order.front();
+        }
+        // Fingerprint collision: the newer key takes the slot
+        order.erase(it->second);
+        index.erase(it);
+    }
+
+    order.push_front(built);
+    index[print] = order.begin();
+    while (order.size() > limit) {
+        index.erase(order.back()->fingerprint());
+        order.pop_back();
+        evictionCount++;
+    }
+    return built;
+}
+
+void HillKeyCache::clear() {
+    lock_guard<mutex> guard(lock);
+    order.clear();
+    index.clear();
+}
+
+size_t HillKeyCache::size() const {
+    lock_guard<mutex> guard(lock);
+    return order.size();
+}
@@ -0,0 +1,92 @@
+#ifndef HILL_KEY_H
+#define HILL_KEY_H
+
+#include "hill_backend.h"
+#include <vector>
+#include <string>
+#include <memory>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// A validated Hill key. Invertibility is checked once at construction, and
+// the inverse plus a ready backend for each direction are stored with the
+// key, so using it costs nothing beyond the block transform itself.
+class HillKey {
+public:
+    // Throws if the matrix is not square or not invertible modulo 26
+    explicit HillKey(const std::vector<std::vector<int>>& matrix,
+                     BackendType backend = BACKEND_AUTO);
+
+    // Key and inverse already reduced and checked (HillCipher works both out
+    // at compile time); the backends are used as given
+    HillKey(const std::vector<std::vector<int>>& matrix, const std::vector<std::vector<int>>& inverse,
+            std::unique_ptr<HillBackend> forward, std::unique_ptr<HillBackend> backward);
+
+    int size() const { return n; }
+    const std::vector<std::vector<int>>& matrix() const { return key; }
+    const std::vector<std::vector<int>>& inverse() const { return inverseKey; }
+
+    // The same matrices as contiguous row-major n*n arrays
+    const int* entries() const { return flatKey.data(); }
+    const int* inverseEntries() const { return flatInverse.data(); }
+
+    // Backends for K (encrypt) and K^-1 (decrypt)
+    const HillBackend& encryptor() const { return *forward; }
+    const HillBackend& decryptor() const { return *backward; }
+
+    uint64_t fingerprint() const { return print; }
+
+    // FNV-1a over the size and the entries reduced mod 26
+    static uint64_t fingerprint(const std::vector<std::vector<int>>& matrix);
+
+    // Parse "6 24 1; 13 16 10; 20 17 15" (rows split by ';' or newlines,
+    // entries by spaces or commas)
+    static std::vector<std::vector<int>> parse(const std::string& text);
+
+private:
+    int n;
+    std::vector<std::vector<int>> key;
+    std::vector<std::vector<int>> inverseKey;
+    std::vector<int> flatKey;
+    std::vector<int> flatInverse;
+    std::unique_ptr<HillBackend> forward;
+    std::unique_ptr<HillBackend> backward;
+    uint64_t print;
+};
+
+// Thread-safe bounded LRU cache of HillKey objects, keyed by fingerprint.
+// Hot keys skip validation, inversion and table setup entirely; a miss
+// builds the key outside the lock so other tenants are not blocked.
+class HillKeyCache {
+public:
+    explicit HillKeyCache(size_t capacity = 64, BackendType backend = BACKEND_AUTO);
+
+    // Cached key for this matrix, building (and possibly evicting) on a miss
+    std::shared_ptr<const HillKey> get(const std::vector<std::vector<int>>& matrix);
+
+    void clear();
+
+    size_t size() const;
+    size_t capacity() const { return limit; }
+    uint64_t hits() const { return hitCount; }
+    uint64_t misses() const { return missCount; }
+    uint64_t evictions() const { return evictionCount; }
+
+private:
+    typedef std::list<std::shared_ptr<const HillKey>> LruList;
+
+    size_t limit;
+    BackendType backend;
+    mutable std::mutex lock;
+    LruList order;                                        // most recent first
+    std::unordered_map<uint64_t, LruList::iterator> index;
+    std::atomic<uint64_t> hitCount;
+    std::atomic<uint64_t> missCount;
+    std::atomic<uint64_t> evictionCount;
+};
+
+#endif
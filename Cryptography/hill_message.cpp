@@ -0,0 +1,114 @@
+#include "hill_message.h"
+#include "hill_metrics.h"
+#include "hill_normalize.h"
+#include <stdexcept>
+
+using namespace std;
+
+/* ---------- HELPERS ---------- */
+// Run fn(first, count) over block ranges, on the pool when there is one.
+// The lambda handed to the pool captures a single pointer, so std::function
+// keeps it inline instead of allocating.
+template <class Fn>
+static void forBlocks(ThreadPool* pool, size_t blocks, const Fn& fn) {
+    if (!pool) {
+        if (blocks > 0) fn(0, blocks);
+        return;
+    }
+    const Fn* body = &fn;
+    pool->forRanges(blocks, PARALLEL_GRAIN_BLOCKS, [body](size_t first, size_t count) {
+        (*body)(first, count);
+    });
+}
+
+/* ---------- POINTER API ---------- */
+MessageCounts countMessage(const char* msg, size_t len) {
+    TextScan scan = countText(msg, len);
+    MessageCounts counts = {scan.letters, scan.spaces};
+    return counts;
+}
+
+size_t encryptMessage(const HillKey& key, const char* msg, size_t len, char* out,
+                      uint64_t* spacePositions, ThreadPool* pool,
+                      const HillCounter* counter, uint64_t firstBlock) {
+    int n = key.size();
+    bool timed = len >= METRICS_TIMED_BYTES;
+
+    // Letters as indices 0..25, staged in the output buffer itself
+    HILL_STAGE_IF(normalize, STAGE_NORMALIZE, len, timed);
+    uint8_t* letters = reinterpret_cast<uint8_t*>(out);
+    size_t count = scanText(msg, len, letters, spacePositions).letters;
+    HILL_STAGE_END(normalize);
+
+    // Pad if needed
+    HILL_STAGE_IF(padding, STAGE_PAD, (n - count % n) % n, timed);
+    while (count % n != 0) {
+        letters[count++] = 'X' - 'A';
+    }
+    HILL_STAGE_END(padding);
+
+    // Each range transforms and converts only its own slice
+    const HillBackend& backend = key.encryptor();
+    forBlocks(pool, count / n, [&](size_t first, size_t blocks) {
+        HILL_STAGE_IF(multiply, STAGE_MULTIPLY, blocks * n, timed);
+        HILL_STAGE_BLOCKS(multiply, blocks);
+        uint8_t* slice = letters + first * n;
+        backend.apply(slice, slice, blocks);
+        if (counter) counter->add(slice, slice, firstBlock + first, blocks);
+        for (size_t i = 0; i < blocks * n; i++) {
+            slice[i] += 'A';
+        }
+    });
+    return count;
+}
+
+size_t decryptMessage(const HillKey& key, const char* enc, size_t len, char* out, ThreadPool* pool,
+                      const HillCounter* counter, uint64_t firstBlock) {
+    int n = key.size();
+    if (len % n != 0) {
+        throw runtime_error("Encrypted text length is not a multiple of the block size");
+    }
+
+    const HillBackend& backend = key.decryptor();
+    uint8_t* letters = reinterpret_cast<uint8_t*>(out);
+    bool timed = len >= METRICS_TIMED_BYTES;
+    forBlocks(pool, len / n, [&](size_t first, size_t blocks) {
+        size_t begin = first * n, end = (first + blocks) * n;
+        HILL_STAGE_IF(normalize, STAGE_NORMALIZE, end - begin, timed);
+        // Letters only, so the packed letters land exactly at [begin, end)
+        if (scanText(enc + begin, end - begin, letters + begin).letters != end - begin) {
+            throw runtime_error("Invalid character in encrypted text. Only letters allowed.");
+        }
+        HILL_STAGE_END(normalize);
+
+        HILL_STAGE_IF(multiply, STAGE_MULTIPLY, end - begin, timed);
+        HILL_STAGE_BLOCKS(multiply, blocks);
+        if (counter) counter->subtract(letters + begin, letters + begin, firstBlock + first, blocks);
+        backend.apply(letters + begin, letters + begin, blocks);
+        for (size_t i = begin; i < end; i++) {
+            letters[i] += 'A';
+        }
+    });
+
+    // Remove padding
+    size_t length = len;
+    while (length > 0 && out[length - 1] == 'X') {
+        length--;
+    }
+    return length;
+}
+
+/* ---------- STRING API ---------- */
+pair<string, vector<int>> encryptWithSpaces(const string& msg, const HillKey& key, ThreadPool& pool) {
+    MessageCounts counts = countMessage(msg.data(), msg.size());
+    string encrypted(encryptedLength(counts.letters, key.size()), 'A');
+    vector<uint64_t> spaces(counts.spaces);
+    encryptMessage(key, msg.data(), msg.size(), &encrypted[0], spaces.data(), &pool);
+    return {encrypted, vector<int>(spaces.begin(), spaces.end())};
+}
+
+string decryptLetters(const string& enc, const HillKey& key, ThreadPool& pool) {
+    string decrypted(enc.size(), 'A');
+    decrypted.resize(decryptMessage(key, enc.data(), enc.size(), &decrypted[0], &pool));
+    return decrypted;
+}
@@ -0,0 +1,57 @@
+#ifndef HILL_MESSAGE_H
+#define HILL_MESSAGE_H
+
+#include "hill_key.h"
+#include "hill_parallel.h"
+#include "hill_counter.h"
+#include <vector>
+#include <string>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+// Whole-message encryption and decryption as done by the two programs:
+// spaces are recorded and dropped, other non-letters ignored, letters
+// upper-cased and the last block padded with 'X'.
+//
+// The pointer functions write into buffers the caller owns and never touch
+// the heap (with a pool, work is split without allocating either), so they
+// can sit on a latency-sensitive path. The string/vector functions are
+// conveniences built on top of them.
+
+// Letters and spaces in a message, for sizing the buffers below
+struct MessageCounts {
+    size_t letters;
+    size_t spaces;
+};
+MessageCounts countMessage(const char* msg, size_t len);
+
+// Ciphertext length for `letters` letters under an n x n key
+inline size_t encryptedLength(size_t letters, int n) {
+    return (letters + n - 1) / n * n;
+}
+
+// Encrypt msg into out, which needs encryptedLength(letters, n) bytes. When
+// spacePositions is non-null it receives every space position (room for
+// counts.spaces entries). With a counter the offsets start at block index
+// firstBlock. Returns the ciphertext length.
+size_t encryptMessage(const HillKey& key, const char* msg, size_t len, char* out,
+                      uint64_t* spacePositions = nullptr, ThreadPool* pool = nullptr,
+                      const HillCounter* counter = nullptr, uint64_t firstBlock = 0);
+
+// Decrypt len letters (a multiple of the key size) into out, which needs len
+// bytes, and strip the trailing 'X' padding. Throws on non-letters. Returns
+// the plaintext length.
+size_t decryptMessage(const HillKey& key, const char* enc, size_t len, char* out,
+                      ThreadPool* pool = nullptr, const HillCounter* counter = nullptr,
+                      uint64_t firstBlock = 0);
+
+// Returns: encrypted text, and space positions for reconstruction
+std::pair<std::string, std::vector<int>> encryptWithSpaces(const std::string& msg, const HillKey& key,
+                                                           ThreadPool& pool = defaultThreadPool());
+
+// Decrypted letters with the padding stripped
+std::string decryptLetters(const std::string& enc, const HillKey& key,
+                           ThreadPool& pool = defaultThreadPool());
+
+#endif
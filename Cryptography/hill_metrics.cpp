@@ -0,0 +1,282 @@
+#include "hill_metrics.h"
+#include <sstream>
+#include <iomanip>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef HILL_METRICS
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <cstdlib>
+#include <new>
+#endif
+
+using namespace std;
+
+const char* stageName(MetricStage stage) {
+    static const char* const NAMES[STAGE_COUNT] = {
+        "read", "normalize", "pad", "multiply", "layout", "write"
+    };
+    return stage < STAGE_COUNT ? NAMES[stage] : "unknown";
+}
+
+void saveMetrics(const string& path) {
+    bool prometheus = path.size() >= 5 && path.compare(path.size() - 5, 5, ".prom") == 0;
+    ofstream out(path);
+    if (!out) {
+        throw runtime_error("Cannot open " + path + " for writing");
+    }
+    out << (prometheus ? metricsPrometheus() : metricsJson());
+    if (!out) {
+        throw runtime_error("Failed to write " + path);
+    }
+}
+
+#ifdef HILL_METRICS
+/* ---------- SLOTS ---------- */
+struct StageSlot {
+    atomic<uint64_t> nanos;
+    atomic<uint64_t> calls;
+    atomic<uint64_t> bytes;
+    atomic<uint64_t> blocks;
+};
+
+// One per thread, written only by its owner; the padding keeps the next
+// thread's slot off its last cache line
+struct ThreadSlot {
+    unsigned id;
+    StageSlot stages[STAGE_COUNT];
+    atomic<uint64_t> allocations;
+    atomic<uint64_t> allocatedBytes;
+    char padding[64];
+};
+
+// Never destroyed: threads may still count while statics are torn down
+static mutex& slotLock() {
+    static mutex* lock = new mutex;
+    return *lock;
+}
+
+static vector<ThreadSlot*>& slots() {
+    static vector<ThreadSlot*>* all = new vector<ThreadSlot*>;
+    return *all;
+}
+
+static thread_local ThreadSlot* mySlot = nullptr;
+static thread_local bool registering = false;
+
+// The calling thread's slot, created on first use. Allocations made while
+// creating it are not counted (operator new comes back here).
+static ThreadSlot* localSlot() {
+    if (mySlot || registering) return mySlot;
+    registering = true;
+    ThreadSlot* slot = new ThreadSlot();
+    {
+        lock_guard<mutex> guard(slotLock());
+        slot->id = slots().size();
+        slots().push_back(slot);
+    }
+    mySlot = slot;
+    registering = false;
+    return slot;
+}
+
+// Owner-only update; a relaxed load and store is enough and avoids a locked add
+static inline void bump(atomic<uint64_t>& counter, uint64_t amount) {
+    counter.store(counter.load(memory_order_relaxed) + amount, memory_order_relaxed);
+}
+
+static int64_t nowNanos() {
+    return chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* ---------- TIMER ---------- */
+StageTimer::StageTimer(MetricStage stage, uint64_t bytes, bool timed) : stage(stage), start(-1) {
+    ThreadSlot* slot = localSlot();
+    if (!slot) return;
+    bump(slot->stages[stage].calls, 1);
+    bump(slot->stages[stage].bytes, bytes);
+    if (timed) start = nowNanos();
+}
+
+void StageTimer::addBytes(uint64_t bytes) {
+    if (mySlot) bump(mySlot->stages[stage].bytes, bytes);
+}
+
+void StageTimer::addBlocks(uint64_t blocks) {
+    if (mySlot) bump(mySlot->stages[stage].blocks, blocks);
+}
+
+void StageTimer::stop() {
+    if (start < 0 || !mySlot) return;
+    bump(mySlot->stages[stage].nanos, nowNanos() - start);
+    start = -1;
+}
+
+/* ---------- ALLOCATIONS ---------- */
+void* operator new(size_t size) {
+    if (ThreadSlot* slot = localSlot()) {
+        bump(slot->allocations, 1);
+        bump(slot->allocatedBytes, size);
+    }
+    void* p = malloc(size ? size : 1);
+    if (!p) throw bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+// C++14 sized delete, so the pair above is never mixed with the library's
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+uint64_t metricsAllocations() {
+    lock_guard<mutex> guard(slotLock());
+    uint64_t total = 0;
+    for (ThreadSlot* slot : slots()) {
+        total += slot->allocations.load(memory_order_relaxed);
+    }
+    return total;
+}
+
+void resetMetrics() {
+    lock_guard<mutex> guard(slotLock());
+    for (ThreadSlot* slot : slots()) {
+        for (StageSlot& s : slot->stages) {
+            s.nanos = 0;
+            s.calls = 0;
+            s.bytes = 0;
+            s.blocks = 0;
+        }
+        slot->allocations = 0;
+        slot->allocatedBytes = 0;
+    }
+}
+
+/* ---------- EXPORT ---------- */
+struct StageTotals {
+    uint64_t nanos, calls, bytes, blocks;
+};
+
+static StageTotals totals(const ThreadSlot& slot, int stage) {
+    const StageSlot& s = slot.stages[stage];
+    return {s.nanos.load(memory_order_relaxed), s.calls.load(memory_order_relaxed),
+            s.bytes.load(memory_order_relaxed), s.blocks.load(memory_order_relaxed)};
+}
+
+static void jsonStages(ostream& out, const StageTotals* stages) {
+    out << "{";
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        const StageTotals& t = stages[s];
+        double seconds = t.nanos / 1e9;
+        out << (s ? ", " : "") << "\"" << stageName(MetricStage(s)) << "\": {"
+            << "\"seconds\": " << fixed << setprecision(6) << seconds
+            << ", \"calls\": " << t.calls << ", \"bytes\": " << t.bytes << ", \"blocks\": " << t.blocks
+            << ", \"mb_per_s\": " << setprecision(1) << (seconds > 0 ? t.bytes / 1e6 / seconds : 0.0)
+            << "}";
+    }
+    out << "}";
+}
+
+string metricsJson() {
+    lock_guard<mutex> guard(slotLock());
+    // Snapshot first so the export's own allocations are not half counted
+    struct Snapshot {
+        unsigned id;
+        uint64_t allocations, allocated;
+        StageTotals stages[STAGE_COUNT];
+    };
+    vector<Snapshot> threads(slots().size());
+    StageTotals all[STAGE_COUNT] = {};
+    uint64_t allocations = 0, allocated = 0;
+    for (size_t i = 0; i < threads.size(); i++) {
+        const ThreadSlot& slot = *slots()[i];
+        Snapshot& mine = threads[i];
+        mine.id = slot.id;
+        mine.allocations = slot.allocations.load(memory_order_relaxed);
+        mine.allocated = slot.allocatedBytes.load(memory_order_relaxed);
+        allocations += mine.allocations;
+        allocated += mine.allocated;
+        for (int s = 0; s < STAGE_COUNT; s++) {
+            StageTotals t = totals(slot, s);
+            mine.stages[s] = t;
+            all[s].nanos += t.nanos;
+            all[s].calls += t.calls;
+            all[s].bytes += t.bytes;
+            all[s].blocks += t.blocks;
+        }
+    }
+
+    ostringstream out;
+    out << "{\n  \"enabled\": true,\n  \"stages\": ";
+    jsonStages(out, all);
+    out << ",\n  \"allocations\": " << allocations << ",\n  \"allocated_bytes\": " << allocated
+        << ",\n  \"threads\": [";
+    for (size_t i = 0; i < threads.size(); i++) {
+        out << (i ? "," : "") << "\n    {\"thread\": " << threads[i].id << ", \"allocations\": "
+            << threads[i].allocations << ", \"stages\": ";
+        jsonStages(out, threads[i].stages);
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+    return out.str();
+}
+
+string metricsPrometheus() {
+    lock_guard<mutex> guard(slotLock());
+    ostringstream out;
+    struct Family {
+        const char* name;
+        const char* help;
+    };
+    const Family families[] = {
+        {"hill_stage_seconds_total", "Time spent in each stage"},
+        {"hill_stage_calls_total", "Times each stage ran"},
+        {"hill_stage_bytes_total", "Bytes each stage handled"},
+        {"hill_stage_blocks_total", "Cipher blocks each stage handled"},
+    };
+    for (int f = 0; f < 4; f++) {
+        out << "# HELP " << families[f].name << " " << families[f].help << "\n"
+            << "# TYPE " << families[f].name << " counter\n";
+        for (ThreadSlot* slot : slots()) {
+            for (int s = 0; s < STAGE_COUNT; s++) {
+                StageTotals t = totals(*slot, s);
+                out << families[f].name << "{stage=\"" << stageName(MetricStage(s))
+                    << "\",thread=\"" << slot->id << "\"} ";
+                if (f == 0) out << fixed << setprecision(9) << t.nanos / 1e9;
+                else out << (f == 1 ? t.calls : f == 2 ? t.bytes : t.blocks);
+                out << "\n";
+            }
+        }
+    }
+    out << "# HELP hill_allocations_total Heap allocations (operator new)\n"
+        << "# TYPE hill_allocations_total counter\n";
+    for (ThreadSlot* slot : slots()) {
+        out << "hill_allocations_total{thread=\"" << slot->id << "\"} "
+            << slot->allocations.load(memory_order_relaxed) << "\n";
+    }
+    return out.str();
+}
+#else
+/* ---------- DISABLED ---------- */
+string metricsJson() {
+    return "{\n  \"enabled\": false\n}\n";
+}
+
+string metricsPrometheus() {
+    return "# hill metrics disabled (build with -DHILL_METRICS)\n";
+}
+
+void resetMetrics() {
+}
+
+uint64_t metricsAllocations() {
+    return 0;
+}
+#endif
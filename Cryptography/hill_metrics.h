@@ -0,0 +1,80 @@
+#ifndef HILL_METRICS_H
+#define HILL_METRICS_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Hot-path instrumentation, compiled in only with -DHILL_METRICS. Without
+// it the HILL_STAGE macros expand to nothing and the exports report that
+// metrics are off, so release builds pay nothing.
+//
+// Each thread counts into its own slot (plain relaxed stores, no shared
+// cache lines), and the exports add the slots up. Stages are timed per
+// chunk or per message, never per block; messages under
+// METRICS_TIMED_BYTES are counted but not timed, since reading the clock
+// would cost more than the work.
+enum MetricStage {
+    STAGE_READ,         // input I/O
+    STAGE_NORMALIZE,    // letters to indices, case folding, validation
+    STAGE_PAD,          // 'X' padding
+    STAGE_MULTIPLY,     // block transform (and conversion back to letters)
+    STAGE_LAYOUT,       // space map writing, reading and re-insertion
+    STAGE_WRITE,        // output I/O
+    STAGE_COUNT
+};
+
+const size_t METRICS_TIMED_BYTES = 4096;
+
+const char* stageName(MetricStage stage);
+
+// Everything recorded since start (or the last reset), as a JSON object or
+// Prometheus text exposition, with totals and per-thread breakdowns
+std::string metricsJson();
+std::string metricsPrometheus();
+void resetMetrics();
+
+// Write the Prometheus text if path ends in ".prom", JSON otherwise
+void saveMetrics(const std::string& path);
+
+// Process-wide operator new calls (0 without HILL_METRICS)
+uint64_t metricsAllocations();
+
+#ifdef HILL_METRICS
+const bool METRICS_ENABLED = true;
+
+// Times one stage on the current thread from construction to stop() or
+// destruction, and adds bytes and blocks to it
+class StageTimer {
+public:
+    StageTimer(MetricStage stage, uint64_t bytes, bool timed = true);
+    ~StageTimer() { stop(); }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+    void addBytes(uint64_t bytes);
+    void addBlocks(uint64_t blocks);
+    void stop();
+
+private:
+    MetricStage stage;
+    int64_t start;      // steady clock nanoseconds, or -1 once stopped / untimed
+};
+
+#define HILL_STAGE(timer, stage, bytes) StageTimer timer(stage, bytes)
+#define HILL_STAGE_IF(timer, stage, bytes, timed) StageTimer timer(stage, bytes, timed)
+#define HILL_STAGE_BYTES(timer, bytes) timer.addBytes(bytes)
+#define HILL_STAGE_BLOCKS(timer, blocks) timer.addBlocks(blocks)
+#define HILL_STAGE_END(timer) timer.stop()
+#else
+const bool METRICS_ENABLED = false;
+
+#define HILL_STAGE(timer, stage, bytes) ((void)0)
+#define HILL_STAGE_IF(timer, stage, bytes, timed) ((void)(timed))
+#define HILL_STAGE_BYTES(timer, bytes) ((void)0)
+#define HILL_STAGE_BLOCKS(timer, blocks) ((void)0)
+#define HILL_STAGE_END(timer) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,136 @@
+#include "hill_normalize.h"
+#include "hill_kernel.h"
+#include <algorithm>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HILL_NORMALIZE_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Input bytes per batch. Letters are packed into a stack buffer first (the
+// SIMD stores run up to 16 bytes ahead) and copied out exactly.
+static const size_t BATCH_BYTES = 4096;
+
+/* ---------- SCALAR ---------- */
+static void scanScalar(const char* text, size_t len, size_t offset, uint8_t* letters,
+                       uint64_t* spaces, uint64_t base, TextScan& scan) {
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = text[i];
+        uint8_t v = letterIndex(c);
+        if (v != NOT_A_LETTER) {
+            if (letters) letters[scan.letters] = v;
+            scan.letters++;
+        } else if (c == ' ') {
+            if (spaces) spaces[scan.spaces] = base + offset + i;
+            scan.spaces++;
+        } else if (scan.invalid == size_t(-1)) {
+            scan.invalid = offset + i;
+        }
+    }
+}
+
+#ifdef HILL_NORMALIZE_X86
+/* ---------- SIMD ---------- */
+// For every 8-bit letter mask: the shuffle that packs those bytes to the
+// front (0x80 zeroes the rest) and how many there are
+struct CompactTable {
+    uint8_t shuffle[256][8];
+    uint8_t count[256];
+
+    CompactTable() {
+        for (int m = 0; m < 256; m++) {
+            int k = 0;
+            for (int b = 0; b < 8; b++) {
+                if (m & (1 << b)) shuffle[m][k++] = uint8_t(b);
+            }
+            count[m] = uint8_t(k);
+            for (; k < 8; k++) shuffle[m][k] = 0x80;
+        }
+    }
+};
+
+static const CompactTable COMPACT;
+
+// Whole 16-byte groups; returns the bytes handled. letters (when non-null)
+// needs 16 bytes of room past the last letter.
+__attribute__((target("ssse3")))
+static size_t scanSSSE3(const char* text, size_t len, size_t offset, uint8_t* letters,
+                        uint64_t* spaces, uint64_t base, TextScan& scan) {
+    const __m128i fold = _mm_set1_epi8(char(0xDF));
+    const __m128i a = _mm_set1_epi8('A');
+    const __m128i z = _mm_set1_epi8(25);
+    const __m128i blank = _mm_set1_epi8(' ');
+    // The high half's shuffle indices point 8 bytes further in
+    const uint64_t high = 0x0808080808080808ull;
+
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        __m128i t = _mm_sub_epi8(_mm_and_si128(v, fold), a);
+        unsigned m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(t, z), t));
+        unsigned s = _mm_movemask_epi8(_mm_cmpeq_epi8(v, blank));
+
+        unsigned other = ~(m | s) & 0xFFFF;
+        if (other && scan.invalid == size_t(-1)) {
+            scan.invalid = offset + i + __builtin_ctz(other);
+        }
+
+        unsigned lo = m & 0xFF, hi = m >> 8;
+        if (letters) {
+            uint64_t shufLo, shufHi;
+            memcpy(&shufLo, COMPACT.shuffle[lo], 8);
+            memcpy(&shufHi, COMPACT.shuffle[hi], 8);
+            __m128i packed = _mm_shuffle_epi8(t, _mm_set_epi64x(shufHi + high, shufLo));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(letters + scan.letters), packed);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(letters + scan.letters + COMPACT.count[lo]),
+                             _mm_srli_si128(packed, 8));
+        }
+        scan.letters += COMPACT.count[lo] + COMPACT.count[hi];
+
+        if (spaces) {
+            for (; s; s &= s - 1) {
+                spaces[scan.spaces++] = base + offset + i + __builtin_ctz(s);
+            }
+        } else {
+            scan.spaces += COMPACT.count[s & 0xFF] + COMPACT.count[s >> 8];
+        }
+    }
+    return i;
+}
+#endif
+
+/* ---------- DISPATCH ---------- */
+static bool useSSSE3() {
+    static const bool supported = HillKernel::detect() >= HillKernel::SSSE3;
+    return supported;
+}
+
+TextScan scanText(const char* text, size_t len, uint8_t* letters, uint64_t* spaces, uint64_t base) {
+    TextScan scan = {0, 0, size_t(-1)};
+#ifdef HILL_NORMALIZE_X86
+    if (useSSSE3()) {
+        uint8_t staging[BATCH_BYTES + 16];
+        for (size_t off = 0; off < len; off += BATCH_BYTES) {
+            size_t count = min(BATCH_BYTES, len - off);
+            size_t before = scan.letters;
+            // Pack relative to the batch, then copy exactly what was found
+            TextScan batch = {0, scan.spaces, scan.invalid};
+            uint8_t* dst = letters ? staging : nullptr;
+            size_t done = scanSSSE3(text + off, count, off, dst, spaces, base, batch);
+            scanScalar(text + off + done, count - done, off + done, dst, spaces, base, batch);
+            if (letters) memcpy(letters + before, staging, batch.letters);
+            scan.letters = before + batch.letters;
+            scan.spaces = batch.spaces;
+            scan.invalid = batch.invalid;
+        }
+        if (scan.invalid == size_t(-1)) scan.invalid = len;
+        return scan;
+    }
+#endif
+    scanScalar(text, len, 0, letters, spaces, base, scan);
+    if (scan.invalid == size_t(-1)) scan.invalid = len;
+    return scan;
+}
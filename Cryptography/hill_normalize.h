@@ -0,0 +1,41 @@
+#ifndef HILL_NORMALIZE_H
+#define HILL_NORMALIZE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Input normalization in one pass: every byte is classified as a letter
+// (A-Z, a-z), a space or anything else; letters are upper-cased, mapped to
+// 0..25 and packed in order into the cipher input buffer, and letters and
+// spaces are counted. 16 bytes are classified at a time with SSSE3 and the
+// letters compacted with one shuffle per 8 bytes; the scalar loop covers
+// the tail and older CPUs. Classification is plain ASCII, never the locale.
+
+// Outcome of a scan
+struct TextScan {
+    size_t letters;     // letters written (or counted)
+    size_t spaces;      // spaces recorded (or counted)
+    size_t invalid;     // offset of the first byte that is neither, or len
+};
+
+// Scan text[0, len). letters: room for every letter of the text, or nullptr
+// to only count. spaces: room for every space, receiving each offset plus
+// `base`, or nullptr. Strict callers reject the input when invalid < len.
+TextScan scanText(const char* text, size_t len, uint8_t* letters,
+                  uint64_t* spaces = nullptr, uint64_t base = 0);
+
+// Counting only
+inline TextScan countText(const char* text, size_t len) {
+    return scanText(text, len, nullptr);
+}
+
+// 0..25 for A-Z and a-z, NOT_A_LETTER for every other byte. Clearing 0x20
+// folds lower case onto upper case and moves no other byte into A..Z.
+const uint8_t NOT_A_LETTER = 0xFF;
+
+inline uint8_t letterIndex(unsigned char c) {
+    uint8_t u = uint8_t((c & 0xDF) - 'A');
+    return u < 26 ? u : NOT_A_LETTER;
+}
+
+#endif
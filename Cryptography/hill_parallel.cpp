@@ -0,0 +1,239 @@
+#include "hill_parallel.h"
+#include "hill_metrics.h"
+#include <algorithm>
+
+using namespace std;
+
+ThreadPool::ThreadPool(unsigned threads)
+    : task(nullptr), taskCount(0), next(0), active(0), generation(0), stopping(false) {
+    if (threads == 0) {
+        threads = max(1u, thread::hardware_concurrency());
+    }
+    for (unsigned i = 1; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (thread& t : workers) {
+        t.join();
+    }
+}
+
+// Claim task indices until none are left
+void ThreadPool::drain() {
+    size_t i;
+    while ((i = next.fetch_add(1)) < taskCount) {
+        try {
+            (*task)(i);
+        } catch (...) {
+            lock_guard<mutex> guard(lock);
+            if (!error) error = current_exception();
+        }
+    }
+}
+
+void ThreadPool::workerLoop() {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            unique_lock<mutex> guard(lock);
+            wake.wait(guard, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+        drain();
+        {
+            lock_guard<mutex> guard(lock);
+            if (--active == 0) finished.notify_one();
+        }
+    }
+}
+
+void ThreadPool::run(size_t count, const function<void(size_t)>& fn) {
+    if (count == 0) return;
+    if (workers.empty() || count == 1) {
+        for (size_t i = 0; i < count; i++) fn(i);
+        return;
+    }
+
+    {
+        lock_guard<mutex> guard(lock);
+        task = &fn;
+        taskCount = count;
+        next = 0;
+        active = workers.size();
+        error = nullptr;
+        generation++;
+    }
+    wake.notify_all();
+    drain();
+
+    unique_lock<mutex> guard(lock);
+    finished.wait(guard, [&] { return active == 0; });
+    task = nullptr;
+    if (error) {
+        exception_ptr e = error;
+        error = nullptr;
+        rethrow_exception(e);
+    }
+}
+
+void ThreadPool::forRanges(size_t total, size_t grain, const function<void(size_t, size_t)>& fn) {
+    if (grain == 0) grain = 1;
+    size_t ranges = min<size_t>(size_t(size()) * 4, total / grain);
+    if (ranges <= 1 || workers.empty()) {
+        if (total > 0) fn(0, total);
+        return;
+    }
+
+    // Capture one pointer so std::function stores the closure inline and a
+    // job costs no allocation
+    struct Split {
+        size_t per, total;
+        const function<void(size_t, size_t)>* fn;
+    } split = {(total + ranges - 1) / ranges, total, &fn};
+    const Split* s = &split;
+    run(ranges, [s](size_t r) {
+        size_t first = r * s->per;
+        if (first < s->total) (*s->fn)(first, min(s->per, s->total - first));
+    });
+}
+
+/* ---------- WORK STEALING ---------- */
+// The pool and deque index of the thread running a task, for spawn()
+static thread_local WorkStealingPool* currentPool = nullptr;
+static thread_local unsigned currentQueue = 0;
+
+WorkStealingPool::WorkStealingPool(unsigned threads) : pending(0), stealCount(0), spawned(0) {
+    if (threads == 0) {
+        threads = max(1u, thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i < threads; i++) {
+        queues.emplace_back(new Queue);
+    }
+}
+
+void WorkStealingPool::run(vector<Task> tasks) {
+    stealCount = 0;
+    error = nullptr;
+    pending = tasks.size();
+    for (size_t i = 0; i < tasks.size(); i++) {
+        queues[i % queues.size()]->tasks.push_back(move(tasks[i]));
+    }
+
+    vector<thread> threads;
+    for (unsigned i = 1; i < queues.size(); i++) {
+        threads.emplace_back(&WorkStealingPool::work, this, i);
+    }
+    work(0);
+    for (thread& t : threads) {
+        t.join();
+    }
+
+    if (error) {
+        exception_ptr e = error;
+        error = nullptr;
+        rethrow_exception(e);
+    }
+}
+
+void WorkStealingPool::spawn(Task task) {
+    unsigned self = currentPool == this ? currentQueue : 0;
+    pending++;
+    {
+        lock_guard<mutex> guard(queues[self]->lock);
+        queues[self]->tasks.push_back(move(task));
+    }
+    {
+        lock_guard<mutex> guard(idleLock);
+        spawned++;
+    }
+    idle.notify_one();
+}
+
+// Own deque from the back (most recently spawned, still warm in cache),
+// then the other deques from the front (oldest, usually the largest)
+bool WorkStealingPool::take(unsigned self, Task& task) {
+    {
+        Queue& own = *queues[self];
+        lock_guard<mutex> guard(own.lock);
+        if (!own.tasks.empty()) {
+            task = move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues.size(); i++) {
+        Queue& victim = *queues[(self + i) % queues.size()];
+        lock_guard<mutex> guard(victim.lock);
+        if (!victim.tasks.empty()) {
+            task = move(victim.tasks.front());
+            victim.tasks.pop_front();
+            stealCount++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::work(unsigned self) {
+    currentPool = this;
+    currentQueue = self;
+    Task task;
+    // A task still running may spawn more, so stay until nothing is pending;
+    // with nothing to take, sleep until a spawn or the end of the run
+    while (pending > 0) {
+        uint64_t seen;
+        {
+            lock_guard<mutex> guard(idleLock);
+            seen = spawned;
+        }
+        if (!take(self, task)) {
+            unique_lock<mutex> guard(idleLock);
+            idle.wait(guard, [&]() { return pending == 0 || spawned != seen; });
+            continue;
+        }
+        try {
+            task();
+        } catch (...) {
+            lock_guard<mutex> guard(errorLock);
+            if (!error) error = current_exception();
+        }
+        task = nullptr;
+        if (--pending == 0) {
+            lock_guard<mutex> guard(idleLock);
+            idle.notify_all();
+        }
+    }
+    currentPool = nullptr;
+}
+
+ThreadPool& defaultThreadPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+// The multiply stage is opened inside each range, so the time and blocks
+// are charged to the thread that did the work
+void parallelApply(const HillBackend& backend, const uint8_t* in, uint8_t* out,
+                   size_t blocks, ThreadPool* pool) {
+    size_t n = backend.size();
+    bool timed = blocks * n >= METRICS_TIMED_BYTES;
+    auto range = [&](size_t first, size_t count) {
+        HILL_STAGE_IF(multiply, STAGE_MULTIPLY, count * n, timed);
+        HILL_STAGE_BLOCKS(multiply, count);
+        backend.apply(in + first * n, out + first * n, count);
+    };
+    if (blocks == 0) return;
+    if (!pool) {
+        range(0, blocks);
+    } else {
+        pool->forRanges(blocks, PARALLEL_GRAIN_BLOCKS, range);
+    }
+}
@@ -0,0 +1,115 @@
+#ifndef HILL_PARALLEL_H
+#define HILL_PARALLEL_H
+
+#include "hill_backend.h"
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <exception>
+#include <cstddef>
+#include <cstdint>
+
+// Fixed-size thread pool. The calling thread takes part in every job, so a
+// pool of size 1 has no workers and runs everything inline.
+class ThreadPool {
+public:
+    // threads = 0 uses std::thread::hardware_concurrency()
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Threads taking part in a job, including the caller
+    unsigned size() const { return workers.size() + 1; }
+
+    // Run task(0) .. task(count - 1) across the pool and wait for all of them.
+    // The first exception thrown by a task is rethrown here.
+    void run(size_t count, const std::function<void(size_t)>& task);
+
+    // Split [0, total) into contiguous ranges of at least `grain` items and
+    // run fn(first, count) on each. Small totals run inline on the caller.
+    void forRanges(size_t total, size_t grain, const std::function<void(size_t, size_t)>& fn);
+
+private:
+    void workerLoop();
+    void drain();
+
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable finished;
+
+    const std::function<void(size_t)>* task;
+    size_t taskCount;
+    std::atomic<size_t> next;
+    size_t active;               // workers still inside the current job
+    uint64_t generation;         // bumped once per job
+    bool stopping;
+    std::exception_ptr error;
+};
+
+// Work-stealing runner for irregular jobs (tasks of very different sizes,
+// or tasks that discover more work). Each thread has its own deque: it takes
+// from the back of its own, and when that is empty steals from the front of
+// another thread's. A thread that finds nothing sleeps until a task is
+// spawned or the run ends. The caller is one of the threads.
+class WorkStealingPool {
+public:
+    typedef std::function<void()> Task;
+
+    // threads = 0 uses std::thread::hardware_concurrency()
+    explicit WorkStealingPool(unsigned threads = 0);
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    unsigned size() const { return queues.size(); }
+
+    // Run the tasks, and everything they spawn, to completion. The first
+    // exception thrown by a task is rethrown here once all work is done.
+    void run(std::vector<Task> tasks);
+
+    // From inside a running task: queue more work on this thread's deque
+    void spawn(Task task);
+
+    // Tasks taken from another thread's deque in the last run
+    uint64_t steals() const { return stealCount; }
+
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    void work(unsigned self);
+    bool take(unsigned self, Task& task);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::atomic<size_t> pending;       // queued or running tasks
+    std::atomic<uint64_t> stealCount;
+    std::mutex idleLock;
+    std::condition_variable idle;
+    uint64_t spawned;                  // bumped per spawn, under idleLock
+    std::mutex errorLock;
+    std::exception_ptr error;
+};
+
+// Process-wide pool sized to the machine, created on first use
+ThreadPool& defaultThreadPool();
+
+// Minimum blocks per task; below this the split costs more than it saves
+const size_t PARALLEL_GRAIN_BLOCKS = 16384;
+
+// Apply the backend over `blocks` blocks split into block-aligned ranges.
+// Each range writes only its own slice of out, so the result is identical
+// to a single backend.apply() call.
+void parallelApply(const HillBackend& backend, const uint8_t* in, uint8_t* out,
+                   size_t blocks, ThreadPool* pool);
+
+#endif
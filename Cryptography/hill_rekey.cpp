@@ -0,0 +1,170 @@
+#include "hill_rekey.h"
+#include "hill_normalize.h"
+#include "hill_metrics.h"
+#include "mapped_file.h"
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+/* ---------- TRANSITION ---------- */
+// T = K2 * K1^-1 mod 26; a product of invertible matrices, so a valid key
+static vector<vector<int>> transitionMatrix(const HillKey& from, const HillKey& to) {
+    int n = from.size();
+    if (to.size() != n) {
+        throw runtime_error("Re-keying needs keys of the same size (" + to_string(n) + "x" +
+                            to_string(n) + " and " + to_string(to.size()) + "x" +
+                            to_string(to.size()) + ")");
+    }
+    const int* k2 = to.entries();
+    const int* inverse = from.inverseEntries();
+    vector<vector<int>> t(n, vector<int>(n));
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            int sum = 0;
+            for (int k = 0; k < n; k++) {
+                sum = (sum + k2[i * n + k] * inverse[k * n + j]) % 26;
+            }
+            t[i][j] = sum;
+        }
+    }
+    return t;
+}
+
+HillRekey::HillRekey(const HillKey& from, const HillKey& to,
+                     const HillCounter* fromCounter, const HillCounter* toCounter)
+    : transition(transitionMatrix(from, to)), fromCounter(fromCounter), toCounter(toCounter),
+      pool(nullptr), block(0) {
+    if ((fromCounter && fromCounter->size() != size()) || (toCounter && toCounter->size() != size())) {
+        throw runtime_error("Counter and key sizes differ");
+    }
+}
+
+/* ---------- STREAMING ---------- */
+size_t HillRekey::update(const char* data, size_t len, char* out) {
+    size_t n = size();
+    size_t have = letters.size();
+    {
+        HILL_STAGE(normalize, STAGE_NORMALIZE, len);
+        letters.resize(have + len);
+        letters.resize(have + scanText(data, len, letters.data() + have).letters);
+    }
+
+    size_t blocks = letters.size() / n;
+    size_t done = blocks * n;
+    // The old offsets come off inside the transform, the new ones go on
+    // after; applyBlocks() times its ranges on the threads that run them
+    applyBlocks(transition.encryptor(), fromCounter, true, letters.data(), letters.data(),
+                blocks, block, pool);
+    HILL_STAGE(multiply, STAGE_MULTIPLY, 0);
+    if (toCounter) toCounter->add(letters.data(), letters.data(), block, blocks);
+    for (size_t i = 0; i < done; i++) {
+        out[i] = char('A' + letters[i]);
+    }
+    HILL_STAGE_END(multiply);
+
+    block += blocks;
+    letters.erase(letters.begin(), letters.begin() + done);
+    return done;
+}
+
+void HillRekey::finish() const {
+    if (!letters.empty()) {
+        throw runtime_error("Encrypted text length is not a multiple of the block size");
+    }
+}
+
+FileResult rekeyStream(const HillKey& from, const HillKey& to, istream& in, ostream& out,
+                       size_t chunkSize, ThreadPool* pool,
+                       const HillCounter* fromCounter, const HillCounter* toCounter) {
+    HillRekey rekey(from, to, fromCounter, toCounter);
+    rekey.setThreadPool(pool);
+
+    size_t chunk = max<size_t>(chunkSize, 1);
+    vector<char> buffer(chunk), result(chunk + rekey.size());
+    uint64_t consumed = 0, produced = 0;
+    while (true) {
+        size_t len;
+        {
+            HILL_STAGE(read, STAGE_READ, 0);
+            in.read(buffer.data(), chunk);
+            len = in.gcount();
+            HILL_STAGE_BYTES(read, len);
+        }
+        if (len == 0) break;
+        consumed += len;
+        size_t written = rekey.update(buffer.data(), len, result.data());
+        HILL_STAGE(write, STAGE_WRITE, written);
+        out.write(result.data(), written);
+        produced += written;
+    }
+    rekey.finish();
+    out.flush();
+    if (!out) {
+        throw runtime_error("Failed to write re-keyed output");
+    }
+    return {consumed, produced, false};
+}
+
+/* ---------- MEMORY MAPPED ---------- */
+FileResult rekeyFile(const HillKey& from, const HillKey& to, const string& inPath,
+                     const string& outPath, bool inPlace, size_t chunkSize, ThreadPool* pool,
+                     const HillCounter* fromCounter, const HillCounter* toCounter) {
+    if (chunkSize == 0) chunkSize = DEFAULT_CHUNK_SIZE;
+    if (!inPlace && inPath == outPath) {
+        throw runtime_error("Input and output are the same file; use in-place mode");
+    }
+
+    MappedFile input;
+    bool mapped = inPlace ? input.openReadWrite(inPath) : input.openRead(inPath);
+    if (!mapped) {
+        if (inPlace) {
+            throw runtime_error("In-place mode needs a regular file: " + inPath);
+        }
+        ifstream in(inPath, ios::binary);
+        if (!in) {
+            throw runtime_error("Cannot open " + inPath);
+        }
+        ofstream out(outPath, ios::binary);
+        if (!out) {
+            throw runtime_error("Cannot open " + outPath + " for writing");
+        }
+        return rekeyStream(from, to, in, out, chunkSize, pool, fromCounter, toCounter);
+    }
+    input.adviseSequential();
+
+    // The output is the input's letters, so never longer than the input.
+    // The block count is checked first so a bad file is never half re-keyed.
+    size_t size = input.size();
+    HillRekey rekey(from, to, fromCounter, toCounter);
+    rekey.setThreadPool(pool);
+    if (countText(input.data(), size).letters % rekey.size() != 0) {
+        throw runtime_error("Encrypted text length is not a multiple of the block size");
+    }
+    MappedFile output;
+    char* dest = input.data();
+    if (!inPlace) {
+        if (!output.create(outPath, size)) {
+            throw runtime_error("Cannot create " + outPath);
+        }
+        dest = output.data();
+    }
+
+    // Output never overtakes the input position: each chunk is gathered
+    // before any of its letters are written back
+    size_t written = 0;
+    for (size_t off = 0; off < size; off += chunkSize) {
+        size_t len = min(chunkSize, size - off);
+        written += rekey.update(input.data() + off, len, dest + written);
+    }
+    rekey.finish();
+
+    if (inPlace) {
+        input.close(written);
+    } else {
+        output.close(written);
+        input.close();
+    }
+    return {size, written, true};
+}
@@ -0,0 +1,72 @@
+#ifndef HILL_REKEY_H
+#define HILL_REKEY_H
+
+#include "hill_key.h"
+#include "hill_counter.h"
+#include "hill_file.h"
+#include "hill_parallel.h"
+#include <vector>
+#include <string>
+#include <istream>
+#include <ostream>
+#include <cstddef>
+#include <cstdint>
+
+// Key rotation without decrypting. Ciphertext under K1 is C1 = K1 * P, so
+// the same text under K2 is K2 * P = T * C1 with T = K2 * K1^-1 (mod 26).
+// T is worked out once and the ciphertext goes straight to its new key in a
+// single pass; no plaintext is produced, not even a block of it.
+//
+// The letter count does not change, so the 'X' padding stays in place and
+// the space map written at encryption serves the new ciphertext as it is.
+//
+// In counter-offset mode the old offsets come off before T and the new ones
+// go on after it: T * (C1 - f1(i)) + f2(i).
+class HillRekey {
+public:
+    // Throws if the keys (or counters) are not all the same size
+    HillRekey(const HillKey& from, const HillKey& to,
+              const HillCounter* fromCounter = nullptr, const HillCounter* toCounter = nullptr);
+
+    int size() const { return transition.size(); }
+
+    // T = K2 * K1^-1
+    const std::vector<std::vector<int>>& matrix() const { return transition.matrix(); }
+
+    void setThreadPool(ThreadPool* p) { pool = p; }
+
+    // Re-key the letters of a chunk of ciphertext into out, as letters.
+    // Anything else is skipped, as in decryption; a partial block waits for
+    // the next chunk. out needs room for len + size() bytes. Returns the
+    // bytes written.
+    size_t update(const char* data, size_t len, char* out);
+
+    // Throws if the ciphertext ended inside a block
+    void finish() const;
+
+    uint64_t blocks() const { return block; }
+
+private:
+    HillKey transition;
+    const HillCounter* fromCounter;
+    const HillCounter* toCounter;
+    ThreadPool* pool;
+    std::vector<uint8_t> letters;   // chunk letters plus carried partial block
+    uint64_t block;                 // index of the next block
+};
+
+// Buffered streaming
+FileResult rekeyStream(const HillKey& from, const HillKey& to, std::istream& in, std::ostream& out,
+                       size_t chunkSize = DEFAULT_CHUNK_SIZE, ThreadPool* pool = nullptr,
+                       const HillCounter* fromCounter = nullptr,
+                       const HillCounter* toCounter = nullptr);
+
+// Memory-mapped file to file, or in place (outPath ignored); falls back to
+// the stream function when the input cannot be mapped
+FileResult rekeyFile(const HillKey& from, const HillKey& to, const std::string& inPath,
+                     const std::string& outPath, bool inPlace,
+                     size_t chunkSize = DEFAULT_CHUNK_SIZE, ThreadPool* pool = nullptr,
+                     const HillCounter* fromCounter = nullptr,
+                     const HillCounter* toCounter = nullptr);
+
+#endif
@@ -0,0 +1,442 @@
+#include "hill_server.h"
+#include "hill_message.h"
+#include "hill_normalize.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+using namespace std;
+
+/* ---------- FRAMING ---------- */
+const size_t REQUEST_HEADER = 12;    // length, op, n, reserved, id
+const size_t RESPONSE_HEADER = 12;   // length, status, reserved, id
+
+static uint32_t readU32(const char* p) {
+    const unsigned char* b = reinterpret_cast<const unsigned char*>(p);
+    return uint32_t(b[0]) | uint32_t(b[1]) << 8 | uint32_t(b[2]) << 16 | uint32_t(b[3]) << 24;
+}
+
+static void writeU32(char* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = char(v >> (8 * i));
+    }
+}
+
+#ifndef _WIN32
+static sockaddr_un socketAddress(const string& path) {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        throw runtime_error("Invalid socket path '" + path + "'");
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    return addr;
+}
+
+static void setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        throw runtime_error(string("Cannot make socket non-blocking: ") + strerror(errno));
+    }
+}
+
+/* ---------- SERVER ---------- */
+HillServer::HillServer(const string& socketPath, shared_ptr<const HillKey> defaultKey,
+                       size_t cacheCapacity)
+    : path(socketPath), listener(-1), defaultKey(defaultKey), cache(cacheCapacity),
+      pool(nullptr), stopping(false), requestCount(0), batchCount(0) {
+    sockaddr_un addr = socketAddress(path);
+
+    // A leftover socket file from a dead server is replaced; a live one is not
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe >= 0) {
+        bool live = connect(probe, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+        close(probe);
+        if (live) {
+            throw runtime_error("A server is already listening on " + path);
+        }
+    }
+    unlink(path.c_str());
+
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        throw runtime_error(string("Cannot create socket: ") + strerror(errno));
+    }
+    if (bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        listen(listener, 128) != 0) {
+        string reason = strerror(errno);
+        close(listener);
+        throw runtime_error("Cannot listen on " + path + ": " + reason);
+    }
+    setNonBlocking(listener);
+}
+
+HillServer::~HillServer() {
+    for (auto& client : clients) {
+        close(client->fd);
+    }
+    if (listener >= 0) {
+        close(listener);
+        unlink(path.c_str());
+    }
+}
+
+void HillServer::run() {
+    vector<pollfd> fds;
+    while (!stopping) {
+        fds.clear();
+        fds.push_back({listener, POLLIN, 0});
+        for (auto& client : clients) {
+            short events = 0;
+            // Stop reading from a client that is not draining its responses
+            if (!client->closing && client->output.size() - client->sent < MAX_FRAME_BYTES) {
+                events |= POLLIN;
+            }
+            if (client->sent < client->output.size()) events |= POLLOUT;
+            fds.push_back({client->fd, events, 0});
+        }
+
+        // The timeout only bounds how long a stop() request waits
+        int ready = poll(fds.data(), fds.size(), 200);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            throw runtime_error(string("poll failed: ") + strerror(errno));
+        }
+        if (ready == 0) continue;
+
+        // Everything readable now becomes one batch
+        for (size_t i = 1; i < fds.size(); i++) {
+            Client& client = *clients[i - 1];
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                // Requests sent just before a half-close are still answered
+                bool open = readClient(client);
+                parseFrames(client);
+                if (!open) client.closing = true;
+            }
+        }
+        processBatch();
+
+        for (auto& client : clients) {
+            if (!flushClient(*client)) client->closing = true;
+        }
+        clients.erase(remove_if(clients.begin(), clients.end(), [](const unique_ptr<Client>& c) {
+            if (c->closing && c->sent == c->output.size()) {
+                close(c->fd);
+                return true;
+            }
+            return false;
+        }), clients.end());
+
+        if (fds[0].revents & POLLIN) acceptClients();
+    }
+}
+
+void HillServer::acceptClients() {
+    for (;;) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) return;
+        setNonBlocking(fd);
+        clients.emplace_back(new Client{fd, {}, 0, string(), 0, false});
+    }
+}
+
+// False once the peer has gone away
+bool HillServer::readClient(Client& client) {
+    char buffer[65536];
+    for (;;) {
+        ssize_t got = read(client.fd, buffer, sizeof(buffer));
+        if (got > 0) {
+            client.input.insert(client.input.end(), buffer, buffer + got);
+            if ((size_t)got < sizeof(buffer)) return true;
+        } else if (got == 0) {
+            return false;
+        } else {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+    }
+}
+
+// Turn every complete frame into a job (or answer it straight away)
+void HillServer::parseFrames(Client& client) {
+    while (!client.closing && client.input.size() - client.parsed >= 4) {
+        const char* frame = client.input.data() + client.parsed;
+        uint32_t length = readU32(frame);
+        if (length < REQUEST_HEADER - 4 || length > MAX_FRAME_BYTES) {
+            // Cannot resynchronise after a bad length
+            client.closing = true;
+            return;
+        }
+        if (client.input.size() - client.parsed < 4 + size_t(length)) return;
+        client.parsed += 4 + length;
+        requestCount++;
+
+        uint8_t op = frame[4];
+        int n = (unsigned char)frame[5];
+        uint32_t id = readU32(frame + 8);
+        const char* body = frame + REQUEST_HEADER;
+        size_t bodyLength = length + 4 - REQUEST_HEADER;
+
+        try {
+            if (op == OP_STATS) {
+                string line = "requests " + to_string(requestCount) +
+                              " batches " + to_string(batchCount) +
+                              " clients " + to_string(clients.size()) +
+                              " keys " + to_string(cache.size()) +
+                              " hits " + to_string(cache.hits()) +
+                              " misses " + to_string(cache.misses()) + "\n";
+                respond(client, id, STATUS_OK, line.data(), line.size());
+                continue;
+            }
+            if (op != OP_ENCRYPT && op != OP_DECRYPT) {
+                throw runtime_error("Unknown operation " + to_string(op));
+            }
+
+            shared_ptr<const HillKey> key = defaultKey;
+            size_t keyBytes = size_t(n) * n;
+            if (n > 0) {
+                if (bodyLength < keyBytes) throw runtime_error("Frame shorter than its key");
+                vector<vector<int>> matrix(n, vector<int>(n));
+                for (int i = 0; i < n; i++) {
+                    for (int j = 0; j < n; j++) {
+                        matrix[i][j] = (unsigned char)body[i * n + j];
+                    }
+                }
+                key = cache.get(matrix);
+            } else if (!key) {
+                throw runtime_error("No key given and the server has no default key");
+            }
+
+            Job job = {&client, id, op, key, body + keyBytes, bodyLength - keyBytes, 0, 0, jobs.size()};
+            if (op == OP_ENCRYPT) {
+                size_t letters = countMessage(job.payload, job.length).letters;
+                job.letters = encryptedLength(letters, key->size());
+            } else {
+                if (job.length % key->size() != 0) {
+                    throw runtime_error("Encrypted text length is not a multiple of the block size");
+                }
+                if (countText(job.payload, job.length).letters != job.length) {
+                    throw runtime_error("Invalid character in encrypted text. Only letters allowed.");
+                }
+                job.letters = job.length;
+            }
+            jobs.push_back(job);
+        } catch (const exception& e) {
+            respond(client, id, STATUS_ERROR, e.what(), strlen(e.what()));
+        }
+    }
+}
+
+// Run the batch: one backend call per (key, direction) group
+void HillServer::processBatch() {
+    if (!jobs.empty()) {
+        batchCount++;
+
+        // Group by key and direction; staging holds each group contiguously
+        sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) {
+            if (a.key != b.key) return a.key < b.key;
+            if (a.op != b.op) return a.op < b.op;
+            return a.order < b.order;
+        });
+        size_t total = 0;
+        for (Job& job : jobs) {
+            job.offset = total;
+            total += job.letters;
+        }
+        staging.resize(total);
+
+        // Letters as indices 0..25, padded with 'X'
+        for (const Job& job : jobs) {
+            uint8_t* dest = staging.data() + job.offset;
+            size_t count = scanText(job.payload, job.length, dest).letters;
+            while (count < job.letters) dest[count++] = 'X' - 'A';
+        }
+
+        for (size_t first = 0; first < jobs.size();) {
+            size_t last = first + 1;
+            while (last < jobs.size() && jobs[last].key == jobs[first].key &&
+                   jobs[last].op == jobs[first].op) {
+                last++;
+            }
+            const HillKey& key = *jobs[first].key;
+            const HillBackend& backend = jobs[first].op == OP_ENCRYPT ? key.encryptor() : key.decryptor();
+            size_t begin = jobs[first].offset;
+            size_t end = jobs[last - 1].offset + jobs[last - 1].letters;
+            parallelApply(backend, staging.data() + begin, staging.data() + begin,
+                          (end - begin) / key.size(), pool);
+            first = last;
+        }
+
+        for (size_t i = 0; i < total; i++) {
+            staging[i] += 'A';
+        }
+
+        // Answer in arrival order so each client sees its own order kept
+        sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) {
+            return a.order < b.order;
+        });
+        for (const Job& job : jobs) {
+            const char* text = reinterpret_cast<const char*>(staging.data() + job.offset);
+            size_t length = job.letters;
+            if (job.op == OP_DECRYPT) {
+                while (length > 0 && text[length - 1] == 'X') length--;
+            }
+            respond(*job.client, job.id, STATUS_OK, text, length);
+        }
+        jobs.clear();
+    }
+
+    // Payloads are no longer referenced; drop the answered frames
+    for (auto& client : clients) {
+        if (client->parsed > 0) {
+            client->input.erase(client->input.begin(), client->input.begin() + client->parsed);
+            client->parsed = 0;
+        }
+    }
+}
+
+void HillServer::respond(Client& client, uint32_t id, uint8_t status, const char* data, size_t len) {
+    char header[RESPONSE_HEADER] = {};
+    writeU32(header, uint32_t(RESPONSE_HEADER - 4 + len));
+    header[4] = char(status);
+    writeU32(header + 8, id);
+    client.output.append(header, RESPONSE_HEADER);
+    client.output.append(data, len);
+}
+
+// False if the peer can no longer be written to
+bool HillServer::flushClient(Client& client) {
+    while (client.sent < client.output.size()) {
+        ssize_t put = send(client.fd, client.output.data() + client.sent,
+                           client.output.size() - client.sent, MSG_NOSIGNAL);
+        if (put < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+            client.sent = client.output.size();
+            return false;
+        }
+        client.sent += put;
+    }
+    client.output.clear();
+    client.sent = 0;
+    return true;
+}
+
+/* ---------- CLIENT ---------- */
+HillClient::HillClient(const string& socketPath) : fd(-1), nextId(1) {
+    sockaddr_un addr = socketAddress(socketPath);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        string reason = strerror(errno);
+        if (fd >= 0) close(fd);
+        throw runtime_error("Cannot connect to " + socketPath + ": " + reason);
+    }
+}
+
+HillClient::~HillClient() {
+    if (fd >= 0) close(fd);
+}
+
+static void writeAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t put = send(fd, data, len, MSG_NOSIGNAL);
+        if (put < 0) {
+            if (errno == EINTR) continue;
+            throw runtime_error(string("Lost connection to server: ") + strerror(errno));
+        }
+        data += put;
+        len -= put;
+    }
+}
+
+static void readAll(int fd, char* data, size_t len) {
+    while (len > 0) {
+        ssize_t got = read(fd, data, len);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) throw runtime_error("Lost connection to server");
+        data += got;
+        len -= got;
+    }
+}
+
+string HillClient::request(uint8_t op, const vector<vector<int>>& key, const string& payload) {
+    size_t n = key.size();
+    if (n > 255) throw runtime_error("Key too large for the protocol");
+    size_t length = REQUEST_HEADER - 4 + n * n + payload.size();
+    if (length > MAX_FRAME_BYTES) throw runtime_error("Request too large");
+
+    uint32_t id = nextId++;
+    string frame(REQUEST_HEADER, '\0');
+    writeU32(&frame[0], uint32_t(length));
+    frame[4] = char(op);
+    frame[5] = char(n);
+    writeU32(&frame[8], id);
+    for (auto& row : key) {
+        if (row.size() != n) throw runtime_error("Key matrix must be square");
+        for (int x : row) {
+            frame.push_back(char(((x % 26) + 26) % 26));
+        }
+    }
+    frame += payload;
+    writeAll(fd, frame.data(), frame.size());
+
+    char header[RESPONSE_HEADER];
+    readAll(fd, header, RESPONSE_HEADER);
+    uint32_t reply = readU32(header);
+    if (reply < RESPONSE_HEADER - 4 || reply > MAX_FRAME_BYTES || readU32(header + 8) != id) {
+        throw runtime_error("Malformed response from server");
+    }
+    string body(reply + 4 - RESPONSE_HEADER, '\0');
+    if (!body.empty()) readAll(fd, &body[0], body.size());
+    if (header[4] != STATUS_OK) {
+        throw runtime_error(body);
+    }
+    return body;
+}
+
+#else
+/* ---------- UNSUPPORTED ---------- */
+HillServer::HillServer(const string&, shared_ptr<const HillKey>, size_t cacheCapacity)
+    : listener(-1), cache(cacheCapacity), pool(nullptr), stopping(false),
+      requestCount(0), batchCount(0) {
+    throw runtime_error("The cipher server needs Unix domain sockets");
+}
+
+HillServer::~HillServer() {
+}
+
+void HillServer::run() {
+}
+
+HillClient::HillClient(const string&) : fd(-1), nextId(1) {
+    throw runtime_error("The cipher server needs Unix domain sockets");
+}
+
+HillClient::~HillClient() {
+}
+
+string HillClient::request(uint8_t, const vector<vector<int>>&, const string&) {
+    return string();
+}
+#endif
+
+string HillClient::encrypt(const string& message, const vector<vector<int>>& key) {
+    return request(OP_ENCRYPT, key, message);
+}
+
+string HillClient::decrypt(const string& ciphertext, const vector<vector<int>>& key) {
+    return request(OP_DECRYPT, key, ciphertext);
+}
+
+string HillClient::stats() {
+    return request(OP_STATS, {}, string());
+}
@@ -0,0 +1,130 @@
+#ifndef HILL_SERVER_H
+#define HILL_SERVER_H
+
+#include "hill_key.h"
+#include "hill_parallel.h"
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Binary protocol over a Unix domain socket. All integers little-endian.
+//
+// Request:  length u32 | op u8 | n u8 | reserved u16 | id u32
+//           | key n*n bytes (n = 0: the server's default key) | payload
+// Response: length u32 | status u8 | reserved 3 bytes | id u32 | payload
+//
+// `length` counts the bytes after itself. Encrypt takes a message and
+// returns the ciphertext letters (spaces dropped, 'X' padding added, as in
+// the programs); decrypt takes ciphertext letters and returns the plaintext
+// with the padding stripped; stats returns a line of counters. On error the
+// status is non-zero and the payload is the message. Requests may be
+// pipelined; responses carry the request id.
+enum ServerOp : uint8_t {
+    OP_ENCRYPT = 1,
+    OP_DECRYPT = 2,
+    OP_STATS = 3
+};
+
+enum ServerStatus : uint8_t {
+    STATUS_OK = 0,
+    STATUS_ERROR = 1
+};
+
+// Largest frame either side accepts
+const uint32_t MAX_FRAME_BYTES = 64u << 20;
+
+// Single-threaded poll() loop. Every request that has arrived by the time
+// the loop wakes is handled as one batch: requests for the same key and
+// direction are gathered into one buffer and transformed with a single
+// backend call (spread over the thread pool when large), then split back
+// into responses. Keys and their inverses stay resident in a HillKeyCache.
+class HillServer {
+public:
+    HillServer(const std::string& socketPath, std::shared_ptr<const HillKey> defaultKey,
+               size_t cacheCapacity = 64);
+    ~HillServer();
+
+    HillServer(const HillServer&) = delete;
+    HillServer& operator=(const HillServer&) = delete;
+
+    // Spread large batches over a thread pool (nullptr = inline)
+    void setThreadPool(ThreadPool* threads) { pool = threads; }
+
+    // Serve until stop() is called (from another thread or a signal handler)
+    void run();
+    void stop() { stopping = true; }
+
+    uint64_t requests() const { return requestCount; }
+    uint64_t batches() const { return batchCount; }
+
+private:
+    struct Client {
+        int fd;
+        std::vector<char> input;    // bytes received, frames not yet answered
+        size_t parsed;              // input bytes already turned into jobs
+        std::string output;         // responses not yet sent
+        size_t sent;
+        bool closing;               // drop once output is flushed
+    };
+
+    // One encrypt/decrypt request within the current batch
+    struct Job {
+        Client* client;
+        uint32_t id;
+        uint8_t op;
+        std::shared_ptr<const HillKey> key;
+        const char* payload;        // points into client->input
+        size_t length;
+        size_t offset;              // position of its letters in staging
+        size_t letters;             // letters after padding
+        size_t order;               // arrival order within the batch
+    };
+
+    void acceptClients();
+    bool readClient(Client& client);
+    void parseFrames(Client& client);
+    void processBatch();
+    void respond(Client& client, uint32_t id, uint8_t status, const char* data, size_t len);
+    bool flushClient(Client& client);
+
+    std::string path;
+    int listener;
+    std::shared_ptr<const HillKey> defaultKey;
+    HillKeyCache cache;
+    ThreadPool* pool;
+    std::atomic<bool> stopping;
+    std::vector<std::unique_ptr<Client>> clients;
+    std::vector<Job> jobs;
+    std::vector<uint8_t> staging;
+    uint64_t requestCount;
+    uint64_t batchCount;
+};
+
+// Blocking client for HillServer
+class HillClient {
+public:
+    explicit HillClient(const std::string& socketPath);
+    ~HillClient();
+
+    HillClient(const HillClient&) = delete;
+    HillClient& operator=(const HillClient&) = delete;
+
+    // Empty key = the server's default key. Throw on server errors.
+    std::string encrypt(const std::string& message,
+                        const std::vector<std::vector<int>>& key = {});
+    std::string decrypt(const std::string& ciphertext,
+                        const std::vector<std::vector<int>>& key = {});
+    std::string stats();
+
+private:
+    std::string request(uint8_t op, const std::vector<std::vector<int>>& key,
+                        const std::string& payload);
+
+    int fd;
+    uint32_t nextId;
+};
+
+#endif
@@ -0,0 +1,210 @@
+#include "hill_stream.h"
+#include "hill_metrics.h"
+#include "hill_normalize.h"
+
+using namespace std;
+
+/* ---------- OUTPUT SINKS ---------- */
+// Appends to a std::string
+struct StringSink {
+    string& out;
+    void put(char c) { out.push_back(c); }
+    char* reserve(size_t count) {
+        size_t base = out.size();
+        out.resize(base + count);
+        return &out[base];
+    }
+};
+
+// Writes through a raw pointer the caller sized for the whole output
+struct PointerSink {
+    char* out;
+    void put(char c) { *out++ = c; }
+    char* reserve(size_t count) {
+        char* p = out;
+        out += count;
+        return p;
+    }
+};
+
+/* ---------- ENCRYPTOR ---------- */
+HillStreamEncryptor::HillStreamEncryptor(shared_ptr<const HillKey> key, SpaceMapWriter* spaceMap)
+    : key(key), backend(key->encryptor()), pool(nullptr), counter(nullptr), spaceMap(spaceMap),
+      position(0), outputLength(0) {
+}
+
+HillStreamEncryptor::HillStreamEncryptor(const vector<vector<int>>& key, SpaceMapWriter* spaceMap,
+                                         BackendType type)
+    : HillStreamEncryptor(make_shared<HillKey>(key, type), spaceMap) {
+}
+
+// Encrypt every complete block in the buffer and keep the remainder
+template <class Sink>
+void HillStreamEncryptor::flushBlocks(Sink& out) {
+    size_t n = backend.size();
+    size_t blocks = letters.size() / n;
+    size_t done = blocks * n;
+    // applyBlocks() times the transform per range on the threads doing it;
+    // the conversion back to letters runs here
+    applyBlocks(backend, counter, false, letters.data(), letters.data(), blocks, outputLength / n, pool);
+
+    HILL_STAGE(multiply, STAGE_MULTIPLY, 0);
+    char* dest = out.reserve(done);
+    for (size_t i = 0; i < done; i++) {
+        dest[i] = char('A' + letters[i]);
+    }
+    HILL_STAGE_END(multiply);
+    outputLength += done;
+    letters.erase(letters.begin(), letters.begin() + done);
+}
+
+void HillStreamEncryptor::update(const char* data, size_t len, string& out) {
+    StringSink sink{out};
+    gather(data, len);
+    flushBlocks(sink);
+}
+
+size_t HillStreamEncryptor::update(const char* data, size_t len, char* out) {
+    PointerSink sink{out};
+    gather(data, len);
+    flushBlocks(sink);
+    return sink.out - out;
+}
+
+// Space map writes happen while gathering and count as normalization
+void HillStreamEncryptor::gather(const char* data, size_t len) {
+    HILL_STAGE(normalize, STAGE_NORMALIZE, len);
+    size_t have = letters.size();
+    letters.resize(have + len);
+    if (spaceMap) spaces.resize(len);
+    TextScan scan = scanText(data, len, letters.data() + have,
+                             spaceMap ? spaces.data() : nullptr, position);
+    letters.resize(have + scan.letters);
+    if (spaceMap) {
+        for (size_t i = 0; i < scan.spaces; i++) spaceMap->add(spaces[i]);
+    }
+    position += len;
+}
+
+void HillStreamEncryptor::pad() {
+    HILL_STAGE(padding, STAGE_PAD, (backend.size() - letters.size() % backend.size()) % backend.size());
+    while (letters.size() % backend.size() != 0) {
+        letters.push_back('X' - 'A');
+    }
+}
+
+void HillStreamEncryptor::finish(string& out) {
+    StringSink sink{out};
+    pad();
+    flushBlocks(sink);
+}
+
+size_t HillStreamEncryptor::finish(char* out) {
+    PointerSink sink{out};
+    pad();
+    flushBlocks(sink);
+    return sink.out - out;
+}
+
+/* ---------- DECRYPTOR ---------- */
+HillStreamDecryptor::HillStreamDecryptor(shared_ptr<const HillKey> key, SpaceMapReader* spaceMap)
+    : key(key), backend(key->decryptor()), pool(nullptr), counter(nullptr), spaceMap(spaceMap),
+      blocksDone(0), heldX(0), outputLength(0), limit(0), nextSpace(0), haveSpace(false) {
+    if (spaceMap) {
+        limit = spaceMap->originalLength();
+        haveSpace = spaceMap->next(nextSpace);
+    }
+}
+
+HillStreamDecryptor::HillStreamDecryptor(const vector<vector<int>>& key, SpaceMapReader* spaceMap,
+                                         BackendType type)
+    : HillStreamDecryptor(make_shared<HillKey>(key, type), spaceMap) {
+}
+
+bool HillStreamDecryptor::full() const {
+    return limit > 0 && outputLength >= limit;
+}
+
+// Insert every space that belongs at the current output position
+template <class Sink>
+void HillStreamDecryptor::emitSpaces(Sink& out) {
+    while (haveSpace && nextSpace <= outputLength && !full()) {
+        if (nextSpace == outputLength) {
+            out.put(' ');
+            outputLength++;
+        }
+        haveSpace = spaceMap->next(nextSpace);
+    }
+}
+
+template <class Sink>
+void HillStreamDecryptor::emit(char c, Sink& out) {
+    emitSpaces(out);
+    if (full()) return;
+    out.put(c);
+    outputLength++;
+}
+
+template <class Sink>
+void HillStreamDecryptor::flushBlocks(Sink& out) {
+    size_t n = backend.size();
+    size_t blocks = letters.size() / n;
+    size_t done = blocks * n;
+    // Timed per range inside applyBlocks()
+    applyBlocks(backend, counter, true, letters.data(), letters.data(), blocks, blocksDone, pool);
+    blocksDone += blocks;
+
+    // Padding detection and space re-insertion
+    HILL_STAGE(layout, STAGE_LAYOUT, done);
+    for (size_t i = 0; i < done; i++) {
+        char c = char('A' + letters[i]);
+        if (c == 'X') {
+            heldX++;
+            continue;
+        }
+        for (; heldX > 0; heldX--) emit('X', out);
+        emit(c, out);
+    }
+    letters.erase(letters.begin(), letters.begin() + done);
+}
+
+void HillStreamDecryptor::gather(const char* data, size_t len) {
+    HILL_STAGE(normalize, STAGE_NORMALIZE, len);
+    size_t have = letters.size();
+    letters.resize(have + len);
+    letters.resize(have + scanText(data, len, letters.data() + have).letters);
+}
+
+void HillStreamDecryptor::update(const char* data, size_t len, string& out) {
+    StringSink sink{out};
+    gather(data, len);
+    flushBlocks(sink);
+}
+
+size_t HillStreamDecryptor::update(const char* data, size_t len, char* out) {
+    PointerSink sink{out};
+    gather(data, len);
+    flushBlocks(sink);
+    return sink.out - out;
+}
+
+template <class Sink>
+void HillStreamDecryptor::finishTo(Sink& out) {
+    if (!letters.empty()) {
+        throw runtime_error("Encrypted text length is not a multiple of the block size");
+    }
+    // Held 'X' run is padding; only spaces directly after the last letter remain
+    heldX = 0;
+    if (spaceMap) emitSpaces(out);
+}
+
+void HillStreamDecryptor::finish(string& out) {
+    StringSink sink{out};
+    finishTo(sink);
+}
+
+size_t HillStreamDecryptor::finish(char* out) {
+    PointerSink sink{out};
+    finishTo(sink);
+    return sink.out - out;
+}
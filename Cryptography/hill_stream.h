@@ -0,0 +1,113 @@
+#ifndef HILL_STREAM_H
+#define HILL_STREAM_H
+
+#include "hill_key.h"
+#include "space_map.h"
+#include "hill_parallel.h"
+#include "hill_counter.h"
+#include <vector>
+#include <memory>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Streaming Hill encryptor: takes the message in chunks of any size, carries
+// an incomplete n-letter block across chunk boundaries and emits ciphertext
+// as soon as each block is complete.
+class HillStreamEncryptor {
+public:
+    explicit HillStreamEncryptor(std::shared_ptr<const HillKey> key,
+                                 SpaceMapWriter* spaceMap = nullptr);
+    explicit HillStreamEncryptor(const std::vector<std::vector<int>>& key,
+                                 SpaceMapWriter* spaceMap = nullptr,
+                                 BackendType backend = BACKEND_AUTO);
+
+    // Encrypt a chunk, appending completed blocks to out
+    void update(const char* data, size_t len, std::string& out);
+
+    // Zero-copy variant: writes straight into out, which must have room for
+    // every letter seen so far; returns the bytes written
+    size_t update(const char* data, size_t len, char* out);
+
+    // Pad the trailing partial block with 'X' and flush it
+    void finish(std::string& out);
+    size_t finish(char* out);
+
+    // Spread each chunk's blocks over a thread pool (nullptr = inline)
+    void setThreadPool(ThreadPool* threads) { pool = threads; }
+
+    // Counter-offset mode (nullptr = plain Hill); set before the first update
+    void setCounter(const HillCounter* offsets) { counter = offsets; }
+
+    uint64_t consumed() const { return position; }
+    uint64_t produced() const { return outputLength; }
+
+private:
+    void gather(const char* data, size_t len);
+    void pad();
+    template <class Sink> void flushBlocks(Sink& out);
+
+    std::shared_ptr<const HillKey> key;
+    const HillBackend& backend;
+    ThreadPool* pool;
+    const HillCounter* counter;
+    SpaceMapWriter* spaceMap;
+    std::vector<uint8_t> letters;   // chunk letters plus carried partial block
+    std::vector<uint64_t> spaces;   // space offsets of the current chunk
+    uint64_t position;              // bytes of original message seen so far
+    uint64_t outputLength;
+};
+
+// Streaming Hill decryptor: mirrors HillStreamEncryptor. Trailing 'X' padding
+// is held back until a non-'X' letter proves it genuine, and spaces are
+// re-inserted from the space map as the output position reaches them.
+class HillStreamDecryptor {
+public:
+    explicit HillStreamDecryptor(std::shared_ptr<const HillKey> key,
+                                 SpaceMapReader* spaceMap = nullptr);
+    explicit HillStreamDecryptor(const std::vector<std::vector<int>>& key,
+                                 SpaceMapReader* spaceMap = nullptr,
+                                 BackendType backend = BACKEND_AUTO);
+
+    // Decrypt a chunk, appending plaintext to out. Non-letters are ignored.
+    void update(const char* data, size_t len, std::string& out);
+
+    // Zero-copy variant: out must have room for the rest of the output
+    // (letters plus spaces still in the map); returns the bytes written
+    size_t update(const char* data, size_t len, char* out);
+
+    // Drop held padding and emit any trailing spaces
+    void finish(std::string& out);
+    size_t finish(char* out);
+
+    // Spread each chunk's blocks over a thread pool (nullptr = inline)
+    void setThreadPool(ThreadPool* threads) { pool = threads; }
+
+    // Counter-offset mode (nullptr = plain Hill); set before the first update
+    void setCounter(const HillCounter* offsets) { counter = offsets; }
+
+    uint64_t produced() const { return outputLength; }
+
+private:
+    void gather(const char* data, size_t len);
+    template <class Sink> void flushBlocks(Sink& out);
+    template <class Sink> void emit(char c, Sink& out);
+    template <class Sink> void emitSpaces(Sink& out);
+    template <class Sink> void finishTo(Sink& out);
+    bool full() const;
+
+    std::shared_ptr<const HillKey> key;
+    const HillBackend& backend;
+    ThreadPool* pool;
+    const HillCounter* counter;
+    SpaceMapReader* spaceMap;
+    std::vector<uint8_t> letters;
+    uint64_t blocksDone;      // block index of the next block, for the counter
+    uint64_t heldX;           // run of 'X' that may be padding
+    uint64_t outputLength;
+    uint64_t limit;           // original length from the map (0 = none)
+    uint64_t nextSpace;
+    bool haveSpace;
+};
+
+#endif
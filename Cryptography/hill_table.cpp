@@ -0,0 +1,106 @@
+#include "hill_table.h"
+#include <stdexcept>
+#include <cstring>
+
+using namespace std;
+
+HillTable::HillTable(const vector<vector<int>>& key, bool fullBlock) : n(key.size()) {
+    if (n == 0) {
+        throw runtime_error("Key matrix is empty");
+    }
+    for (int i = 0; i < n; i++) {
+        if ((int)key[i].size() != n) {
+            throw runtime_error("Key matrix must be square");
+        }
+    }
+
+    // Column contribution tables
+    columns.resize(size_t(n) * 26 * n);
+    for (int j = 0; j < n; j++) {
+        for (int v = 0; v < 26; v++) {
+            uint8_t* row = &columns[(j * 26 + v) * n];
+            for (int i = 0; i < n; i++) {
+                int k = ((key[i][j] % 26) + 26) % 26;
+                row[i] = uint8_t(k * v % 26);
+            }
+        }
+    }
+
+    // A sum of n contributions is below 26 * n
+    fold.resize(26 * n);
+    for (int s = 0; s < 26 * n; s++) {
+        fold[s] = uint8_t(s % 26);
+    }
+
+    if (fullBlock && (n == 2 || n == 3)) {
+        size_t entries = (n == 2) ? 26 * 26 : 26 * 26 * 26;
+        full.resize(entries * n);
+
+        vector<uint8_t> block(n);
+        for (size_t idx = 0; idx < entries; idx++) {
+            size_t rest = idx;
+            for (int j = n - 1; j >= 0; j--) {
+                block[j] = uint8_t(rest % 26);
+                rest /= 26;
+            }
+            applyColumns(block.data(), &full[idx * n], 1);
+        }
+    }
+}
+
+size_t HillTable::footprint() const {
+    return columns.size() + fold.size() + full.size();
+}
+
+void HillTable::applyColumns(const uint8_t* in, uint8_t* out, size_t blocks) const {
+    uint16_t acc[64];
+    vector<uint16_t> wide;
+    uint16_t* sums = acc;
+    if (n > 64) {
+        wide.resize(n);
+        sums = wide.data();
+    }
+
+    for (size_t b = 0; b < blocks; b++) {
+        const uint8_t* x = in + b * n;
+        memset(sums, 0, n * sizeof(uint16_t));
+        for (int j = 0; j < n; j++) {
+            const uint8_t* __restrict row = &columns[(j * 26 + x[j]) * n];
+            uint16_t* __restrict s = sums;
+            for (int i = 0; i < n; i++) {
+                s[i] += row[i];
+            }
+        }
+        uint8_t* y = out + b * n;
+        for (int i = 0; i < n; i++) {
+            y[i] = fold[sums[i]];
+        }
+    }
+}
+
+void HillTable::apply(const uint8_t* in, uint8_t* out, size_t blocks) const {
+    if (full.empty()) {
+        applyColumns(in, out, blocks);
+        return;
+    }
+
+    const uint8_t* lut = full.data();
+    if (n == 2) {
+        for (size_t b = 0; b < blocks; b++) {
+            const uint8_t* x = in + 2 * b;
+            const uint8_t* y = lut + 2 * (x[0] * 26 + x[1]);
+            uint8_t y0 = y[0], y1 = y[1];
+            out[2 * b] = y0;
+            out[2 * b + 1] = y1;
+        }
+    } else {
+        for (size_t b = 0; b < blocks; b++) {
+            const uint8_t* x = in + 3 * b;
+            const uint8_t* y = lut + 3 * (x[0] * 676 + x[1] * 26 + x[2]);
+            uint8_t y0 = y[0], y1 = y[1], y2 = y[2];
+            out[3 * b] = y0;
+            out[3 * b + 1] = y1;
+            out[3 * b + 2] = y2;
+        }
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef HILL_TABLE_H
+#define HILL_TABLE_H
+
+#include "hill_backend.h"
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Table-driven Hill backend. Since the key is fixed, every product K[i][j] * v
+// can be precomputed: the column tables hold the n contributions of letter v
+// in column j (26 entries per column), so a block is n table rows summed and
+// folded through a small mod-26 table. For 2x2 and 3x3 keys an optional
+// full-block table maps the whole block index straight to its ciphertext
+// (676 entries for 2x2, 17,576 x 3 bytes ~ 52KB for 3x3).
+class HillTable : public HillBackend {
+public:
+    explicit HillTable(const std::vector<std::vector<int>>& key, bool fullBlock = true);
+
+    void apply(const uint8_t* in, uint8_t* out, size_t blocks) const override;
+
+    int size() const override { return n; }
+    const char* name() const override { return full.empty() ? "table-column" : "table-block"; }
+
+    // Memory used by the tables in bytes
+    size_t footprint() const;
+
+private:
+    void applyColumns(const uint8_t* in, uint8_t* out, size_t blocks) const;
+
+    int n;
+    std::vector<uint8_t> columns;   // [(j * 26 + v) * n + i] = K[i][j] * v mod 26
+    std::vector<uint8_t> fold;      // [s] = s mod 26 for every column sum s
+    std::vector<uint8_t> full;      // [block index * n + i], empty if unused
+};
+
+#endif
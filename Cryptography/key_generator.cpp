@@ -0,0 +1,172 @@
+#include "key_generator.h"
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+
+// Largest key the fixed-size scratch arrays hold
+static const int MAX_GENERATED_SIZE = 64;
+
+// Keys per bulk task; tasks are seeded by index so output ignores threads
+static const size_t BULK_CHUNK_KEYS = 4096;
+
+/* ---------- RANDOM NUMBERS ---------- */
+static uint64_t splitmix64(uint64_t& x) {
+    uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+KeyGenerator::KeyGenerator(uint64_t seed) : keyCount(0), redrawCount(0) {
+    for (uint64_t& s : state) s = splitmix64(seed);
+}
+
+uint64_t KeyGenerator::randomSeed() {
+    random_device device;
+    uint64_t seed = (uint64_t(device()) << 32) ^ device();
+    return seed ^ uint64_t(chrono::steady_clock::now().time_since_epoch().count());
+}
+
+// xoshiro256**
+uint64_t KeyGenerator::next64() {
+    uint64_t result = rotl(state[1] * 5, 7) * 9;
+    uint64_t t = state[1] << 17;
+    state[2] ^= state[0];
+    state[3] ^= state[1];
+    state[1] ^= state[2];
+    state[0] ^= state[3];
+    state[2] ^= t;
+    state[3] = rotl(state[3], 45);
+    return result;
+}
+
+// Uniform in [0, bound): multiply-shift with Lemire's rejection step
+uint32_t KeyGenerator::below(uint32_t bound) {
+    uint64_t m = uint64_t(uint32_t(next64() >> 32)) * bound;
+    uint32_t low = uint32_t(m);
+    if (low < bound) {
+        uint32_t threshold = uint32_t(-bound) % bound;
+        while (low < threshold) {
+            m = uint64_t(uint32_t(next64() >> 32)) * bound;
+            low = uint32_t(m);
+        }
+    }
+    return uint32_t(m >> 32);
+}
+
+/* ---------- GENERATION ---------- */
+// Uniform invertible n x n matrix mod prime p, row-major into m.
+// The rows so far are kept in reduced echelon form; with pivot columns set,
+// every vector is uniquely (combination of those rows) + (vector that is
+// zero on the pivots), and it lies outside the span exactly when the
+// second part is non-zero.
+void KeyGenerator::invertibleMod(int n, int p, uint8_t* m) {
+    // Multiplicative inverses mod 13 (and mod 2, where only 1 occurs)
+    static const uint8_t INVERSE[13] = {0, 1, 7, 9, 10, 8, 11, 2, 5, 3, 4, 6, 12};
+    uint8_t basis[MAX_GENERATED_SIZE][MAX_GENERATED_SIZE];
+    bool pivot[MAX_GENERATED_SIZE] = {false};
+
+    for (int i = 0; i < n; i++) {
+        uint8_t* u = basis[i];
+        bool nonzero;
+        do {
+            nonzero = false;
+            for (int j = 0; j < n; j++) {
+                u[j] = pivot[j] ? 0 : uint8_t(below(p));
+                if (u[j]) nonzero = true;
+            }
+            if (!nonzero) redrawCount++;
+        } while (!nonzero);
+
+        uint8_t* row = m + i * n;
+        for (int j = 0; j < n; j++) row[j] = u[j];
+        for (int k = 0; k < i; k++) {
+            uint32_t c = below(p);
+            if (!c) continue;
+            for (int j = 0; j < n; j++) row[j] = uint8_t((row[j] + c * basis[k][j]) % p);
+        }
+
+        // Normalise u on its first non-zero column and clear that column
+        // from the earlier rows
+        int col = 0;
+        while (!u[col]) col++;
+        uint8_t scale = INVERSE[u[col]];
+        for (int j = 0; j < n; j++) u[j] = uint8_t(u[j] * scale % p);
+        for (int k = 0; k < i; k++) {
+            uint8_t f = basis[k][col];
+            if (!f) continue;
+            for (int j = 0; j < n; j++) basis[k][j] = uint8_t((basis[k][j] + (p - f) * u[j]) % p);
+        }
+        pivot[col] = true;
+    }
+}
+
+void KeyGenerator::next(int n, uint8_t* out) {
+    if (n < 1 || n > MAX_GENERATED_SIZE) {
+        throw runtime_error("Key size must be between 1 and " + to_string(MAX_GENERATED_SIZE));
+    }
+    uint8_t mod2[MAX_GENERATED_SIZE * MAX_GENERATED_SIZE];
+    invertibleMod(n, 2, mod2);
+    invertibleMod(n, 13, out);
+
+    // CRT: the residue mod 13 or that plus 13, whichever has the right parity
+    for (int i = 0; i < n * n; i++) {
+        if ((out[i] & 1) != mod2[i]) out[i] += 13;
+    }
+    keyCount++;
+}
+
+vector<vector<int>> KeyGenerator::next(int n) {
+    vector<uint8_t> flat(n > 0 ? n * n : 0);
+    next(n, flat.data());
+    vector<vector<int>> key(n, vector<int>(n));
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++) key[i][j] = flat[i * n + j];
+    return key;
+}
+
+void KeyGenerator::bulk(int n, size_t count, uint64_t seed, uint8_t* out, ThreadPool* pool) {
+    size_t chunks = (count + BULK_CHUNK_KEYS - 1) / BULK_CHUNK_KEYS;
+    size_t per_key = size_t(n) * n;
+    auto chunk = [&](size_t c) {
+        uint64_t mix = seed + c;
+        KeyGenerator generator(splitmix64(mix));
+        size_t first = c * BULK_CHUNK_KEYS;
+        size_t last = min(count, first + BULK_CHUNK_KEYS);
+        for (size_t k = first; k < last; k++) {
+            generator.next(n, out + k * per_key);
+        }
+    };
+    if (pool) {
+        pool->run(chunks, chunk);
+    } else {
+        for (size_t c = 0; c < chunks; c++) chunk(c);
+    }
+}
+
+/* ---------- KEY SPACE ---------- */
+// |GL(n, p)| = prod (p^n - p^i) = p^(n*n) * prod (1 - p^(i - n))
+double KeyGenerator::keySpaceBits(int n) {
+    double bits = 0;
+    for (int p : {2, 13}) {
+        for (int i = 0; i < n; i++) {
+            bits += n * log2(double(p)) + log2(1 - pow(double(p), i - n));
+        }
+    }
+    return bits;
+}
+
+double KeyGenerator::invertibleFraction(int n) {
+    double fraction = 1;
+    for (int p : {2, 13}) {
+        for (int i = 0; i < n; i++) fraction *= 1 - pow(double(p), i - n);
+    }
+    return fraction;
+}
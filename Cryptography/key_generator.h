@@ -0,0 +1,54 @@
+#ifndef KEY_GENERATOR_H
+#define KEY_GENERATOR_H
+
+#include "hill_parallel.h"
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Uniformly random Hill keys, invertible mod 26 by construction.
+//
+// A matrix is invertible mod 26 exactly when it is invertible mod 2 and mod
+// 13, and by CRT every pair of such matrices gives a different key, so a
+// uniform key is a uniform invertible matrix mod 2 joined with one mod 13.
+// Each of those is built row by row: a new row is a random combination of
+// the rows so far plus a random part outside their span, which is never
+// zero. Only that outside part is ever redrawn (when it comes out all zero),
+// never the whole matrix.
+class KeyGenerator {
+public:
+    // Same seed, same keys
+    explicit KeyGenerator(uint64_t seed = randomSeed());
+
+    // Random n x n key, entries 0..25
+    std::vector<std::vector<int>> next(int n);
+
+    // Same, into a caller buffer of n*n bytes, row-major; n <= 64
+    void next(int n, uint8_t* out);
+
+    // count keys of n*n bytes each into out. The result depends only on
+    // the seed, not on how many threads share the work.
+    static void bulk(int n, size_t count, uint64_t seed, uint8_t* out, ThreadPool* pool = nullptr);
+
+    uint64_t generated() const { return keyCount; }
+    uint64_t redraws() const { return redrawCount; }
+
+    static uint64_t randomSeed();
+
+    // Number of invertible n x n matrices mod 26, as log2 (key space bits)
+    static double keySpaceBits(int n);
+
+    // Share of all n x n matrices mod 26 that are invertible
+    static double invertibleFraction(int n);
+
+private:
+    uint64_t next64();
+    uint32_t below(uint32_t bound);
+    void invertibleMod(int n, int p, uint8_t* m);
+
+    uint64_t state[4];
+    uint64_t keyCount;
+    uint64_t redrawCount;
+};
+
+#endif
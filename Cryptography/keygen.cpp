@@ -0,0 +1,119 @@
+#include "key_generator.h"
+#include "matrix_utils.h"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <string>
+
+using namespace std;
+using namespace chrono;
+
+/* ---------- OUTPUT ---------- */
+// "a b c; d e f; g h i", the format --key accepts
+void writeKey(ostream& out, const uint8_t* key, int n) {
+    for (int i = 0; i < n; i++) {
+        if (i) out << "; ";
+        for (int j = 0; j < n; j++) {
+            if (j) out << ' ';
+            out << int(key[i * n + j]);
+        }
+    }
+    out << '\n';
+}
+
+/* ---------- MAIN ---------- */
+// Random invertible keys:
+//   keygen                        one 3x3 key, for --key "$(keygen)"
+//   keygen --count N --out FILE   bulk, one key per line (or raw bytes)
+int main(int argc, char* argv[]) {
+    int n = 3;
+    size_t count = 1;
+    uint64_t seed = KeyGenerator::randomSeed();
+    unsigned threads = 1;
+    string out_path;
+    bool binary = false, stats = false, check = false;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            string arg = argv[i];
+            if (arg == "--size" && i + 1 < argc) {
+                n = stoi(argv[++i]);
+            } else if (arg == "--count" && i + 1 < argc) {
+                count = stoull(argv[++i]);
+            } else if (arg == "--seed" && i + 1 < argc) {
+                seed = stoull(argv[++i]);
+            } else if (arg == "--threads" && i + 1 < argc) {
+                threads = stoul(argv[++i]);
+            } else if (arg == "--out" && i + 1 < argc) {
+                out_path = argv[++i];
+            } else if (arg == "--binary") {
+                binary = true;
+            } else if (arg == "--stats") {
+                stats = true;
+            } else if (arg == "--check") {
+                check = true;
+            } else {
+                cerr << "Usage: keygen [--size n] [--count N] [--seed S] [--threads n (0 = all cores)]\n"
+                     << "       [--out FILE] [--binary] [--stats] [--check]\n";
+                return 2;
+            }
+        }
+        if (n < 1 || n > 64) throw runtime_error("Key size must be between 1 and 64");
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 2;
+    }
+
+    try {
+        ThreadPool pool(threads);
+        size_t per_key = size_t(n) * n;
+        vector<uint8_t> keys(count * per_key);
+
+        auto start = steady_clock::now();
+        KeyGenerator::bulk(n, count, seed, keys.data(), &pool);
+        double seconds = duration<double>(steady_clock::now() - start).count();
+
+        // Independent check of every key with the matrix library
+        size_t bad = 0;
+        if (check) {
+            vector<vector<int>> matrix(n, vector<int>(n));
+            for (size_t k = 0; k < count; k++) {
+                for (int i = 0; i < n; i++)
+                    for (int j = 0; j < n; j++) matrix[i][j] = keys[k * per_key + i * n + j];
+                if (!MatrixUtils::isInvertible(matrix)) bad++;
+            }
+        }
+
+        ofstream file;
+        if (!out_path.empty()) {
+            file.open(out_path, binary ? ios::binary : ios::out);
+            if (!file) throw runtime_error("Cannot open " + out_path + " for writing");
+        }
+        ostream& out = out_path.empty() ? cout : file;
+        if (binary) {
+            out.write(reinterpret_cast<const char*>(keys.data()), keys.size());
+        } else {
+            for (size_t k = 0; k < count; k++) writeKey(out, keys.data() + k * per_key, n);
+        }
+        out.flush();
+
+        if (stats) {
+            cerr << "Generated " << count << " " << n << "x" << n << " keys in " << fixed
+                 << setprecision(3) << seconds * 1e3 << " ms ("
+                 << setprecision(0) << count / max(seconds, 1e-9) << " keys/s, "
+                 << pool.size() << " threads, seed " << seed << ")\n";
+            cerr << "Key space: 2^" << setprecision(1) << KeyGenerator::keySpaceBits(n)
+                 << " invertible keys, " << setprecision(2)
+                 << KeyGenerator::invertibleFraction(n) * 100 << "% of all " << n << "x" << n
+                 << " matrices mod 26\n";
+            if (check) cerr << "Checked: " << count - bad << " invertible, " << bad << " not\n";
+        }
+        if (bad) return 1;
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include "mapped_file.h"
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+MappedFile::MappedFile() : fd(-1), base(nullptr), length(0), writable(false) {
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#ifndef _WIN32
+bool MappedFile::mapFile(int file, size_t size, bool write) {
+    fd = file;
+    length = size;
+    writable = write;
+    if (size == 0) {
+        // mmap rejects empty ranges; an open file with no data is still valid
+        return true;
+    }
+
+    int prot = write ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    void* p = mmap(nullptr, size, prot, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        ::close(fd);
+        fd = -1;
+        length = 0;
+        return false;
+    }
+    base = static_cast<char*>(p);
+    return true;
+}
+
+static bool regularFileSize(int fd, size_t& size) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    size = st.st_size;
+    return true;
+}
+
+bool MappedFile::openRead(const string& path) {
+    close();
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) return false;
+    size_t size;
+    if (!regularFileSize(file, size)) {
+        ::close(file);
+        return false;
+    }
+    return mapFile(file, size, false);
+}
+
+bool MappedFile::openReadWrite(const string& path) {
+    close();
+    int file = ::open(path.c_str(), O_RDWR);
+    if (file < 0) return false;
+    size_t size;
+    if (!regularFileSize(file, size)) {
+        ::close(file);
+        return false;
+    }
+    return mapFile(file, size, true);
+}
+
+bool MappedFile::create(const string& path, size_t size) {
+    close();
+    int file = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file < 0) return false;
+    size_t existing;
+    if (!regularFileSize(file, existing)) {
+        ::close(file);
+        return false;
+    }
+    if (ftruncate(file, size) != 0) {
+        ::close(file);
+        throw runtime_error("Cannot size output file " + path);
+    }
+    return mapFile(file, size, true);
+}
+
+void MappedFile::adviseSequential() {
+    if (base) {
+        madvise(base, length, MADV_SEQUENTIAL);
+    }
+}
+
+void MappedFile::close(size_t finalSize) {
+    if (fd < 0) return;
+    if (base) {
+        munmap(base, length);
+    }
+    if (writable && finalSize < length) {
+        if (ftruncate(fd, finalSize) != 0) {
+            ::close(fd);
+            fd = -1;
+            base = nullptr;
+            throw runtime_error("Cannot trim mapped file");
+        }
+    }
+    ::close(fd);
+    fd = -1;
+    base = nullptr;
+    length = 0;
+}
+#else
+// No mmap: every open fails and callers use buffered I/O instead
+bool MappedFile::mapFile(int, size_t, bool) { return false; }
+bool MappedFile::openRead(const string&) { return false; }
+bool MappedFile::openReadWrite(const string&) { return false; }
+bool MappedFile::create(const string&, size_t) { return false; }
+void MappedFile::adviseSequential() {}
+void MappedFile::close(size_t) {}
+#endif
@@ -0,0 +1,47 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+
+// Memory-mapped file (POSIX mmap). The open calls return false when the path
+// cannot be mapped -- pipes, character devices, or platforms without mmap --
+// so callers can fall back to buffered I/O.
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Map an existing regular file read-only
+    bool openRead(const std::string& path);
+
+    // Map an existing regular file read-write, for in-place transforms
+    bool openReadWrite(const std::string& path);
+
+    // Create (or truncate) a file of exactly `size` bytes and map it read-write
+    bool create(const std::string& path, size_t size);
+
+    // Hint that the mapping will be read front to back
+    void adviseSequential();
+
+    // Unmap, trimming the file to finalSize bytes if it is smaller
+    void close(size_t finalSize = size_t(-1));
+
+    char* data() { return base; }
+    const char* data() const { return base; }
+    size_t size() const { return length; }
+    bool isOpen() const { return fd >= 0; }
+
+private:
+    bool mapFile(int fd, size_t size, bool writable);
+
+    int fd;
+    char* base;
+    size_t length;
+    bool writable;
+};
+
+#endif
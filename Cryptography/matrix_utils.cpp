@@ -1,48 +1,221 @@
 #include "matrix_utils.h"
+#include "hill_normalize.h"
 #include <iostream>
 #include <algorithm>
-#include <cctype>
+#include <cstdint>
 
 using namespace std;
 
-// Modular inverse using brute force
-int MatrixUtils::modInverse(int a, int m) {
-    a = a % m;
-    for (int x = 1; x < m; x++) {
-        if ((a * x) % m == 1) {
-            return x;
+/* ---------- MODULAR ARITHMETIC HELPERS ---------- */
+typedef vector<vector<int64_t>> Matrix64;
+
+// Reduce into [0, m)
+static inline int64_t normalize(int64_t a, int64_t m) {
+    a %= m;
+    return a < 0 ? a + m : a;
+}
+
+// Operands are below 2^31, so the product always fits in 64 bits
+static inline int64_t mulMod(int64_t a, int64_t b, int64_t m) {
+    return (a * b) % m;
+}
+
+// Prime-power factors of m, e.g. 26 -> {2, 13}, 72 -> {8, 9}, with their primes
+static vector<pair<int64_t, int64_t>> primePowerFactors(int64_t m) {
+    vector<pair<int64_t, int64_t>> factors;
+    for (int64_t p = 2; p * p <= m; p++) {
+        if (m % p != 0) continue;
+        int64_t q = 1;
+        while (m % p == 0) {
+            m /= p;
+            q *= p;
         }
+        factors.push_back({p, q});
     }
-    throw runtime_error("Modular inverse does not exist");
+    if (m > 1) factors.push_back({m, m});
+    return factors;
 }
 
-// Determinant for 1x1, 2x2, and 3x3 matrices
-int MatrixUtils::determinant(const vector<vector<int>>& matrix) {
+static Matrix64 reducedCopy(const vector<vector<int>>& matrix, int64_t m) {
     int n = matrix.size();
-    
-    if (n == 1) {
-        return matrix[0][0];
+    Matrix64 a(n, vector<int64_t>(n));
+    for (int i = 0; i < n; i++) {
+        if ((int)matrix[i].size() != n) {
+            throw runtime_error("Matrix must be square");
+        }
+        for (int j = 0; j < n; j++) {
+            a[i][j] = normalize(matrix[i][j], m);
+        }
     }
-    
-    if (n == 2) {
-        int det = matrix[0][0] * matrix[1][1] - matrix[0][1] * matrix[1][0];
-        return ((det % 26) + 26) % 26;
+    return a;
+}
+
+// Determinant modulo a prime power q = p^e by elimination. A column with no
+// unit pivot is divisible by p: p is factored out and the rest of the
+// computation only needs precision p^(e-1).
+static int64_t determinantPrimePower(const vector<vector<int>>& matrix, int64_t p, int64_t q) {
+    const int64_t full = q;
+    int n = matrix.size();
+    Matrix64 a = reducedCopy(matrix, q);
+    int64_t det = 1;
+    int64_t factored = 1;   // power of p pulled out of columns
+
+    for (int c = 0; c < n; c++) {
+        int pivot = -1;
+        while (true) {
+            for (int r = c; r < n; r++) {
+                if (a[r][c] % p != 0) {
+                    pivot = r;
+                    break;
+                }
+            }
+            if (pivot >= 0) break;
+            if (q == p) return 0;
+            for (int r = c; r < n; r++) {
+                a[r][c] /= p;
+            }
+            factored *= p;
+            q /= p;
+            det %= q;
+            for (int r = c; r < n; r++)
+                for (int j = c; j < n; j++) a[r][j] %= q;
+        }
+
+        if (pivot != c) {
+            swap(a[pivot], a[c]);
+            det = q - det;
+        }
+        det = mulMod(det, a[c][c], q);
+
+        int64_t inv = MatrixUtils::modInverse(a[c][c], q);
+        for (int r = c + 1; r < n; r++) {
+            if (a[r][c] == 0) continue;
+            int64_t g = q - mulMod(a[r][c], inv, q);
+            for (int j = c; j < n; j++) {
+                a[r][j] = (a[r][j] + g * a[c][j]) % q;
+            }
+        }
     }
-    
-    if (n == 3) {
-        int det = 
-            matrix[0][0] * (matrix[1][1] * matrix[2][2] - matrix[1][2] * matrix[2][1]) -
-            matrix[0][1] * (matrix[1][0] * matrix[2][2] - matrix[1][2] * matrix[2][0]) +
-            matrix[0][2] * (matrix[1][0] * matrix[2][1] - matrix[1][1] * matrix[2][0]);
-        
-        return ((det % 26) + 26) % 26;
+    return mulMod(factored, det % q, full);
+}
+
+// Gauss-Jordan inverse modulo a prime power q = p^e. Invertible exactly when
+// every column has a pivot that is a unit (not divisible by p).
+static Matrix64 inversePrimePower(const vector<vector<int>>& matrix, int64_t p, int64_t q) {
+    int n = matrix.size();
+    Matrix64 a = reducedCopy(matrix, q);
+    Matrix64 inv(n, vector<int64_t>(n, 0));
+    for (int i = 0; i < n; i++) inv[i][i] = 1;
+
+    for (int c = 0; c < n; c++) {
+        int pivot = -1;
+        for (int r = c; r < n; r++) {
+            if (a[r][c] % p != 0) {
+                pivot = r;
+                break;
+            }
+        }
+        if (pivot < 0) {
+            throw runtime_error("Matrix is not invertible modulo " + to_string(q));
+        }
+        swap(a[pivot], a[c]);
+        swap(inv[pivot], inv[c]);
+
+        // Scale the pivot row to 1
+        int64_t s = MatrixUtils::modInverse(a[c][c], q);
+        for (int j = 0; j < n; j++) {
+            a[c][j] = mulMod(a[c][j], s, q);
+            inv[c][j] = mulMod(inv[c][j], s, q);
+        }
+
+        // Clear the column everywhere else: row_r += (q - f) * row_c keeps
+        // every term non-negative, so one reduction per entry is enough
+        for (int r = 0; r < n; r++) {
+            if (r == c || a[r][c] == 0) continue;
+            int64_t g = q - a[r][c];
+            for (int j = c; j < n; j++) {
+                a[r][j] = (a[r][j] + g * a[c][j]) % q;
+            }
+            for (int j = 0; j < n; j++) {
+                inv[r][j] = (inv[r][j] + g * inv[c][j]) % q;
+            }
+        }
     }
-    
-    throw runtime_error("Matrix size not supported (only 1x1, 2x2, 3x3)");
+    return inv;
+}
+
+// Combine x = r1 (mod m1) and x = r2 (mod m2) for coprime m1, m2
+static int64_t crtCombine(int64_t r1, int64_t m1, int64_t r2, int64_t m2) {
+    int64_t t = mulMod(normalize(r2 - r1, m2), MatrixUtils::modInverse(m1 % m2, m2), m2);
+    return r1 + m1 * t;
+}
+
+static void checkModulus(int mod) {
+    if (mod < 2) {
+        throw runtime_error("Modulus must be at least 2");
+    }
+}
+
+/* ---------- MATRIX OPERATIONS ---------- */
+// Modular inverse using the extended Euclidean algorithm
+int MatrixUtils::modInverse(int a, int m) {
+    return int(modInverse(int64_t(a), int64_t(m)));
 }
 
-// Adjugate matrix calculation (FIXED - now returns correct adjugate)
-vector<vector<int>> MatrixUtils::adjugate(const vector<vector<int>>& matrix) {
+int64_t MatrixUtils::modInverse(int64_t a, int64_t m) {
+    int64_t old_r = normalize(a, m), r = m;
+    int64_t old_s = 1, s = 0;
+    while (r != 0) {
+        int64_t q = old_r / r;
+        int64_t t = old_r - q * r; old_r = r; r = t;
+        t = old_s - q * s; old_s = s; s = t;
+    }
+    if (old_r != 1) {
+        throw runtime_error("Modular inverse does not exist");
+    }
+    return normalize(old_s, m);
+}
+
+// Determinant modulo mod. 2x2 and 3x3 use the direct formulas; larger
+// matrices are reduced by elimination per prime-power factor of mod and
+// recombined with the CRT, O(n^3) in total.
+int MatrixUtils::determinant(const vector<vector<int>>& matrix, int mod) {
+    checkModulus(mod);
+    int n = matrix.size();
+    if (n == 0) {
+        throw runtime_error("Matrix is empty");
+    }
+
+    // Direct formulas stay within 64 bits for moduli up to 2^20
+    if (n <= 3 && mod <= (1 << 20)) {
+        Matrix64 m = reducedCopy(matrix, mod);
+        int64_t det;
+        if (n == 1) {
+            det = m[0][0];
+        } else if (n == 2) {
+            det = m[0][0] * m[1][1] - m[0][1] * m[1][0];
+        } else {
+            det =
+                m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+                m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+                m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+        }
+        return int(normalize(det, mod));
+    }
+
+    int64_t result = 0, modulus = 1;
+    for (auto& f : primePowerFactors(mod)) {
+        int64_t d = determinantPrimePower(matrix, f.first, f.second);
+        result = crtCombine(result, modulus, d, f.second);
+        modulus *= f.second;
+    }
+    return int(result);
+}
+
+// Adjugate matrix modulo mod. Cofactor formulas for up to 3x3; larger
+// matrices use adj(K) = det(K) * K^-1, so they must be invertible.
+vector<vector<int>> MatrixUtils::adjugate(const vector<vector<int>>& matrix, int mod) {
+    checkModulus(mod);
     int n = matrix.size();
     
     if (n == 1) {
@@ -51,65 +224,101 @@ vector<vector<int>> MatrixUtils::adjugate(const vector<vector<int>>& matrix) {
     
     if (n == 2) {
         vector<vector<int>> adj(2, vector<int>(2, 0));
-        adj[0][0] = matrix[1][1];
-        adj[0][1] = (-matrix[0][1] + 26) % 26;
-        adj[1][0] = (-matrix[1][0] + 26) % 26;
-        adj[1][1] = matrix[0][0];
+        adj[0][0] = int(normalize(matrix[1][1], mod));
+        adj[0][1] = int(normalize(-int64_t(matrix[0][1]), mod));
+        adj[1][0] = int(normalize(-int64_t(matrix[1][0]), mod));
+        adj[1][1] = int(normalize(matrix[0][0], mod));
         return adj;
     }
     
-    if (n == 3) {
+    if (n == 3 && mod <= (1 << 20)) {
+        Matrix64 m = reducedCopy(matrix, mod);
         vector<vector<int>> adj(3, vector<int>(3, 0));
         // Calculate cofactor matrix first
-        vector<vector<int>> cofactor(3, vector<int>(3, 0));
+        int64_t cofactor[3][3];
         
-        cofactor[0][0] = (matrix[1][1] * matrix[2][2] - matrix[1][2] * matrix[2][1]);
-        cofactor[0][1] = -(matrix[1][0] * matrix[2][2] - matrix[1][2] * matrix[2][0]);
-        cofactor[0][2] = (matrix[1][0] * matrix[2][1] - matrix[1][1] * matrix[2][0]);
+        cofactor[0][0] = (m[1][1] * m[2][2] - m[1][2] * m[2][1]);
+        cofactor[0][1] = -(m[1][0] * m[2][2] - m[1][2] * m[2][0]);
+        cofactor[0][2] = (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
         
-        cofactor[1][0] = -(matrix[0][1] * matrix[2][2] - matrix[0][2] * matrix[2][1]);
-        cofactor[1][1] = (matrix[0][0] * matrix[2][2] - matrix[0][2] * matrix[2][0]);
-        cofactor[1][2] = -(matrix[0][0] * matrix[2][1] - matrix[0][1] * matrix[2][0]);
+        cofactor[1][0] = -(m[0][1] * m[2][2] - m[0][2] * m[2][1]);
+        cofactor[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]);
+        cofactor[1][2] = -(m[0][0] * m[2][1] - m[0][1] * m[2][0]);
         
-        cofactor[2][0] = (matrix[0][1] * matrix[1][2] - matrix[0][2] * matrix[1][1]);
-        cofactor[2][1] = -(matrix[0][0] * matrix[1][2] - matrix[0][2] * matrix[1][0]);
-        cofactor[2][2] = (matrix[0][0] * matrix[1][1] - matrix[0][1] * matrix[1][0]);
+        cofactor[2][0] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]);
+        cofactor[2][1] = -(m[0][0] * m[1][2] - m[0][2] * m[1][0]);
+        cofactor[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]);
         
         // Transpose to get adjugate
         for (int i = 0; i < 3; i++) {
             for (int j = 0; j < 3; j++) {
-                adj[i][j] = ((cofactor[j][i] % 26) + 26) % 26;
+                adj[i][j] = int(normalize(cofactor[j][i], mod));
             }
         }
         
         return adj;
     }
     
-    throw runtime_error("Matrix size not supported");
+    if (!isInvertible(matrix, mod)) {
+        throw runtime_error("Adjugate of a non-invertible matrix is only supported up to 3x3");
+    }
+    int64_t det = determinant(matrix, mod);
+    vector<vector<int>> adj = inverseMatrix(matrix, mod);
+    for (auto& row : adj) {
+        for (int& x : row) {
+            x = int(mulMod(x, det, mod));
+        }
+    }
+    return adj;
 }
 
-// Inverse matrix calculation
-vector<vector<int>> MatrixUtils::inverseMatrix(const vector<vector<int>>& matrix) {
-    int det = determinant(matrix);
-    
-    if (det == 0) {
-        throw runtime_error("Matrix is not invertible (determinant is 0)");
+// Invertible modulo mod when the determinant is coprime to mod, i.e. it is
+// a unit modulo every prime factor
+bool MatrixUtils::isInvertible(const vector<vector<int>>& matrix, int mod) {
+    int64_t det = determinant(matrix, mod);
+    int64_t a = det, b = mod;
+    while (b != 0) {
+        int64_t t = a % b;
+        a = b;
+        b = t;
     }
-    
-    int detInv = modInverse(det, 26);
-    vector<vector<int>> adj = adjugate(matrix);
-    
+    return a == 1;
+}
+
+// Inverse matrix modulo mod: Gauss-Jordan elimination modulo each prime-power
+// factor (2 and 13 for the alphabet), recombined entry by entry with the CRT
+vector<vector<int>> MatrixUtils::inverseMatrix(const vector<vector<int>>& matrix, int mod) {
+    checkModulus(mod);
     int n = matrix.size();
-    vector<vector<int>> inverse(n, vector<int>(n, 0));
-    
+    if (n == 0) {
+        throw runtime_error("Matrix is empty");
+    }
+
+    vector<vector<int64_t>> inverse(n, vector<int64_t>(n, 0));
+    int64_t modulus = 1;
+    for (auto& f : primePowerFactors(mod)) {
+        Matrix64 part;
+        try {
+            part = inversePrimePower(matrix, f.first, f.second);
+        } catch (const runtime_error&) {
+            throw runtime_error("Matrix is not invertible modulo " + to_string(mod) +
+                                " (determinant shares a factor with " + to_string(mod) + ")");
+        }
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                inverse[i][j] = crtCombine(inverse[i][j], modulus, part[i][j], f.second);
+            }
+        }
+        modulus *= f.second;
+    }
+
+    vector<vector<int>> result(n, vector<int>(n));
     for (int i = 0; i < n; i++) {
         for (int j = 0; j < n; j++) {
-            inverse[i][j] = (adj[i][j] * detInv) % 26;
-            if (inverse[i][j] < 0) inverse[i][j] += 26;
+            result[i][j] = int(inverse[i][j]);
         }
     }
-    
-    return inverse;
+    return result;
 }
 
 // Matrix-vector multiplication modulo mod
@@ -129,16 +338,27 @@ vector<int> MatrixUtils::multiplyMatrixVector(const vector<vector<int>>& matrix,
     return result;
 }
 
+void MatrixUtils::multiplyMatrixVector(const int* matrix, int n, const int* vec, int* out, int mod) {
+    for (int i = 0; i < n; i++) {
+        const int* row = matrix + i * n;
+        int sum = 0;
+        for (int j = 0; j < n; j++) {
+            sum += row[j] * vec[j];
+        }
+        out[i] = ((sum % mod) + mod) % mod;
+    }
+}
+
 // String to vector conversion (A=0, B=1, ..., Z=25) - UPDATED for spaces
 vector<int> MatrixUtils::stringToVector(const string& str, bool includeSpaces) {
-    vector<int> vec;
-    vec.reserve(str.length());
-    
-    for (char c : str) {
-        if (isalpha(c)) {
-            vec.push_back(toupper(c) - 'A');
-        } else if (c == ' ' && includeSpaces) {
-            vec.push_back(-1); // Use -1 to represent space
+    // Every accepted byte becomes one entry, so one pass fills the result
+    vector<int> vec(str.size());
+    for (size_t i = 0; i < str.size(); i++) {
+        uint8_t v = letterIndex(str[i]);
+        if (v != NOT_A_LETTER) {
+            vec[i] = v;
+        } else if (str[i] == ' ' && includeSpaces) {
+            vec[i] = -1; // Use -1 to represent space
         } else {
             throw runtime_error("Invalid character in message. Only letters and spaces allowed.");
         }
@@ -163,38 +383,26 @@ string MatrixUtils::vectorToString(const vector<int>& vec) {
 
 // Pad string with 'X' to make length multiple of blockSize - UPDATED for spaces
 string MatrixUtils::padString(const string& str, int blockSize, bool preserveSpaces) {
-    string processed = str;
-    
-    // Convert to uppercase
-    transform(processed.begin(), processed.end(), processed.begin(), ::toupper);
-    
-    // Remove non-alphabetic characters (except spaces if preserveSpaces is true)
+    // Upper-case the letters, drop everything else (except spaces if
+    // preserveSpaces is true) and count letters for the padding, in one pass
     string cleanStr;
-    for (char c : processed) {
-        if (isalpha(c) || (c == ' ' && preserveSpaces)) {
-            cleanStr.push_back(c);
+    cleanStr.reserve(str.length() + blockSize);
+    size_t letters = 0;
+    for (char c : str) {
+        uint8_t v = letterIndex(c);
+        if (v != NOT_A_LETTER) {
+            cleanStr.push_back(char('A' + v));
+            letters++;
+        } else if (c == ' ' && preserveSpaces) {
+            cleanStr.push_back(' ');
         }
     }
     
-    // If preserving spaces, count only letters for block alignment
-    if (preserveSpaces) {
-        string lettersOnly;
-        for (char c : cleanStr) {
-            if (isalpha(c)) lettersOnly.push_back(c);
-        }
-        
-        int remainder = lettersOnly.length() % blockSize;
-        if (remainder != 0) {
-            int paddingNeeded = blockSize - remainder;
-            cleanStr.append(paddingNeeded, 'X');
-        }
-    } else {
-        // Original logic without spaces
-        int remainder = cleanStr.length() % blockSize;
-        if (remainder != 0) {
-            int paddingNeeded = blockSize - remainder;
-            cleanStr.append(paddingNeeded, 'X');
-        }
+    // Only letters count for block alignment
+    int remainder = letters % blockSize;
+    if (remainder != 0) {
+        int paddingNeeded = blockSize - remainder;
+        cleanStr.append(paddingNeeded, 'X');
     }
     
     return cleanStr;
@@ -218,8 +426,9 @@ vector<int> MatrixUtils::extractAlphaBlock(const string& str, int start, int blo
     int count = 0;
     
     for (size_t i = start; i < str.length() && count < blockSize; i++) {
-        if (isalpha(str[i])) {
-            block.push_back(toupper(str[i]) - 'A');
+        uint8_t v = letterIndex(str[i]);
+        if (v != NOT_A_LETTER) {
+            block.push_back(v);
             count++;
         }
     }
@@ -234,9 +443,5 @@ vector<int> MatrixUtils::extractAlphaBlock(const string& str, int start, int blo
 
 // NEW: Count alphabetic characters in string
 int MatrixUtils::countAlpha(const string& str) {
-    int count = 0;
-    for (char c : str) {
-        if (isalpha(c)) count++;
-    }
-    return count;
+    return countText(str.data(), str.size()).letters;
 }
@@ -4,6 +4,7 @@
 #include <vector>
 #include <string>
 #include <stdexcept>
+#include <cstdint>
 
 class MatrixUtils {
 public:
@@ -12,17 +13,25 @@ public:
                                                  const std::vector<int>& vector, 
                                                  int mod = 26);
     
-    // Calculate modular inverse of a number modulo 26
+    // Flat row-major variant: out = matrix * vec, n entries, no allocation
+    // (out must not alias vec)
+    static void multiplyMatrixVector(const int* matrix, int n, const int* vec, int* out, int mod = 26);
+    
+    // Calculate modular inverse of a number modulo m (extended Euclid)
     static int modInverse(int a, int m = 26);
+    static int64_t modInverse(int64_t a, int64_t m);
+    
+    // Calculate determinant of an n x n matrix modulo mod
+    static int determinant(const std::vector<std::vector<int>>& matrix, int mod = 26);
     
-    // Calculate determinant of a matrix
-    static int determinant(const std::vector<std::vector<int>>& matrix);
+    // Calculate adjugate of a matrix modulo mod
+    static std::vector<std::vector<int>> adjugate(const std::vector<std::vector<int>>& matrix, int mod = 26);
     
-    // Calculate adjugate of a matrix
-    static std::vector<std::vector<int>> adjugate(const std::vector<std::vector<int>>& matrix);
+    // Check whether a matrix is invertible modulo mod (det coprime to mod)
+    static bool isInvertible(const std::vector<std::vector<int>>& matrix, int mod = 26);
     
-    // Calculate modular inverse of a matrix
-    static std::vector<std::vector<int>> inverseMatrix(const std::vector<std::vector<int>>& matrix);
+    // Calculate modular inverse of an n x n matrix (elimination + CRT)
+    static std::vector<std::vector<int>> inverseMatrix(const std::vector<std::vector<int>>& matrix, int mod = 26);
     
     // Convert string to vector of integers (A=0, B=1, ..., Z=25)
     static std::vector<int> stringToVector(const std::string& str, bool includeSpaces = false);
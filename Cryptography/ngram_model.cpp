@@ -0,0 +1,174 @@
+#include "ngram_model.h"
+#include "hill_kernel.h"
+#include "hill_normalize.h"
+#include <cmath>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define NGRAM_MODEL_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+/* ---------- ENGLISH STATISTICS ---------- */
+// Percent of letters, A..Z
+static const double LETTER_PERCENT[26] = {
+    8.17, 1.29, 2.78, 4.25, 12.70, 2.23, 2.02, 6.09, 6.97, 0.15, 0.77, 4.03, 2.41,
+    6.75, 7.51, 1.93, 0.10, 5.99, 6.33, 9.06, 2.76, 0.98, 2.36, 0.15, 1.97, 0.07
+};
+
+struct NgramPercent {
+    const char* text;
+    double percent;
+};
+
+// Most frequent bigrams, percent of all bigrams
+static const NgramPercent BIGRAM_PERCENT[] = {
+    {"TH", 3.56}, {"HE", 3.07}, {"IN", 2.43}, {"ER", 2.05}, {"AN", 1.99}, {"RE", 1.85},
+    {"ON", 1.76}, {"AT", 1.49}, {"EN", 1.45}, {"ND", 1.35}, {"TI", 1.34}, {"ES", 1.34},
+    {"OR", 1.28}, {"TE", 1.20}, {"OF", 1.17}, {"ED", 1.17}, {"IS", 1.13}, {"IT", 1.12},
+    {"AL", 1.09}, {"AR", 1.07}, {"ST", 1.05}, {"TO", 1.04}, {"NT", 1.04}, {"NG", 0.95},
+    {"SE", 0.93}, {"HA", 0.93}, {"AS", 0.87}, {"OU", 0.87}, {"IO", 0.83}, {"LE", 0.83},
+    {"VE", 0.83}, {"CO", 0.79}, {"ME", 0.79}, {"DE", 0.76}, {"HI", 0.76}, {"RI", 0.73},
+    {"RO", 0.73}, {"IC", 0.70}, {"NE", 0.69}, {"EA", 0.69}, {"RA", 0.69}, {"CE", 0.65},
+    {"LI", 0.62}, {"CH", 0.60}, {"LL", 0.58}, {"BE", 0.58}, {"MA", 0.57}, {"SI", 0.55},
+    {"OM", 0.55}, {"UR", 0.54}
+};
+
+// Most frequent trigrams, percent of all trigrams
+static const NgramPercent TRIGRAM_PERCENT[] = {
+    {"THE", 1.81}, {"AND", 0.73}, {"ING", 0.72}, {"ENT", 0.42}, {"ION", 0.42}, {"HER", 0.36},
+    {"FOR", 0.34}, {"THA", 0.33}, {"NTH", 0.33}, {"INT", 0.32}, {"ERE", 0.31}, {"TIO", 0.31},
+    {"TER", 0.30}, {"EST", 0.28}, {"ERS", 0.28}, {"ATI", 0.26}, {"HAT", 0.26}, {"ATE", 0.25},
+    {"ALL", 0.25}, {"ETH", 0.24}, {"HES", 0.24}, {"VER", 0.24}, {"HIS", 0.24}, {"OFT", 0.22},
+    {"ITH", 0.21}, {"FTH", 0.21}, {"STH", 0.21}, {"OTH", 0.21}, {"RES", 0.21}, {"ONT", 0.20}
+};
+
+/* ---------- MODEL ---------- */
+NgramModel::NgramModel() : uni(26), bi(26 * 26), tri(26 * 26 * 26) {
+}
+
+// Listed entries keep their frequency; the rest share the remaining mass in
+// proportion to `estimate`
+static void fillTable(vector<double>& p, const vector<double>& estimate,
+                      const NgramPercent* listed, size_t count) {
+    vector<bool> known(p.size(), false);
+    double listed_mass = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t index = 0;
+        for (const char* c = listed[i].text; *c; c++) index = index * 26 + (*c - 'A');
+        p[index] = listed[i].percent / 100;
+        known[index] = true;
+        listed_mass += p[index];
+    }
+    double other_mass = 0;
+    for (size_t i = 0; i < p.size(); i++) {
+        if (!known[i]) other_mass += estimate[i];
+    }
+    for (size_t i = 0; i < p.size(); i++) {
+        if (!known[i]) p[i] = estimate[i] * (1 - listed_mass) / other_mass;
+    }
+}
+
+const NgramModel& NgramModel::english() {
+    static const NgramModel model = [] {
+        NgramModel m;
+        vector<double> p1(26), p2(26 * 26), p3(26 * 26 * 26);
+        for (int a = 0; a < 26; a++) p1[a] = LETTER_PERCENT[a] / 100;
+
+        // Bigrams not listed: as if the two letters were independent
+        vector<double> estimate2(26 * 26);
+        for (int a = 0; a < 26; a++)
+            for (int b = 0; b < 26; b++) estimate2[a * 26 + b] = p1[a] * p1[b];
+        fillTable(p2, estimate2, BIGRAM_PERCENT, sizeof(BIGRAM_PERCENT) / sizeof(BIGRAM_PERCENT[0]));
+
+        // Trigrams not listed: chain the two overlapping bigrams
+        vector<double> estimate3(26 * 26 * 26);
+        for (int a = 0; a < 26; a++)
+            for (int b = 0; b < 26; b++)
+                for (int c = 0; c < 26; c++)
+                    estimate3[(a * 26 + b) * 26 + c] = p2[a * 26 + b] * p2[b * 26 + c] / p1[b];
+        fillTable(p3, estimate3, TRIGRAM_PERCENT, sizeof(TRIGRAM_PERCENT) / sizeof(TRIGRAM_PERCENT[0]));
+
+        for (size_t i = 0; i < p1.size(); i++) m.uni[i] = float(log(p1[i]));
+        for (size_t i = 0; i < p2.size(); i++) m.bi[i] = float(log(p2[i]));
+        for (size_t i = 0; i < p3.size(); i++) m.tri[i] = float(log(p3[i]));
+        return m;
+    }();
+    return model;
+}
+
+NgramModel NgramModel::train(istream& corpus) {
+    vector<double> c1(26, 1), c2(26 * 26, 1), c3(26 * 26 * 26, 1);
+    int prev1 = -1, prev2 = -1;
+    char ch;
+    while (corpus.get(ch)) {
+        int x = letterIndex(ch);
+        if (x == NOT_A_LETTER) continue;
+        c1[x]++;
+        if (prev1 >= 0) c2[prev1 * 26 + x]++;
+        if (prev2 >= 0) c3[(prev2 * 26 + prev1) * 26 + x]++;
+        prev2 = prev1;
+        prev1 = x;
+    }
+
+    NgramModel m;
+    auto normalize = [](const vector<double>& counts, vector<float>& out) {
+        double total = 0;
+        for (double c : counts) total += c;
+        for (size_t i = 0; i < counts.size(); i++) out[i] = float(log(counts[i] / total));
+    };
+    normalize(c1, m.uni);
+    normalize(c2, m.bi);
+    normalize(c3, m.tri);
+    return m;
+}
+
+/* ---------- SCORING ---------- */
+// Trigrams ending at positions first .. len - 1
+static float trigramSumScalar(const float* t, const uint8_t* letters, size_t first, size_t len) {
+    float sum = 0;
+    for (size_t i = first; i < len; i++) {
+        sum += t[(letters[i - 2] * 26 + letters[i - 1]) * 26 + letters[i]];
+    }
+    return sum;
+}
+
+#ifdef NGRAM_MODEL_X86
+// 16 table indices at a time in 16-bit lanes (the largest, 17575, fits),
+// looked up with two 8-lane gathers into separate sums
+__attribute__((target("avx2")))
+static float trigramSumAVX2(const float* t, const uint8_t* letters, size_t len) {
+    const __m256i k676 = _mm256_set1_epi16(676);
+    const __m256i k26 = _mm256_set1_epi16(26);
+    __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+    size_t i = 2;
+    for (; i + 16 <= len; i += 16) {
+        __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(letters + i - 2)));
+        __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(letters + i - 1)));
+        __m256i c = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(letters + i)));
+        __m256i idx = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(a, k676),
+                                                        _mm256_mullo_epi16(b, k26)), c);
+        sum0 = _mm256_add_ps(sum0, _mm256_i32gather_ps(t, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(idx)), 4));
+        sum1 = _mm256_add_ps(sum1, _mm256_i32gather_ps(t, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(idx, 1)), 4));
+    }
+    float lanes[8];
+    _mm256_storeu_ps(lanes, _mm256_add_ps(sum0, sum1));
+    float sum = 0;
+    for (float x : lanes) sum += x;
+    return sum + trigramSumScalar(t, letters, i, len);
+}
+#endif
+
+double NgramModel::score(const uint8_t* letters, size_t len) const {
+    if (len < 3) {
+        double s = 0;
+        for (size_t i = 0; i < len; i++) s += uni[letters[i]];
+        return s;
+    }
+#ifdef NGRAM_MODEL_X86
+    static const bool avx2 = HillKernel::detect() == HillKernel::AVX2;
+    if (avx2) return trigramSumAVX2(tri.data(), letters, len);
+#endif
+    return trigramSumScalar(tri.data(), letters, 2, len);
+}
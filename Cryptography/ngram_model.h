@@ -0,0 +1,42 @@
+#ifndef NGRAM_MODEL_H
+#define NGRAM_MODEL_H
+
+#include <vector>
+#include <string>
+#include <istream>
+#include <cstddef>
+#include <cstdint>
+
+// Log-probability tables (natural log) for letters, bigrams and trigrams,
+// used to score candidate plaintexts. Letters are indices 0..25; every
+// table entry is finite, so unseen n-grams just score low.
+class NgramModel {
+public:
+    // Built-in English model from published letter, bigram and trigram
+    // frequencies; n-grams outside the published lists are estimated from
+    // their parts
+    static const NgramModel& english();
+
+    // Count n-grams in a corpus (letters only, case-insensitive), with
+    // add-one smoothing
+    static NgramModel train(std::istream& corpus);
+
+    float unigram(int a) const { return uni[a]; }
+    float bigram(int a, int b) const { return bi[a * 26 + b]; }
+    float trigram(int a, int b, int c) const { return tri[(a * 26 + b) * 26 + c]; }
+
+    const float* unigrams() const { return uni.data(); }
+    const float* trigrams() const { return tri.data(); }
+
+    // Sum of trigram log-probabilities over a letter sequence
+    double score(const uint8_t* letters, size_t len) const;
+
+private:
+    NgramModel();
+
+    std::vector<float> uni;   // 26
+    std::vector<float> bi;    // 26 * 26
+    std::vector<float> tri;   // 26 * 26 * 26
+};
+
+#endif
@@ -0,0 +1,117 @@
+#include "hill_rekey.h"
+#include "hill_cipher.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <memory>
+
+using namespace std;
+using namespace chrono;
+
+// Built-in key of encryption and decryption, the default old key
+typedef HillCipher<3,
+                   6, 24, 1,
+                   13, 16, 10,
+                   20, 17, 15> CompiledCipher;
+
+/* ---------- MAIN ---------- */
+// Ciphertext under one key to ciphertext under another, without decrypting:
+//   rekey --to KEY --stream              old ciphertext on stdin, new on stdout
+//   rekey --to KEY --file IN OUT         memory-mapped file to file
+//   rekey --to KEY --file IN --in-place  rewrite IN where it lies
+// --from is the old key (default: the built-in key). The space map from
+// encryption is untouched and goes with the new ciphertext as it is.
+int main(int argc, char* argv[]) {
+    vector<vector<int>> from_matrix = CompiledCipher::matrix(), to_matrix;
+    string in_path, out_path, nonce_text, new_nonce_text;
+    bool use_file = false, in_place = false;
+    size_t chunk_size = 0;
+    unsigned threads = 1;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            string arg = argv[i];
+            if (arg == "--stream") {
+                use_file = false;
+            } else if (arg == "--file" && i + 1 < argc) {
+                use_file = true;
+                in_path = argv[++i];
+                if (i + 1 < argc && argv[i + 1][0] != '-') out_path = argv[++i];
+            } else if (arg == "--in-place") {
+                in_place = true;
+            } else if (arg == "--from" && i + 1 < argc) {
+                from_matrix = HillKey::parse(argv[++i]);
+            } else if (arg == "--to" && i + 1 < argc) {
+                to_matrix = HillKey::parse(argv[++i]);
+            } else if (arg == "--chunk" && i + 1 < argc) {
+                chunk_size = stoul(argv[++i]);
+            } else if (arg == "--threads" && i + 1 < argc) {
+                threads = stoul(argv[++i]);
+            } else if (arg == "--nonce" && i + 1 < argc) {
+                nonce_text = argv[++i];
+            } else if (arg == "--new-nonce" && i + 1 < argc) {
+                new_nonce_text = argv[++i];
+            } else {
+                cerr << "Usage: rekey --to \"a b; c d\" [--from \"a b; c d\"]\n"
+                     << "       --stream | --file IN (OUT | --in-place)\n"
+                     << "       [--chunk bytes] [--threads n (0 = all cores)]\n"
+                     << "       [--nonce N (old)] [--new-nonce N|random]\n";
+                return 2;
+            }
+        }
+        if (to_matrix.empty()) {
+            throw runtime_error("--to is required");
+        }
+        if (use_file && out_path.empty() && !in_place) {
+            throw runtime_error("--file needs an output path or --in-place");
+        }
+        if (nonce_text == "random") {
+            throw runtime_error("--nonce is the nonce the ciphertext was made with");
+        }
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 2;
+    }
+    if (chunk_size == 0) {
+        chunk_size = (threads == 1) ? (1 << 16) : (1 << 22);
+    }
+
+    try {
+        HillKey from(from_matrix), to(to_matrix);
+        ThreadPool pool(threads);
+        unique_ptr<HillCounter> from_counter, to_counter;
+        if (!nonce_text.empty()) {
+            from_counter.reset(new HillCounter(HillCounter::parseNonce(nonce_text), from.size()));
+        }
+        if (!new_nonce_text.empty()) {
+            uint64_t nonce = HillCounter::parseNonce(new_nonce_text);
+            if (new_nonce_text == "random") {
+                cerr << "Nonce: 0x" << hex << nonce << dec << "\n";
+            }
+            to_counter.reset(new HillCounter(nonce, to.size()));
+        }
+
+        auto start = steady_clock::now();
+        FileResult result;
+        if (use_file) {
+            result = rekeyFile(from, to, in_path, out_path, in_place, chunk_size, &pool,
+                               from_counter.get(), to_counter.get());
+        } else {
+            ios::sync_with_stdio(false);
+            result = rekeyStream(from, to, cin, cout, chunk_size, &pool,
+                                 from_counter.get(), to_counter.get());
+        }
+        double seconds = duration<double>(steady_clock::now() - start).count();
+        if (use_file) {
+            double mb = result.inputBytes / 1e6;
+            cerr << fixed << setprecision(2) << mb << " MB re-keyed in " << setprecision(3)
+                 << seconds << " s = " << setprecision(1) << mb / max(seconds, 1e-9) << " MB/s\n";
+        }
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,322 @@
+#include "shm_ring.h"
+#include <stdexcept>
+#include <cstring>
+#include <chrono>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+#endif
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
+
+using namespace std;
+
+/* ---------- LAYOUT ---------- */
+// Shared header at the start of the segment; records follow it. head and
+// tail only grow (their difference is the bytes in use); the sequence words
+// are what the futexes sleep on. Producer and consumer fields sit on
+// separate cache lines.
+struct ShmRing::Header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    atomic<int32_t> producerPid;
+    atomic<int32_t> consumerPid;
+    atomic<uint32_t> state;                    // STREAM_*
+
+    alignas(64) atomic<uint64_t> head;         // written by the producer
+    atomic<uint32_t> headSeq;
+    atomic<uint32_t> consumerWaiting;
+
+    alignas(64) atomic<uint64_t> tail;         // written by the consumer
+    atomic<uint32_t> tailSeq;
+    atomic<uint32_t> producerWaiting;
+};
+
+const uint32_t RING_MAGIC = 0x474e5248;        // "HRNG"
+const uint32_t RING_VERSION = 1;
+const uint32_t RECORD_WRAP = 0xffffffff;       // filler up to the end of the ring
+
+enum StreamState : uint32_t { STREAM_OPEN = 0, STREAM_FINISHED = 1, STREAM_ABORTED = 2 };
+
+static size_t recordBytes(size_t payload) {
+    return ShmRing::RECORD_HEADER + ((payload + 7) & ~size_t(7));
+}
+
+#ifndef _WIN32
+static string segmentName(const string& name) {
+    if (name.empty()) throw runtime_error("Shared memory name is empty");
+    return name[0] == '/' ? name : "/" + name;
+}
+
+// False once the process on the other side has exited
+static bool peerAlive(const atomic<int32_t>& pid) {
+    int32_t p = pid.load();
+    return p == 0 || kill(p, 0) == 0 || errno != ESRCH;
+}
+
+/* ---------- SETUP ---------- */
+ShmRing::ShmRing(const string& ringName, Role role, size_t capacity)
+    : name(segmentName(ringName)), role(role), fd(-1), header(nullptr), records(nullptr),
+      size(0), mappedBytes(0), current(0), waitCount(0) {
+    size_t headerBytes = (sizeof(Header) + 4095) & ~size_t(4095);
+
+    if (role == PRODUCER) {
+        size = (max<size_t>(capacity, 4096) + 4095) & ~size_t(4095);
+        mappedBytes = headerBytes + size;
+        shm_unlink(name.c_str());
+        fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) {
+            throw runtime_error("Cannot create shared memory " + name + ": " + strerror(errno));
+        }
+        if (ftruncate(fd, mappedBytes) != 0 || !map()) {
+            string reason = strerror(errno);
+            ::close(fd);
+            shm_unlink(name.c_str());
+            throw runtime_error("Cannot set up shared memory " + name + ": " + reason);
+        }
+
+        // Fresh pages are zero, so only the identity needs filling in; the
+        // magic is stored last and tells the consumer the ring is ready
+        header->version = RING_VERSION;
+        header->capacity = size;
+        header->producerPid.store(getpid());
+        __atomic_store_n(&header->magic, RING_MAGIC, __ATOMIC_RELEASE);
+        return;
+    }
+
+    // The producer may not have started yet, and a segment left by one that
+    // died is skipped until a new producer replaces it
+    for (;;) {
+        fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0) {
+            if (errno != ENOENT) {
+                throw runtime_error("Cannot open shared memory " + name + ": " + strerror(errno));
+            }
+            this_thread::sleep_for(chrono::milliseconds(20));
+            continue;
+        }
+        struct stat st;
+        while (fstat(fd, &st) == 0 && size_t(st.st_size) <= headerBytes) {
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+        mappedBytes = st.st_size;
+        size = mappedBytes - headerBytes;
+        if (!map()) {
+            string reason = strerror(errno);
+            ::close(fd);
+            throw runtime_error("Cannot map shared memory " + name + ": " + reason);
+        }
+        while (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != RING_MAGIC) {
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+        if (header->version != RING_VERSION || header->capacity != size) {
+            munmap(header, mappedBytes);
+            ::close(fd);
+            throw runtime_error("Shared memory " + name + " is not a compatible ring");
+        }
+        if (peerAlive(header->producerPid) && header->state.load() != STREAM_ABORTED) break;
+
+        munmap(header, mappedBytes);
+        ::close(fd);
+        header = nullptr;
+        this_thread::sleep_for(chrono::milliseconds(20));
+    }
+    header->consumerPid.store(getpid());
+}
+
+bool ShmRing::map() {
+    void* p = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) return false;
+    header = static_cast<Header*>(p);
+    records = static_cast<char*>(p) + (mappedBytes - size);
+    return true;
+}
+
+ShmRing::~ShmRing() {
+    if (!header) return;
+    if (role == PRODUCER) {
+        // Leaving without finish() means the stream is incomplete
+        uint32_t open = STREAM_OPEN;
+        if (header->state.compare_exchange_strong(open, STREAM_ABORTED)) {
+            header->headSeq.fetch_add(1);
+            wake(header->headSeq);
+        }
+        shm_unlink(name.c_str());
+    }
+    munmap(header, mappedBytes);
+    ::close(fd);
+}
+
+/* ---------- WAITING ---------- */
+// Sleep until *word moves on from `seen` or a short timeout passes; callers
+// re-check their condition either way, so a missed wake-up only costs time
+void ShmRing::wait(atomic<uint32_t>& word, uint32_t seen) {
+    waitCount++;
+#ifdef __linux__
+    timespec timeout = {0, 50 * 1000 * 1000};
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, seen, &timeout, nullptr, 0);
+#else
+    if (word.load() == seen) this_thread::sleep_for(chrono::microseconds(50));
+#endif
+}
+
+void ShmRing::wake(atomic<uint32_t>& word) {
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#else
+    (void)word;
+#endif
+}
+
+/* ---------- PRODUCER ---------- */
+char* ShmRing::reserve(size_t bytes) {
+    if (bytes > maxRecord()) {
+        throw runtime_error("Record of " + to_string(bytes) + " bytes does not fit the ring");
+    }
+    size_t need = recordBytes(bytes);
+    uint64_t head = header->head.load(memory_order_relaxed);
+
+    for (;;) {
+        size_t offset = head % size;
+        size_t filler = size - offset < need ? size - offset : 0;
+        if (size - (head - header->tail.load(memory_order_acquire)) >= filler + need) {
+            if (filler > 0) {
+                // Records never wrap; skip the consumer straight to the start
+                uint32_t mark[2] = {uint32_t(filler - RECORD_HEADER), RECORD_WRAP};
+                memcpy(records + offset, mark, sizeof(mark));
+                head += filler;
+                header->head.store(head);
+            }
+            return records + head % size + RECORD_HEADER;
+        }
+
+        uint32_t seen = header->tailSeq.load();
+        header->producerWaiting.store(1);
+        if (size - (head - header->tail.load()) < filler + need) {
+            wait(header->tailSeq, seen);
+            if (!peerAlive(header->consumerPid)) {
+                header->producerWaiting.store(0);
+                throw runtime_error("Consumer of " + name + " has exited");
+            }
+        }
+        header->producerWaiting.store(0);
+    }
+}
+
+void ShmRing::commit(size_t bytes, uint32_t type) {
+    uint64_t head = header->head.load(memory_order_relaxed);
+    uint32_t mark[2] = {uint32_t(bytes), type};
+    memcpy(records + head % size, mark, sizeof(mark));
+
+    header->head.store(head + recordBytes(bytes));
+    header->headSeq.fetch_add(1);
+    if (header->consumerWaiting.load()) wake(header->headSeq);
+}
+
+void ShmRing::finish() {
+    header->state.store(STREAM_FINISHED);
+    header->headSeq.fetch_add(1);
+    wake(header->headSeq);
+
+    // Stay until everything is read so the segment outlives its data
+    uint64_t head = header->head.load();
+    for (;;) {
+        uint32_t seen = header->tailSeq.load();
+        header->producerWaiting.store(1);
+        if (header->tail.load() == head) break;
+        wait(header->tailSeq, seen);
+        if (!peerAlive(header->consumerPid)) break;
+    }
+    header->producerWaiting.store(0);
+}
+
+/* ---------- CONSUMER ---------- */
+bool ShmRing::next(const char*& data, size_t& bytes, uint32_t& type) {
+    uint64_t tail = header->tail.load(memory_order_relaxed);
+    for (;;) {
+        // Read the state first: a finished stream has all its records published
+        uint32_t state = header->state.load();
+        if (header->head.load(memory_order_acquire) != tail) {
+            uint32_t mark[2];
+            memcpy(mark, records + tail % size, sizeof(mark));
+            if (mark[1] == RECORD_WRAP) {
+                current = RECORD_HEADER + mark[0];
+                tail += current;
+                release();
+                continue;
+            }
+            data = records + tail % size + RECORD_HEADER;
+            bytes = mark[0];
+            type = mark[1];
+            current = recordBytes(bytes);
+            return true;
+        }
+        if (state == STREAM_FINISHED) return false;
+        if (state == STREAM_ABORTED || !peerAlive(header->producerPid)) {
+            throw runtime_error("Producer of " + name + " stopped before the end of the stream");
+        }
+
+        uint32_t seen = header->headSeq.load();
+        header->consumerWaiting.store(1);
+        if (header->head.load() == tail && header->state.load() == state) {
+            wait(header->headSeq, seen);
+        }
+        header->consumerWaiting.store(0);
+    }
+}
+
+void ShmRing::release() {
+    header->tail.store(header->tail.load(memory_order_relaxed) + current);
+    current = 0;
+    header->tailSeq.fetch_add(1);
+    if (header->producerWaiting.load()) wake(header->tailSeq);
+}
+
+#else
+/* ---------- UNSUPPORTED ---------- */
+ShmRing::ShmRing(const string& ringName, Role role, size_t)
+    : name(ringName), role(role), fd(-1), header(nullptr), records(nullptr),
+      size(0), mappedBytes(0), current(0), waitCount(0) {
+    throw runtime_error("Shared memory rings need POSIX shared memory");
+}
+
+ShmRing::~ShmRing() {
+}
+
+char* ShmRing::reserve(size_t) {
+    return nullptr;
+}
+
+void ShmRing::commit(size_t, uint32_t) {
+}
+
+void ShmRing::finish() {
+}
+
+bool ShmRing::next(const char*&, size_t&, uint32_t&) {
+    return false;
+}
+
+void ShmRing::release() {
+}
+
+bool ShmRing::map() {
+    return false;
+}
+
+void ShmRing::wait(atomic<uint32_t>&, uint32_t) {
+}
+
+void ShmRing::wake(atomic<uint32_t>&) {
+}
+#endif
@@ -0,0 +1,71 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <string>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Single-producer/single-consumer ring of variable-length records in POSIX
+// shared memory, for handing data between two processes without copying it
+// through files or pipes. The producer writes each record straight into the
+// ring (reserve/commit) and the consumer reads it where it lies (next/
+// release). Positions are lock-free atomics; a side with nothing to do sleeps
+// on a futex (Linux; elsewhere it naps briefly) and the other side wakes it.
+// A full ring makes the producer wait, so a slow consumer throttles it.
+class ShmRing {
+public:
+    enum Role { PRODUCER, CONSUMER };
+
+    // The producer creates the segment `name` (replacing a stale one) with
+    // `capacity` bytes of record space. The consumer attaches to it, waiting
+    // for the producer to appear if needed. Throws on failure.
+    ShmRing(const std::string& name, Role role, size_t capacity = DEFAULT_CAPACITY);
+    ~ShmRing();
+
+    ShmRing(const ShmRing&) = delete;
+    ShmRing& operator=(const ShmRing&) = delete;
+
+    // Producer: room for a record of `bytes` bytes, waiting while the ring is
+    // full. Records may be at most maxRecord() bytes.
+    char* reserve(size_t bytes);
+
+    // Producer: publish the reserved record (bytes may be less than reserved)
+    void commit(size_t bytes, uint32_t type);
+
+    // Producer: mark the end of the stream and wait until it is consumed
+    void finish();
+
+    // Consumer: the next record, waiting for one to arrive. Returns false at
+    // the end of the stream. The data stays valid until release().
+    bool next(const char*& data, size_t& bytes, uint32_t& type);
+    void release();
+
+    size_t capacity() const { return size; }
+    size_t maxRecord() const { return size / 2 - RECORD_HEADER; }
+
+    // Times this side had to sleep, for spotting an unbalanced pipeline
+    uint64_t waits() const { return waitCount; }
+
+    static const size_t DEFAULT_CAPACITY = 16 << 20;
+    static const size_t RECORD_HEADER = 8;
+
+private:
+    struct Header;
+
+    bool map();
+    void wait(std::atomic<uint32_t>& word, uint32_t seen);
+    void wake(std::atomic<uint32_t>& word);
+
+    std::string name;
+    Role role;
+    int fd;
+    Header* header;
+    char* records;
+    size_t size;
+    size_t mappedBytes;
+    uint64_t current;        // consumer: size of the record being read
+    uint64_t waitCount;
+};
+
+#endif
@@ -0,0 +1,237 @@
+#include "space_map.h"
+#include <iomanip>
+#include <stdexcept>
+#include <algorithm>
+
+using namespace std;
+
+// Width of each text header field; wide enough for any 64-bit length
+static const int HEADER_FIELD_WIDTH = 20;
+
+static const char BINARY_MAGIC[4] = {'\x89', 'H', 'S', 'M'};
+static const uint8_t BINARY_VERSION = 1;
+static const uint64_t NO_POSITION = UINT64_MAX;
+
+// Positions readAll() reserves before reading (8 MB); past that it grows
+static const uint64_t MAX_RESERVE = 1 << 20;
+
+static void writeU64(ostream& out, uint64_t v) {
+    char bytes[8];
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = char((v >> (8 * i)) & 0xFF);
+    }
+    out.write(bytes, 8);
+}
+
+static uint64_t readU64(istream& in) {
+    unsigned char bytes[8];
+    if (!in.read(reinterpret_cast<char*>(bytes), 8)) {
+        throw runtime_error("Truncated space map header");
+    }
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) {
+        v = (v << 8) | bytes[i];
+    }
+    return v;
+}
+
+SpaceMapFormat parseSpaceMapFormat(const string& name) {
+    if (name == "binary") return SPACE_MAP_BINARY;
+    if (name == "text") return SPACE_MAP_TEXT;
+    throw runtime_error("Unknown space map format: " + name);
+}
+
+/* ---------- WRITER ---------- */
+SpaceMapWriter::SpaceMapWriter(ostream& out, SpaceMapFormat format)
+    : out(out), format(format), count(0), last(NO_POSITION), runGap(0), runLength(0) {
+    writeHeader(0, 0, 0);
+}
+
+void SpaceMapWriter::writeHeader(uint64_t originalLength, uint64_t encryptedLength, uint64_t spaces) {
+    if (format == SPACE_MAP_TEXT) {
+        // Left-aligned and space-filled, so readers using >> see plain numbers
+        out << left << setfill(' ')
+            << setw(HEADER_FIELD_WIDTH) << originalLength << " "
+            << setw(HEADER_FIELD_WIDTH) << encryptedLength << " "
+            << setw(HEADER_FIELD_WIDTH) << spaces;
+        return;
+    }
+
+    const char version[4] = {char(BINARY_VERSION), 0, 0, 0};
+    out.write(BINARY_MAGIC, 4);
+    out.write(version, 4);
+    writeU64(out, originalLength);
+    writeU64(out, encryptedLength);
+    writeU64(out, spaces);
+}
+
+void SpaceMapWriter::writeVarint(uint64_t v) {
+    while (v >= 0x80) {
+        out.put(char((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    out.put(char(v));
+}
+
+void SpaceMapWriter::flushRun() {
+    if (runLength == 1) {
+        writeVarint(runGap << 1);
+    } else if (runLength > 1) {
+        writeVarint((runGap << 1) | 1);
+        writeVarint(runLength);
+    }
+    runLength = 0;
+}
+
+void SpaceMapWriter::add(uint64_t pos) {
+    count++;
+    if (format == SPACE_MAP_TEXT) {
+        out << " " << pos;
+        return;
+    }
+
+    uint64_t gap = pos - last;   // wraps to pos + 1 for the first space
+    last = pos;
+    if (runLength > 0 && gap == runGap) {
+        runLength++;
+        return;
+    }
+    flushRun();
+    runGap = gap;
+    runLength = 1;
+}
+
+void SpaceMapWriter::finish(uint64_t originalLength, uint64_t encryptedLength) {
+    flushRun();
+    out.flush();
+    out.seekp(0);
+    writeHeader(originalLength, encryptedLength, count);
+    out.flush();
+    if (!out) {
+        throw runtime_error("Failed to write space map header");
+    }
+}
+
+/* ---------- READER ---------- */
+SpaceMapReader::SpaceMapReader(istream& in)
+    : in(in), layout(SPACE_MAP_TEXT), original(0), encrypted(0), count(0), read(0),
+      last(NO_POSITION), runGap(0), runLeft(0) {
+    // The binary magic starts with a byte no text map can start with
+    if (in.peek() == (unsigned char)BINARY_MAGIC[0]) {
+        char header[8];
+        if (!in.read(header, 8) || string(header, 4) != string(BINARY_MAGIC, 4)) {
+            throw runtime_error("Malformed space map header");
+        }
+        if (uint8_t(header[4]) != BINARY_VERSION) {
+            throw runtime_error("Unsupported space map version " + to_string(uint8_t(header[4])));
+        }
+        layout = SPACE_MAP_BINARY;
+        original = readU64(in);
+        encrypted = readU64(in);
+        count = readU64(in);
+        return;
+    }
+
+    if (!(in >> original >> encrypted >> count)) {
+        throw runtime_error("Malformed space map header");
+    }
+}
+
+uint64_t SpaceMapReader::readVarint() {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = in.get();
+        if (c == EOF) {
+            throw runtime_error("Truncated space map");
+        }
+        v |= uint64_t(c & 0x7F) << shift;
+        if (!(c & 0x80)) return v;
+    }
+    throw runtime_error("Malformed space map varint");
+}
+
+bool SpaceMapReader::next(uint64_t& pos) {
+    if (read >= count) {
+        return false;
+    }
+
+    if (layout == SPACE_MAP_TEXT) {
+        if (!(in >> pos)) return false;
+        read++;
+        return true;
+    }
+
+    if (runLeft == 0) {
+        uint64_t v = readVarint();
+        runGap = v >> 1;
+        runLeft = (v & 1) ? readVarint() : 1;
+        if (runLeft == 0) {
+            throw runtime_error("Malformed space map run");
+        }
+    }
+    runLeft--;
+    last += runGap;
+    pos = last;
+    read++;
+    return true;
+}
+
+vector<uint64_t> SpaceMapReader::readAll() {
+    // The header count is only a hint: a damaged map may claim far more
+    // spaces than it holds, so reserve at most a bounded amount up front
+    vector<uint64_t> positions;
+    positions.reserve(min<uint64_t>(count - read, MAX_RESERVE));
+    uint64_t pos;
+    while (next(pos)) {
+        positions.push_back(pos);
+    }
+    return positions;
+}
+
+SpaceMapCursor SpaceMapReader::tell() {
+    // An exhausted text map may have hit EOF, where tellg() fails; there is
+    // nothing left to resume then anyway
+    streamoff offset = read < count ? streamoff(in.tellg()) : 0;
+    return {uint64_t(offset), read, last, runGap, runLeft};
+}
+
+void SpaceMapReader::seek(const SpaceMapCursor& cursor) {
+    if (cursor.read < count) {
+        in.clear();
+        in.seekg(cursor.offset);
+        if (!in) {
+            throw runtime_error("Cannot seek in space map");
+        }
+    }
+    read = cursor.read;
+    last = cursor.last;
+    runGap = cursor.runGap;
+    runLeft = cursor.runLeft;
+}
+
+/* ---------- RECONSTRUCTION ---------- */
+size_t reconstructWithSpaces(const char* letters, size_t length, const uint64_t* spacePositions,
+                             size_t spaceCount, uint64_t originalLength, char* out) {
+    uint64_t limit = originalLength > 0 ? originalLength : UINT64_MAX;
+    size_t written = 0;
+    size_t s = 0;
+    for (size_t i = 0; ; i++) {
+        // A position equal to the current length belongs here; smaller ones
+        // can only be duplicates and are skipped
+        while (s < spaceCount && spacePositions[s] <= written) {
+            if (spacePositions[s] == written && written < limit) out[written++] = ' ';
+            s++;
+        }
+        if (i == length || written >= limit) break;
+        out[written++] = letters[i];
+    }
+    return written;
+}
+
+string reconstructWithSpaces(const string& letters, const vector<uint64_t>& spacePositions,
+                             uint64_t originalLength) {
+    string result(letters.size() + spacePositions.size(), ' ');
+    result.resize(reconstructWithSpaces(letters.data(), letters.size(), spacePositions.data(),
+                                        spacePositions.size(), originalLength, &result[0]));
+    return result;
+}
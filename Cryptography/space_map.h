@@ -0,0 +1,113 @@
+#ifndef SPACE_MAP_H
+#define SPACE_MAP_H
+
+#include <vector>
+#include <string>
+#include <istream>
+#include <ostream>
+#include <cstddef>
+#include <cstdint>
+
+// Space maps record where the spaces of the original message were, so the
+// decryptor can put them back. Two layouts exist:
+//
+// Text (legacy space_map.txt):
+//   original_length encrypted_length space_count pos1 pos2 pos3...
+//
+// Binary (version 1), all integers little-endian:
+//   magic "\x89HSM" | version u8 | 3 reserved bytes
+//   original_length u64 | encrypted_length u64 | space_count u64
+//   records: varint(gap << 1)                   one space, gap after the last
+//            varint(gap << 1 | 1) varint(count) `count` spaces, `gap` apart
+// Gaps are measured from the previous space (from -1 for the first one), so
+// prose costs about a byte per space and regular spacing collapses into runs.
+enum SpaceMapFormat {
+    SPACE_MAP_TEXT,
+    SPACE_MAP_BINARY
+};
+
+// "binary" or "text"; throws on anything else
+SpaceMapFormat parseSpaceMapFormat(const std::string& name);
+
+// Writes a space map incrementally. The header is reserved up front and
+// rewritten on finish(), so the stream must be seekable (ofstream).
+class SpaceMapWriter {
+public:
+    explicit SpaceMapWriter(std::ostream& out, SpaceMapFormat format = SPACE_MAP_BINARY);
+
+    // Append one space position (original-message coordinates, ascending)
+    void add(uint64_t pos);
+
+    // Rewrite the header with the final lengths
+    void finish(uint64_t originalLength, uint64_t encryptedLength);
+
+private:
+    void writeHeader(uint64_t originalLength, uint64_t encryptedLength, uint64_t count);
+    void writeVarint(uint64_t v);
+    void flushRun();
+
+    std::ostream& out;
+    SpaceMapFormat format;
+    uint64_t count;
+    uint64_t last;        // previous position; UINT64_MAX stands for -1
+    uint64_t runGap;
+    uint64_t runLength;
+};
+
+// Where a SpaceMapReader stands between two positions, so reading can resume
+// there later without decoding everything before it
+struct SpaceMapCursor {
+    uint64_t offset;      // stream position
+    uint64_t read;        // positions already returned
+    uint64_t last;
+    uint64_t runGap;
+    uint64_t runLeft;
+};
+
+// Reads either layout lazily, one position at a time
+class SpaceMapReader {
+public:
+    explicit SpaceMapReader(std::istream& in);
+
+    // Next space position; returns false when the map is exhausted
+    bool next(uint64_t& pos);
+
+    // Every remaining position at once
+    std::vector<uint64_t> readAll();
+
+    // Save and restore the read position (the stream must be seekable)
+    SpaceMapCursor tell();
+    void seek(const SpaceMapCursor& cursor);
+
+    SpaceMapFormat format() const { return layout; }
+    uint64_t originalLength() const { return original; }
+    uint64_t encryptedLength() const { return encrypted; }
+    uint64_t spaceCount() const { return count; }
+
+private:
+    uint64_t readVarint();
+
+    std::istream& in;
+    SpaceMapFormat layout;
+    uint64_t original;
+    uint64_t encrypted;
+    uint64_t count;
+    uint64_t read;
+    uint64_t last;
+    uint64_t runGap;
+    uint64_t runLeft;
+};
+
+// Rebuild the message in one pass: spaces go in at their recorded positions
+// (ascending; positions past the end are dropped) and the result is trimmed
+// to originalLength when it is non-zero. O(letters + spaces).
+std::string reconstructWithSpaces(const std::string& letters,
+                                  const std::vector<uint64_t>& spacePositions,
+                                  uint64_t originalLength);
+
+// Same, into a caller buffer with room for length + spaceCount bytes; no
+// allocation. Returns the bytes written.
+size_t reconstructWithSpaces(const char* letters, size_t length, const uint64_t* spacePositions,
+                             size_t spaceCount, uint64_t originalLength, char* out);
+
+#endif